@@ -0,0 +1,152 @@
+/**
+ * @file collector.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Vstupní bod lokálního Netflow v5 kolektoru (testování propustnosti exportéru na jednom stroji)
+ */
+
+#include <iostream>
+#include <csignal>
+
+//#define _loggerDebug
+#include "project/logger/logger.hpp"
+
+#include "project/v5_collector.h"
+
+struct CliInput
+{
+	Netflow::V5CollectorConfig config {};
+	int errorFlag {0};
+};
+
+/**
+ * @brief Vypíše použití na std::cout
+ */
+void PrintUsage()
+{
+	std::cout << "flow_collector\nUsage:\n\t."
+		<< "/flow_collector [-l <address>[:<port>]] [-r <seconds>] [-n <seconds>] [-R <bytes>] [-p]\n"
+		<< "Flags:\n"
+		<< "\t-l\t - Address and port to listen on (default: 0.0.0.0:2055)\n"
+		<< "\t-r\t - Print rates every <seconds>; 0 prints only the summary (default: 1)\n"
+		<< "\t-n\t - Exit after <seconds> without a datagram once the first one arrived (default: run until SIGINT/SIGTERM)\n"
+		<< "\t-R\t - Socket receive buffer size in bytes (default: system default)\n"
+		<< "\t-p\t - Print decoded records to STDOUT\n"
+		<< "\t-h\t - Print this help\n";
+}
+
+/**
+ * @brief Parsování argumentů z cli
+ *
+ * @param argc počet argumentů
+ * @param argv argumenty
+ * @return CliInput naparsované argumenty
+ */
+CliInput ParseCli(int argc, char **argv)
+{
+	CliInput in;
+
+	enum class Expect
+	{
+		Flag,
+		Listen,
+		Report,
+		IdleExit,
+		RecvBuffer
+	};
+	Expect ex = Expect::Flag;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg(argv[i]);
+
+		switch (ex) {
+		case Expect::Flag:
+			if (arg == "-l") {
+				ex = Expect::Listen;
+			}
+			else if (arg == "-r") {
+				ex = Expect::Report;
+			}
+			else if (arg == "-n") {
+				ex = Expect::IdleExit;
+			}
+			else if (arg == "-R") {
+				ex = Expect::RecvBuffer;
+			}
+			else if (arg == "-p") {
+				in.config.print = true;
+			}
+			else if (arg == "-h") {
+				PrintUsage();
+				in.errorFlag = -1;
+			}
+			else {
+				Logger::LogError<>("Expected flag (-l | -r | -n | -R | -p): " + arg);
+				in.errorFlag = 2;
+			}
+			break;
+		case Expect::Listen: {
+			const auto colonPos = arg.rfind(":");
+			if (colonPos != std::string::npos) {
+				in.config.address = arg.substr(0, colonPos);
+				in.config.port = std::stoul(arg.substr(colonPos + 1));
+			}
+			else {
+				in.config.address = arg;
+			}
+			ex = Expect::Flag;
+			break;
+		}
+		case Expect::Report:
+			in.config.reportInterval = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::IdleExit:
+			in.config.idleExit = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::RecvBuffer:
+			in.config.recvBuffer = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		default:
+			LOG_DEBUG("CLI - unexpected state");
+			ex = Expect::Flag; // nemělo by dojít, dead code
+			break;
+		}
+
+		if (in.errorFlag != 0) {
+			break;
+		}
+	}
+
+	return in;
+}
+
+/**
+ * @brief Obsluha SIGINT/SIGTERM - ukončí příjem a vypíše souhrn
+ */
+void OnStopSignal(int)
+{
+	Netflow::V5Collector::Stop();
+}
+
+int main(int argc, char **argv)
+{
+	CliInput cli = ParseCli(argc, argv);
+	if (cli.errorFlag != 0) {
+		return cli.errorFlag == -1 ? 0 : cli.errorFlag;
+	}
+
+	Netflow::V5Collector collector(cli.config);
+	if (!collector.IsInitialized()) {
+		return 1;
+	}
+
+	std::signal(SIGINT, OnStopSignal);
+	std::signal(SIGTERM, OnStopSignal);
+	collector.Run();
+
+	// ztráty se projeví v návratovém kódu (skripty benchmarků)
+	const auto & totals = collector.Totals();
+	return totals.lostRecords > 0 || totals.kernelDrops > 0 ? 3 : 0;
+}
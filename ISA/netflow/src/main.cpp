@@ -5,6 +5,11 @@
  */
 
 #include <iostream>
+#include <algorithm>
+#include <vector>
+#include <ctime>
+#include <cctype>
+#include <csignal>
 
 //#define _loggerDebug
 #include "project/logger/logger.hpp"
@@ -29,14 +34,40 @@ constexpr std::uint32_t DefaultInterval = 10;
 /// @brief Výchozí hodnota pro velikost flow-cache
 constexpr std::uint32_t DefaultFlowCacheSize = 1024;
 
+/// @brief Výchozí hodnota pro granularitu časovacího kola (ms)
+constexpr std::uint32_t DefaultTimerGranularity = 1000;
+
+/// @brief Výchozí hodnota pro počet vláken s flow-cache
+constexpr std::uint32_t DefaultThreads = 1;
+
+/// @brief Výchozí hodnota pro počet paketů zpracovaných najednou
+constexpr std::uint32_t DefaultBurstSize = 64;
+
+/// @brief Výchozí hodnota pro počet datagramů v dávce
+constexpr std::uint32_t DefaultBatchDatagrams = 32;
+
+/// @brief Výchozí hodnota pro velikost dávky v bytech
+constexpr std::uint32_t DefaultBatchBytes = 256 * 1024;
+
+/// @brief Výchozí hodnota pro max. zdržení datagramu v dávce (ms)
+constexpr std::uint32_t DefaultBatchDelay = 100;
+
+/// @brief Výchozí hodnota pro MTU cesty ke kolektoru
+constexpr std::uint32_t DefaultMtu = 1500;
+
 struct CliInput
 {
-	std::string file {DefaultFile};
-	std::string collectorIp {DefaultCollectorIp};
-	std::uint32_t collectorPort {DefaultCollectorPort};
-	std::uint32_t activeTimer {DefaultActiveTimer};
-	std::uint32_t interval {DefaultInterval};
-	std::uint32_t flowCacheSize {DefaultFlowCacheSize};
+	std::vector<std::string> files {};
+	std::vector<Netflow::CollectorEndpoint> collectors {};
+	Netflow::ExporterConfig exporter {DefaultActiveTimer, DefaultInterval, DefaultFlowCacheSize, DefaultTimerGranularity,
+		DefaultThreads, DefaultBurstSize};
+	Netflow::BatchConfig batch {DefaultBatchDatagrams, DefaultBatchBytes, DefaultBatchDelay};
+	Netflow::ExportConfig exportConfig {Netflow::ExportFormat::NetflowV5, DefaultMtu};
+	Netflow::SamplingConfig sampling {};
+	Netflow::StatsConfig stats {};
+	Netflow::InputConfig input {};
+	Netflow::AggregationConfig aggregation {};
+	std::uint32_t indexEvery {0}; ///< > 0 = pouze vytvořit index vstupních souborů
 	int errorFlag {0};
 };
 
@@ -46,13 +77,79 @@ struct CliInput
 void PrintUsage()
 {
 	std::cout << "flow\nUsage:\n\t."
-		<< "/flow [-f <file>] [-c <netflow_collector>[:<port>]] [-a <active_timer>] [-i <inactive_timer>] [-m <count>]\n"
+		<< "/flow [-f <file|directory>]... [-I <interface>] [-F <filter>] [-c <netflow_collector>[:<port>]]... [-a <active_timer>] [-i <inactive_timer>] [-w <granularity>] [-m <count>] [-t <threads>] [-B <packets>] [-b <datagrams>[:<bytes>[:<ms>]]] [-P <datagrams/s>[:<burst>]] [--sndbuf <bytes>] [-e v5|ipfix|archive:<file>] [-M <mtu>] [-s det|hash:<N>] [-A <fields>[:<seconds>]] [-S <file>[:<seconds>]] [--tcp-close <seconds>] [--max-delay <ms>] [--from <time>] [--to <time>] [--slices <count>] [--index <packets>] [--ring <block_bytes>[:<blocks>]] [--checkpoint <file>] [--restore <file>]\n"
 		<< "Flags:\n"
-		<< "\t-f\t - File to analyze (default: STDIN)\n"
-		<< "\t-c\t - IP address/hostname of netflow collector (default: 127.0.0.1:2055)\n"
+		<< "\t-f\t - File or directory to analyze; repeat for more inputs, which are read in parallel and merged by time (default: STDIN)\n"
+		<< "\t-I\t - Capture live from <interface> (AF_PACKET TPACKET_V3 ring) instead of reading files; stops on SIGINT/SIGTERM\n"
+		<< "\t-F\t - Process only packets matching the BPF <filter> expression (tcpdump syntax); applied in the kernel for -I,\n"
+		<< "\t\t   by libpcap for stdin and by a built-in BPF interpreter for pcap files, before packets are parsed\n"
+		<< "\t-c\t - IP address/hostname of netflow collector; repeat to spread flows across collectors by consistent hashing (default: 127.0.0.1:2055)\n"
 		<< "\t-a\t - Netflow active timer (default: 60)\n"
 		<< "\t-i\t - Netflow inactive timer (default: 10)\n"
-		<< "\t-m\t - Netflow flow-cache size (default: 1024)\n";
+		<< "\t-w\t - Timer wheel granularity in milliseconds (default: 1000)\n"
+		<< "\t-m\t - Netflow flow-cache size (default: 1024)\n"
+		<< "\t-t\t - Number of flow-cache worker threads; the cache size is split between them (default: 1)\n"
+		<< "\t-B\t - Packets parsed, prefetched and added to the flow-cache in one burst (default: 64)\n"
+		<< "\t-b\t - Send datagrams in batches of up to <datagrams>/<bytes>, waiting at most <ms> (default: 32:262144:100)\n"
+		<< "\t-P\t - Pace sending to at most <datagrams/s> per collector, at most <burst> at once (default: off, burst 10 ms of the rate)\n"
+		<< "\t--sndbuf - Socket send buffer size in bytes (default: system default)\n"
+		<< "\t-e\t - Export format: v5 (IPv4 only), ipfix (IPv4 and IPv6) or archive:<file> (columnar flow archive on disk, nothing is sent) (default: v5)\n"
+		<< "\t-M\t - MTU of the path to the collector; limits the IPFIX message size (default: 1500)\n"
+		<< "\t-s\t - Sampling: det = every N-th packet, hash = all packets of 1 in N flows selected by key hash (default: none)\n"
+		<< "\t-A\t - Aggregate flows before export by the given key fields (src/<len>, dst/<len>, proto, ports, srcport, dstport, tos\n"
+		<< "\t\t   or v8-like proto-port, src-prefix, dst-prefix, prefix); aggregates are exported <seconds> after creation (default: 60)\n"
+		<< "\t-S\t - Append stats as JSON lines to <file> (- for stderr) every <seconds> and at exit; SIGUSR1 dumps them any time\n"
+		<< "\t--tcp-close - Export TCP flows <seconds> after their last packet once the connection is closed (RST, or FIN in both directions) (default: off)\n"
+		<< "\t--max-delay - On stdin and -I, advance time by the wall clock every <ms> while no packets arrive, so due flows are exported (0 = off, default: 1000)\n"
+		<< "\t--from\t - Process only packets at or after <time> (unix seconds or YYYY-MM-DDTHH:MM:SS UTC); uses the file index to skip ahead\n"
+		<< "\t--to\t - Process only packets before <time>\n"
+		<< "\t--slices - Split a single indexed file into <count> time-contiguous slices processed in parallel (default: 1)\n"
+		<< "\t--ring\t - RX ring for -I: block size in bytes (rounded up to a power of 2) and block count (default: 1048576:64)\n"
+		<< "\t--checkpoint - On SIGTERM, stop reading and save the open flows, sequence numbers and start time into <file> instead of exporting them\n"
+		<< "\t--restore - Load the flow-cache from a --checkpoint <file> before processing and delete it (missing file = empty cache)\n"
+		<< "\t--index\t - Write a time index (<file>.nfidx) with an entry every <packets> packets for each input file and exit\n";
+}
+
+/**
+ * @brief Převede čas z příkazové řádky na µs od epochy
+ * 
+ * @param arg unixový čas v sekundách (s volitelnou desetinnou částí) nebo YYYY-MM-DDTHH:MM:SS[.frac] v UTC
+ * @param us výstupní čas
+ * @return true čas je platný
+ */
+bool ParseTime(const std::string & arg, std::uint64_t & us)
+{
+	const auto dot = arg.find('.');
+	const std::string whole = arg.substr(0, dot);
+	std::uint64_t sec;
+
+	if (whole.find('-') != std::string::npos) {
+		std::tm tm {};
+		const char * end = strptime(whole.c_str(), "%Y-%m-%dT%H:%M:%S", &tm);
+		if (end == nullptr || *end != '\0') {
+			return false;
+		}
+		sec = timegm(&tm);
+	}
+	else if (!whole.empty() && std::all_of(whole.begin(), whole.end(), ::isdigit)) {
+		sec = std::stoull(whole);
+	}
+	else {
+		return false;
+	}
+
+	// desetinná část - na mikrosekundy
+	std::uint64_t frac = 0;
+	if (dot != std::string::npos) {
+		std::string digits = arg.substr(dot + 1);
+		if (digits.empty() || !std::all_of(digits.begin(), digits.end(), ::isdigit)) {
+			return false;
+		}
+		digits.resize(6, '0');
+		frac = std::stoull(digits);
+	}
+	us = sec * 1'000'000 + frac;
+	return true;
 }
 
 /**
@@ -70,10 +167,32 @@ CliInput ParseCli(int argc, char **argv)
 	{
 		Flag,
 		File,
+		Interface,
+		Filter,
+		Ring,
 		Collector,
 		ActiveTimer,
 		Interval,
-		FlowCacheSize
+		TimerGranularity,
+		FlowCacheSize,
+		Threads,
+		Burst,
+		Batch,
+		Pacing,
+		SndBuf,
+		Format,
+		Mtu,
+		Sampling,
+		Aggregation,
+		Stats,
+		From,
+		To,
+		Slices,
+		TcpClose,
+		MaxDelay,
+		Checkpoint,
+		Restore,
+		Index
 	};
 	Expect ex = Expect::Flag;
 
@@ -85,6 +204,15 @@ CliInput ParseCli(int argc, char **argv)
 			if (arg == "-f") {
 				ex = Expect::File;
 			}
+			else if (arg == "-I") {
+				ex = Expect::Interface;
+			}
+			else if (arg == "-F") {
+				ex = Expect::Filter;
+			}
+			else if (arg == "--ring") {
+				ex = Expect::Ring;
+			}
 			else if (arg == "-c") {
 				ex = Expect::Collector;
 			}
@@ -94,44 +222,262 @@ CliInput ParseCli(int argc, char **argv)
 			else if (arg == "-i") {
 				ex = Expect::Interval;
 			}
+			else if (arg == "-w") {
+				ex = Expect::TimerGranularity;
+			}
 			else if (arg == "-m") {
 				ex = Expect::FlowCacheSize;
 			}
+			else if (arg == "-t") {
+				ex = Expect::Threads;
+			}
+			else if (arg == "-B") {
+				ex = Expect::Burst;
+			}
+			else if (arg == "-b") {
+				ex = Expect::Batch;
+			}
+			else if (arg == "-P") {
+				ex = Expect::Pacing;
+			}
+			else if (arg == "--sndbuf") {
+				ex = Expect::SndBuf;
+			}
+			else if (arg == "-e") {
+				ex = Expect::Format;
+			}
+			else if (arg == "-M") {
+				ex = Expect::Mtu;
+			}
+			else if (arg == "-s") {
+				ex = Expect::Sampling;
+			}
+			else if (arg == "-A") {
+				ex = Expect::Aggregation;
+			}
+			else if (arg == "-S") {
+				ex = Expect::Stats;
+			}
+			else if (arg == "--from") {
+				ex = Expect::From;
+			}
+			else if (arg == "--to") {
+				ex = Expect::To;
+			}
+			else if (arg == "--tcp-close") {
+				ex = Expect::TcpClose;
+			}
+			else if (arg == "--max-delay") {
+				ex = Expect::MaxDelay;
+			}
+			else if (arg == "--checkpoint") {
+				ex = Expect::Checkpoint;
+			}
+			else if (arg == "--restore") {
+				ex = Expect::Restore;
+			}
+			else if (arg == "--slices") {
+				ex = Expect::Slices;
+			}
+			else if (arg == "--index") {
+				ex = Expect::Index;
+			}
 			else if (arg == "-h") {
 				PrintUsage();
 				in.errorFlag = -1;
 			}
 			else {
-				Logger::LogError<>("Expected flag (-f | -c | -a | -i | -m): " + arg);
+				Logger::LogError<>("Expected flag (-f | -I | -F | -c | -a | -i | -w | -m | -t | -B | -b | -P | --sndbuf | -e | -M | -s | -A | -S | --tcp-close | --max-delay | --from | --to | --slices | --index | --ring | --checkpoint | --restore): " + arg);
 				in.errorFlag = 2;
 			}
 			break;
 		case Expect::File:
-			in.file = arg;
+			// -f lze zadat vícekrát
+			in.files.push_back(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::Interface:
+			in.input.interface = arg;
+			ex = Expect::Flag;
+			break;
+		case Expect::Filter:
+			in.input.filter = Netflow::BpfFilter::Compile(arg);
+			if (!in.input.filter) {
+				in.errorFlag = 2;
+			}
 			ex = Expect::Flag;
 			break;
+		case Expect::Ring: {
+			// <block_bytes>[:<blocks>]
+			const auto colonPos = arg.find(":");
+			in.input.ring.blockSize = std::stoul(arg.substr(0, colonPos));
+			if (colonPos != std::string::npos) {
+				in.input.ring.blockCount = std::max<std::uint32_t>(std::stoul(arg.substr(colonPos + 1)), 1);
+			}
+			ex = Expect::Flag;
+			break;
+		}
 		case Expect::Collector: {
 			const auto colonPos = arg.find(":");
 			if (colonPos != std::string::npos) {
-				in.collectorIp = arg.substr(0, colonPos);
-				in.collectorPort = std::stoul(arg.substr(colonPos+1, arg.size()));
+				in.collectors.push_back({arg.substr(0, colonPos), static_cast<std::uint32_t>(std::stoul(arg.substr(colonPos+1, arg.size())))});
 			}
 			else {
-				in.collectorIp = arg;
+				in.collectors.push_back({arg, DefaultCollectorPort});
 			}
 			ex = Expect::Flag;
 			break;
 		}
+		case Expect::Pacing: {
+			// <datagrams/s>[:<burst>]
+			const auto colonPos = arg.find(":");
+			in.exportConfig.pacing.maxDatagramsPerSec = std::stoul(arg.substr(0, colonPos));
+			if (colonPos != std::string::npos) {
+				in.exportConfig.pacing.burst = std::stoul(arg.substr(colonPos + 1));
+			}
+			ex = Expect::Flag;
+			break;
+		}
+		case Expect::SndBuf:
+			in.exportConfig.pacing.sndBufBytes = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
 		case Expect::ActiveTimer:
-			in.activeTimer = std::stoul(arg);
+			in.exporter.activeTimer = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::Interval:
+			in.exporter.interval = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::TimerGranularity:
+			in.exporter.timerGranularity = std::stoul(arg);
 			ex = Expect::Flag;
 			break;
 		case Expect::FlowCacheSize:
-			in.flowCacheSize = std::stoul(arg);
+			in.exporter.flowCacheSize = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::Threads:
+			in.exporter.threads = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::Burst:
+			in.exporter.burstSize = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::Batch: {
+			// <datagrams>[:<bytes>[:<ms>]]
+			const auto colonPos = arg.find(":");
+			in.batch.maxDatagrams = std::max<std::uint32_t>(std::stoul(arg.substr(0, colonPos)), 1);
+			if (colonPos != std::string::npos) {
+				const auto rest = arg.substr(colonPos+1, arg.size());
+				const auto colonPos2 = rest.find(":");
+				in.batch.maxBytes = std::stoul(rest.substr(0, colonPos2));
+				if (colonPos2 != std::string::npos) {
+					in.batch.maxDelayMs = std::stoul(rest.substr(colonPos2+1, rest.size()));
+				}
+			}
+			ex = Expect::Flag;
+			break;
+		}
+		case Expect::Format:
+			if (arg == "v5") {
+				in.exportConfig.format = Netflow::ExportFormat::NetflowV5;
+			}
+			else if (arg == "ipfix") {
+				in.exportConfig.format = Netflow::ExportFormat::Ipfix;
+			}
+			else if (arg.rfind("archive:", 0) == 0 && arg.size() > 8) {
+				in.exportConfig.format = Netflow::ExportFormat::Archive;
+				in.exportConfig.archivePath = arg.substr(8);
+			}
+			else {
+				Logger::LogError<>("Unknown export format (v5 | ipfix | archive:<file>): " + arg);
+				in.errorFlag = 2;
+			}
+			ex = Expect::Flag;
+			break;
+		case Expect::Mtu:
+			in.exportConfig.mtu = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::Sampling: {
+			// <mode>:<N>
+			const auto colonPos = arg.find(":");
+			const auto mode = arg.substr(0, colonPos);
+			if (colonPos == std::string::npos || (mode != "det" && mode != "hash")) {
+				Logger::LogError<>("Expected sampling det:<N> | hash:<N>: " + arg);
+				in.errorFlag = 2;
+			}
+			else {
+				in.sampling.mode = mode == "det" ? Netflow::SamplingMode::Deterministic : Netflow::SamplingMode::Hash;
+				in.sampling.interval = std::stoul(arg.substr(colonPos+1, arg.size()));
+			}
+			ex = Expect::Flag;
+			break;
+		}
+		case Expect::Aggregation:
+			if (!Netflow::AggregationConfig::Parse(arg, in.aggregation)) {
+				Logger::LogError<>("Invalid aggregation scheme: " + arg);
+				in.errorFlag = 2;
+			}
+			ex = Expect::Flag;
+			break;
+		case Expect::Stats: {
+			// <file>[:<seconds>]
+			const auto colonPos = arg.rfind(":");
+			const auto file = arg.substr(0, colonPos);
+			in.stats.file = file == "-" ? "" : file;
+			if (colonPos != std::string::npos) {
+				in.stats.intervalSec = std::stoul(arg.substr(colonPos+1, arg.size()));
+			}
+			in.stats.enabled = true;
+			ex = Expect::Flag;
+			break;
+		}
+		case Expect::From:
+		case Expect::To: {
+			std::uint64_t us;
+			if (!ParseTime(arg, us)) {
+				Logger::LogError<>("Expected time (unix seconds or YYYY-MM-DDTHH:MM:SS): " + arg);
+				in.errorFlag = 2;
+			}
+			else if (ex == Expect::From) {
+				in.input.fromUs = us;
+			}
+			else {
+				in.input.toUs = us;
+			}
+			ex = Expect::Flag;
+			break;
+		}
+		case Expect::Slices:
+			in.input.slices = std::max<std::uint32_t>(std::stoul(arg), 1);
+			ex = Expect::Flag;
+			break;
+		case Expect::TcpClose:
+			in.exporter.tcpCloseGrace = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::MaxDelay:
+			in.input.maxExportDelayMs = std::stoul(arg);
+			ex = Expect::Flag;
+			break;
+		case Expect::Checkpoint:
+			in.input.checkpointPath = arg;
+			ex = Expect::Flag;
+			break;
+		case Expect::Restore:
+			in.input.restorePath = arg;
+			ex = Expect::Flag;
+			break;
+		case Expect::Index:
+			in.indexEvery = std::max<std::uint32_t>(std::stoul(arg), 1);
 			ex = Expect::Flag;
 			break;
 		default:
-			Logger::LogDebug<>("CLI - unexpected state");
+			LOG_DEBUG("CLI - unexpected state");
 			ex = Expect::Flag; // nemělo by dojít, dead code
 			break;
 		}
@@ -144,6 +490,23 @@ CliInput ParseCli(int argc, char **argv)
 	return in;
 }
 
+/**
+ * @brief Obsluha SIGINT/SIGTERM při živém zachytávání - ukončí čtení
+ */
+void OnStopSignal(int)
+{
+	Netflow::AfPacketSource::Stop();
+}
+
+/**
+ * @brief Obsluha SIGTERM s --checkpoint - ukončí čtení a uloží otevřené záznamy
+ */
+void OnCheckpointSignal(int)
+{
+	Netflow::NetflowExporter::RequestCheckpoint();
+	Netflow::AfPacketSource::Stop();
+}
+
 int main(int argc, char **argv)
 {
 	CliInput cli = ParseCli(argc, argv);
@@ -151,10 +514,42 @@ int main(int argc, char **argv)
 		return cli.errorFlag == -1 ? 0 : cli.errorFlag;
 	}
 
-	auto n = Netflow::NetflowExporter(cli.file, cli.collectorIp, cli.collectorPort, cli.activeTimer, cli.interval, cli.flowCacheSize);
+	if (!cli.input.interface.empty() && !cli.files.empty()) {
+		Logger::LogError<>("-f and -I can't be combined");
+		return 2;
+	}
+	if (cli.files.empty()) {
+		cli.files.push_back(DefaultFile);
+	}
+	if (cli.collectors.empty()) {
+		cli.collectors.push_back({DefaultCollectorIp, DefaultCollectorPort});
+	}
+
+	if (cli.indexEvery > 0) {
+		// pouze indexace
+		bool ok = true;
+		for (const auto & file : Netflow::MultiFileReader::ExpandInputs(cli.files)) {
+			ok = Netflow::PcapIndex::Build(file, cli.indexEvery) && ok;
+		}
+		return ok ? 0 : 1;
+	}
 
-	Logger::LogInfo<>("Starting netflow exporter...");
-	n.Run();
+	auto n = Netflow::NetflowExporter(cli.files, cli.collectors, cli.exporter, cli.batch, cli.exportConfig,
+		cli.sampling, cli.stats, cli.input, cli.aggregation);
 
-	return 0;
+	if (!cli.input.interface.empty()) {
+		// živé zachytávání nemá konec; po signálu se cache vyprázdní a exportuje
+		std::signal(SIGINT, OnStopSignal);
+		std::signal(SIGTERM, OnStopSignal);
+	}
+	if (!cli.input.checkpointPath.empty()) {
+		// bez SA_RESTART - blokující čtení ze stdin se signálem přeruší
+		struct sigaction sa {};
+		sa.sa_handler = OnCheckpointSignal;
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGTERM, &sa, nullptr);
+	}
+
+	Logger::LogInfo<>("Starting netflow exporter...");
+	return n.Run() ? 0 : 1;
 }
@@ -0,0 +1,276 @@
+/**
+ * @file af_packet_source.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "af_packet_source.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+//#define _loggerDebug
+#include "logger/logger.hpp"
+
+namespace
+{
+	/// @brief Požadavek na ukončení (nastavuje AfPacketSource::Stop())
+	volatile std::sig_atomic_t stopRequested = 0;
+
+	/// @brief Velikost rámce pro výpočet tp_frame_nr (TPACKET_V3 má rámce proměnné délky, jádro ji jen kontroluje)
+	constexpr std::uint32_t FrameSize = 2048;
+
+	/// @brief Jak dlouho čekat na blok, než znovu zkontrolujeme Stop()
+	constexpr int PollTimeoutMs = 100;
+
+	/**
+	 * @brief Nejmenší mocnina 2, která je >= `v` a >= velikost stránky
+	 */
+	std::uint32_t BlockSizeFor(std::uint32_t v)
+	{
+		std::uint32_t size = std::max<std::uint32_t>(sysconf(_SC_PAGESIZE), FrameSize);
+		while (size < v) {
+			size <<= 1;
+		}
+		return size;
+	}
+
+	/**
+	 * @brief Popis bloku na začátku bloku v ringu
+	 */
+	tpacket_block_desc * BlockAt(std::uint8_t * ring, std::size_t blockSize, std::uint32_t block)
+	{
+		return reinterpret_cast<tpacket_block_desc *>(ring + block * blockSize);
+	}
+
+	/**
+	 * @brief Zda je rozhraní loopback
+	 */
+	bool IsLoopback(int fd, const std::string & interface)
+	{
+		ifreq ifr {};
+		interface.copy(ifr.ifr_name, IFNAMSIZ - 1);
+		return ioctl(fd, SIOCGIFFLAGS, &ifr) == 0 && (ifr.ifr_flags & IFF_LOOPBACK);
+	}
+} // namespace
+
+namespace Netflow
+{
+	std::unique_ptr<AfPacketSource> AfPacketSource::Open(const std::string & interface, const RingConfig & ring,
+		const BpfFilter * filter)
+	{
+		const unsigned ifindex = if_nametoindex(interface.c_str());
+		if (ifindex == 0) {
+			Logger::LogError<>("Unknown interface " + interface);
+			return nullptr;
+		}
+
+		const int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+		if (fd == -1) {
+			Logger::LogError<>("Couldn't open AF_PACKET socket (needs CAP_NET_RAW): " + std::string(std::strerror(errno)));
+			return nullptr;
+		}
+		const auto fail = [fd](const std::string & what) -> std::unique_ptr<AfPacketSource> {
+			Logger::LogError<>(what + ": " + std::strerror(errno));
+			close(fd);
+			return nullptr;
+		};
+
+		if (filter != nullptr) {
+			// filtr připojíme před bind - do ringu se nedostane žádný nevyhovující paket
+			static_assert(sizeof(sock_filter) == sizeof(bpf_insn), "classic BPF instruction layout");
+			sock_fprog program {};
+			program.len = filter->Instructions().size();
+			program.filter = reinterpret_cast<sock_filter *>(const_cast<bpf_insn *>(filter->Instructions().data()));
+			if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) != 0) {
+				return fail("Couldn't attach filter \"" + filter->Expression() + "\"");
+			}
+		}
+
+		int version = TPACKET_V3;
+		if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0) {
+			return fail("Couldn't set TPACKET_V3");
+		}
+
+		tpacket_req3 req {};
+		req.tp_block_size = BlockSizeFor(ring.blockSize);
+		req.tp_block_nr = std::max<std::uint32_t>(ring.blockCount, 1);
+		req.tp_frame_size = FrameSize;
+		req.tp_frame_nr = req.tp_block_size / FrameSize * req.tp_block_nr;
+		req.tp_retire_blk_tov = ring.blockTimeoutMs;
+		if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) != 0) {
+			return fail("Couldn't create RX ring of " + std::to_string(req.tp_block_nr) + " x " + std::to_string(req.tp_block_size) + " bytes");
+		}
+
+		const std::size_t mapSize = static_cast<std::size_t>(req.tp_block_size) * req.tp_block_nr;
+		void * map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+		if (map == MAP_FAILED) {
+			// MAP_LOCKED může selhat na limitu RLIMIT_MEMLOCK; ring funguje i bez něj
+			map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		if (map == MAP_FAILED) {
+			return fail("Couldn't map RX ring");
+		}
+		std::unique_ptr<AfPacketSource> source(new AfPacketSource(fd, static_cast<std::uint8_t *>(map), req.tp_block_size, req.tp_block_nr));
+		// na loopbacku jádro doručí každý paket dvakrát (odchozí i příchozí) - stejně jako libpcap bereme jen příchozí
+		source->_skipOutgoing = IsLoopback(fd, interface);
+
+		sockaddr_ll addr {};
+		addr.sll_family = AF_PACKET;
+		addr.sll_protocol = htons(ETH_P_ALL);
+		addr.sll_ifindex = ifindex;
+		if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+			Logger::LogError<>("Couldn't bind to " + interface + ": " + std::strerror(errno));
+			return nullptr;
+		}
+
+		packet_mreq mreq {};
+		mreq.mr_ifindex = ifindex;
+		mreq.mr_type = PACKET_MR_PROMISC;
+		if (setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+			Logger::LogWarning<>("Couldn't enable promiscuous mode on " + interface);
+		}
+
+		Logger::LogInfo<>("Capturing on " + interface + " (ring of " + std::to_string(req.tp_block_nr) + " x "
+			+ std::to_string(req.tp_block_size) + " bytes)");
+		return source;
+	}
+
+	AfPacketSource::AfPacketSource(int fd, std::uint8_t * ring, std::size_t blockSize, std::uint32_t blockCount)
+		: _fd(fd), _ring(ring), _blockSize(blockSize), _blockCount(blockCount)
+	{
+	}
+
+	AfPacketSource::~AfPacketSource()
+	{
+		tpacket_stats_v3 stats {};
+		socklen_t len = sizeof(stats);
+		if (getsockopt(_fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0) {
+			const std::string msg = "Kernel received " + std::to_string(stats.tp_packets) + " packets, dropped "
+				+ std::to_string(stats.tp_drops) + " (ring full)";
+			if (stats.tp_drops > 0) {
+				Logger::LogWarning<>(msg);
+			}
+			else {
+				Logger::LogInfo<>(msg);
+			}
+		}
+		munmap(_ring, _blockSize * _blockCount);
+		close(_fd);
+	}
+
+	void AfPacketSource::Stop()
+	{
+		stopRequested = 1;
+	}
+
+	Packet AfPacketSource::GetNextPacket()
+	{
+		const tpacket3_hdr * hdr;
+		do {
+			while (_remaining == 0) {
+				if (!WaitForBlock()) {
+					return Packet {};
+				}
+			}
+			hdr = reinterpret_cast<const tpacket3_hdr *>(_next);
+			_remaining--;
+			_next += hdr->tp_next_offset;
+		} while (_skipOutgoing && IsOutgoing(hdr));
+
+		_header.ts.tv_sec = hdr->tp_sec;
+		_header.ts.tv_usec = hdr->tp_nsec / 1000;
+		_header.caplen = hdr->tp_snaplen;
+		_header.len = hdr->tp_len;
+
+		Packet pkt;
+		pkt.pktHeader = &_header;
+		pkt.pktData = reinterpret_cast<const std::uint8_t *>(hdr) + hdr->tp_mac;
+		return pkt;
+	}
+
+	bool AfPacketSource::IsOutgoing(const tpacket3_hdr * hdr)
+	{
+		// za hlavičkou paketu následuje sockaddr_ll s typem paketu
+		const auto * ll = reinterpret_cast<const sockaddr_ll *>(reinterpret_cast<const std::uint8_t *>(hdr)
+			+ TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+		return ll->sll_pkttype == PACKET_OUTGOING;
+	}
+
+	bool AfPacketSource::WaitReadable(int wakeFd)
+	{
+		if (_remaining > 0) {
+			return true;
+		}
+		if (_next != nullptr) {
+			// přečtený blok vrátíme jádru hned - dokud ho držíme, packet_poll() hlásí POLLIN a poll() by se točil
+			ReleaseBlock();
+		}
+		pollfd fds[2] {{_fd, POLLIN | POLLERR, 0}, {wakeFd, POLLIN, 0}};
+		while (!stopRequested && !BlockReady(_block)) {
+			if (poll(fds, 2, PollTimeoutMs) < 0 && errno != EINTR) {
+				// chybu ohlásí GetNextPacket()
+				return true;
+			}
+			if (fds[1].revents & POLLIN) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool AfPacketSource::BlockReady(std::uint32_t block) const
+	{
+		return __atomic_load_n(&BlockAt(_ring, _blockSize, block)->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER;
+	}
+
+	bool AfPacketSource::WaitForBlock()
+	{
+		if (_next != nullptr) {
+			// pakety předchozího bloku už nikdo nepotřebuje (platí jen do dalšího GetNextPacket())
+			ReleaseBlock();
+		}
+
+		tpacket_block_desc * block = BlockAt(_ring, _blockSize, _block);
+		while (!BlockReady(_block)) {
+			if (stopRequested) {
+				return false;
+			}
+			pollfd pfd {_fd, POLLIN | POLLERR, 0};
+			if (poll(&pfd, 1, PollTimeoutMs) < 0 && errno != EINTR) {
+				Logger::LogError<>("poll failed: " + std::string(std::strerror(errno)));
+				return false;
+			}
+		}
+
+		_remaining = block->hdr.bh1.num_pkts;
+		_next = reinterpret_cast<const std::uint8_t *>(block) + block->hdr.bh1.offset_to_first_pkt;
+		LOG_DEBUG("Block " + std::to_string(_block) + " with " + std::to_string(_remaining) + " packets");
+		if (_remaining == 0) {
+			ReleaseBlock();
+		}
+		return true;
+	}
+
+	void AfPacketSource::ReleaseBlock()
+	{
+		tpacket_block_desc * block = BlockAt(_ring, _blockSize, _block);
+		__atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+		_block = (_block + 1) % _blockCount;
+		_next = nullptr;
+	}
+} // namespace Netflow
@@ -0,0 +1,135 @@
+/**
+ * @file af_packet_source.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Živé zachytávání z rozhraní přes AF_PACKET s mmap RX ringem (TPACKET_V3)
+ */
+
+#pragma once
+
+#include "packet_source.h"
+#include "bpf_filter.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct tpacket3_hdr;
+
+namespace Netflow
+{
+	/**
+	 * @brief Nastavení RX ringu
+	 */
+	struct RingConfig
+	{
+		std::uint32_t blockSize {1 << 20};  ///< Velikost bloku v bytech (zaokrouhlí se na mocninu 2, alespoň stránku)
+		std::uint32_t blockCount {64};      ///< Počet bloků
+		std::uint32_t blockTimeoutMs {10};  ///< Po jaké době jádro předá i neúplně zaplněný blok
+	};
+
+	/**
+	 * @brief Zdroj paketů z rozhraní. Jádro zapisuje pakety do bloků ringu sdíleného přes mmap; pakety se vrací
+	 * přímo z ringu (bez kopírování) a blok se jádru vrací, až když jsou přečteny všechny jeho pakety.
+	 * Vrácený paket je platný do dalšího volání GetNextPacket().
+	 */
+	class AfPacketSource : public PacketSource
+	{
+	public:
+		/**
+		 * @brief Otevře socket, vytvoří ring a připojí se k rozhraní (v promiskuitním režimu)
+		 *
+		 * @param interface jméno rozhraní
+		 * @param ring nastavení ringu
+		 * @param filter BPF filtr připojený k socketu - nevyhovující pakety zahodí jádro, do ringu se nedostanou
+		 * (nullptr = bez filtru)
+		 * @return std::unique_ptr<AfPacketSource> zdroj nebo nullptr při chybě (chybí oprávnění, rozhraní neexistuje, ...)
+		 */
+		static std::unique_ptr<AfPacketSource> Open(const std::string & interface, const RingConfig & ring,
+			const BpfFilter * filter = nullptr);
+
+		/**
+		 * @brief Destruktor - vypíše statistiky jádra, zruší mapování a zavře socket
+		 */
+		~AfPacketSource() override;
+
+		/**
+		 * @brief Vrátí další paket; čeká, dokud nějaký nepřijde
+		 *
+		 * @return Packet paket; nullptr po Stop() nebo při chybě
+		 */
+		Packet GetNextPacket() override;
+
+		bool IsLive() const override
+		{
+			return true;
+		}
+
+		bool WaitReadable(int wakeFd) override;
+
+		/**
+		 * @brief Ukončí zachytávání - GetNextPacket() vrátí konec dat. Bezpečné volat z obsluhy signálu.
+		 */
+		static void Stop();
+	private:
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param fd socket
+		 * @param ring začátek mapování
+		 * @param blockSize velikost bloku
+		 * @param blockCount počet bloků
+		 */
+		AfPacketSource(int fd, std::uint8_t * ring, std::size_t blockSize, std::uint32_t blockCount);
+
+		/// @brief Socket
+		const int _fd;
+
+		/// @brief Začátek mapování ringu
+		std::uint8_t * const _ring;
+
+		/// @brief Velikost bloku
+		const std::size_t _blockSize;
+
+		/// @brief Počet bloků
+		const std::uint32_t _blockCount;
+
+		/// @brief Aktuální blok
+		std::uint32_t _block = 0;
+
+		/// @brief Zbývající pakety v aktuálním bloku (0 = blok ještě nepatří nám)
+		std::uint32_t _remaining = 0;
+
+		/// @brief Hlavička dalšího paketu v aktuálním bloku
+		const std::uint8_t * _next = nullptr;
+
+		/// @brief Hlavička naposledy vráceného paketu
+		pcap_pkthdr _header {};
+
+		/// @brief Přeskakovat odchozí pakety (loopback)
+		bool _skipOutgoing = false;
+
+		/**
+		 * @brief Zda jde o paket odeslaný z tohoto stroje
+		 */
+		static bool IsOutgoing(const tpacket3_hdr * hdr);
+
+		/**
+		 * @brief Zda jádro předalo blok `block`
+		 */
+		bool BlockReady(std::uint32_t block) const;
+
+		/**
+		 * @brief Počká, až jádro předá aktuální blok
+		 *
+		 * @return true blok je připraven
+		 * @return false Stop() nebo chyba
+		 */
+		bool WaitForBlock();
+
+		/**
+		 * @brief Vrátí aktuální blok jádru a přejde na další
+		 */
+		void ReleaseBlock();
+	};
+} // namespace Netflow
@@ -0,0 +1,61 @@
+/**
+ * @file e2e_bench.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief End-to-end benchmark - vygeneruje pcap, spustí NetflowExporter proti loopback UDP kolektoru a vypíše
+ * pakety/s a flow/s
+ */
+
+#include "synthetic_capture.h"
+#include "udp_sink.h"
+
+#include "netflow_exporter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+int main(int argc, char **argv)
+{
+	using namespace Netflow;
+
+	const auto config = NetflowBench::CaptureConfig::FromArgs(argc, argv);
+	const std::uint32_t threads = std::stoul(NetflowBench::ArgValue(argc, argv, "threads", "1"));
+	const std::uint32_t burst = std::stoul(NetflowBench::ArgValue(argc, argv, "burst", "64"));
+	const std::uint32_t cacheSize = std::stoul(NetflowBench::ArgValue(argc, argv, "cache", "65536"));
+	const std::uint32_t activeTimer = std::stoul(NetflowBench::ArgValue(argc, argv, "active", "60"));
+	const std::uint32_t interval = std::stoul(NetflowBench::ArgValue(argc, argv, "inactive", "10"));
+	const std::uint32_t granularity = std::stoul(NetflowBench::ArgValue(argc, argv, "granularity", "1000"));
+	const std::string format = NetflowBench::ArgValue(argc, argv, "format", "v5");
+	const std::uint32_t mtu = std::stoul(NetflowBench::ArgValue(argc, argv, "mtu", "1500"));
+
+	char file[] = "/tmp/netflow_e2e_XXXXXX";
+	const int fd = mkstemp(file);
+	close(fd);
+	if (!NetflowBench::SyntheticCapture::WriteFile(config, file)) {
+		std::cerr << "Couldn't write " << file << "\n";
+		return 1;
+	}
+
+	NetflowBench::UdpSink sink;
+	const std::string collectorIp = "127.0.0.1";
+	NetflowExporter exporter({file}, {{collectorIp, sink.Port()}}, ExporterConfig {activeTimer, interval, cacheSize, granularity, threads, burst},
+		BatchConfig {}, ExportConfig {format == "ipfix" ? ExportFormat::Ipfix : ExportFormat::NetflowV5, mtu}, SamplingConfig {});
+
+	const auto start = std::chrono::steady_clock::now();
+	exporter.Run();
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	sink.WaitIdle(200);
+	std::remove(file);
+
+	const double seconds = elapsed.count();
+	std::cout << "packets: " << config.packets << "\n"
+		<< "time: " << seconds << " s\n"
+		<< "packets/s: " << static_cast<std::uint64_t>(config.packets / seconds) << "\n"
+		<< "flows: " << sink.Records() << " (" << sink.Datagrams() << " datagrams)\n"
+		<< "flows/s: " << static_cast<std::uint64_t>(sink.Records() / seconds) << "\n";
+	return 0;
+}
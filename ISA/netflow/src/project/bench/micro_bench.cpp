@@ -0,0 +1,157 @@
+/**
+ * @file micro_bench.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Microbenchmarky jednotlivých fází exportéru - ParsePacket, FlowCache::AddNewRecord (po paketech i po dávkách) a ExportFlows (v5 i IPFIX)
+ */
+
+#include "synthetic_capture.h"
+#include "udp_sink.h"
+
+#include "netflow_exporter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace
+{
+	using namespace Netflow;
+
+	/**
+	 * @brief Spustí `f` `rounds`-krát a vypíše počet položek za sekundu
+	 */
+	template <typename F>
+	std::uint64_t Measure(const std::string & name, const std::string & unit, std::uint64_t items, std::uint32_t rounds, F f)
+	{
+		std::uint64_t checksum = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (std::uint32_t i = 0; i < rounds; i++) {
+			checksum += f();
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		std::cout << name << ": " << static_cast<std::uint64_t>(items * rounds / elapsed.count()) << " " << unit << "/s\n";
+		return checksum;
+	}
+} // namespace
+
+int main(int argc, char **argv)
+{
+	auto config = NetflowBench::CaptureConfig::FromArgs(argc, argv);
+	const std::uint32_t rounds = std::stoul(NetflowBench::ArgValue(argc, argv, "rounds", "5"));
+	const std::uint32_t cacheSize = std::stoul(NetflowBench::ArgValue(argc, argv, "cache", "65536"));
+	const std::uint32_t activeTimer = std::stoul(NetflowBench::ArgValue(argc, argv, "active", "60"));
+	const std::uint32_t interval = std::stoul(NetflowBench::ArgValue(argc, argv, "inactive", "10"));
+
+	// pakety v paměti, aby se neměřilo čtení
+	std::vector<pcap_pkthdr> headers(config.packets);
+	std::vector<std::uint8_t> data(config.packets * NetflowBench::SyntheticCapture::MaxCaplen);
+	{
+		NetflowBench::SyntheticCapture capture(config);
+		for (std::uint64_t i = 0; i < config.packets; i++) {
+			capture.Next(headers[i], &data[i * NetflowBench::SyntheticCapture::MaxCaplen]);
+		}
+	}
+
+	std::uint64_t checksum = 0;
+
+	// ParsePacket
+	checksum += Measure("ParsePacket", "packets", config.packets, rounds, [&]() {
+		std::uint64_t sum = 0;
+		for (std::uint64_t i = 0; i < config.packets; i++) {
+			const auto parsed = NetflowExporter::ParsePacket(&data[i * NetflowBench::SyntheticCapture::MaxCaplen], headers[i].caplen);
+			sum += static_cast<std::uint64_t>(parsed.protocol);
+		}
+		return sum;
+	});
+
+	// AddNewRecord (včetně expirace a vyřazování - tak, jak ho volá Loop())
+	std::vector<FlowPacket> packets;
+	packets.reserve(config.packets);
+	for (std::uint64_t i = 0; i < config.packets; i++) {
+		const auto parsed = NetflowExporter::ParsePacket(&data[i * NetflowBench::SyntheticCapture::MaxCaplen], headers[i].caplen);
+		if (parsed.ipVersion != IpVersion::None) {
+			packets.push_back(FlowPacket::FromPacket(parsed, headers[i].ts));
+		}
+	}
+
+	std::vector<FlowRecord> records;
+	checksum += Measure("FlowCache::AddNewRecord", "packets", packets.size(), rounds, [&]() {
+		FlowCache cache(activeTimer, interval, cacheSize, 1000);
+		records.clear();
+		for (const auto & pkt : packets) {
+			cache.ExpireFlows(pkt.ts);
+			cache.AddNewRecord(pkt);
+			cache.EvictIfFull();
+			records.insert(records.end(), cache.Expired().begin(), cache.Expired().end());
+			cache.Expired().clear();
+		}
+		cache.Flush();
+		records.insert(records.end(), cache.Expired().begin(), cache.Expired().end());
+		return records.size();
+	});
+	std::cout << "  flows exported: " << records.size() << "\n";
+
+	// totéž po dávkách s prefetchem (jako Loop() s -B)
+	const std::uint32_t burst = std::stoul(NetflowBench::ArgValue(argc, argv, "burst", "64"));
+	std::uint64_t burstRecords = 0;
+	checksum += Measure("FlowCache::AddNewRecord (burst " + std::to_string(burst) + ")", "packets", packets.size(), rounds, [&]() {
+		FlowCache cache(activeTimer, interval, cacheSize, 1000);
+		burstRecords = 0;
+		for (std::size_t i = 0; i < packets.size(); i += burst) {
+			const std::uint32_t n = std::min<std::size_t>(burst, packets.size() - i);
+			cache.ExpireFlows(packets[i].ts);
+			cache.Prefetch(&packets[i], n);
+			for (std::uint32_t j = 0; j < n; j++) {
+				cache.AddNewRecord(packets[i + j]);
+				cache.EvictIfFull();
+			}
+			burstRecords += cache.Expired().size();
+			cache.Expired().clear();
+		}
+		cache.Flush();
+		burstRecords += cache.Expired().size();
+		return burstRecords;
+	});
+	std::cout << "  flows exported: " << burstRecords << "\n";
+
+	// ExportFlows - po NetflowV5MaxRecords záznamech, jako při exportu expirovaných záznamů
+	char file[] = "/tmp/netflow_micro_XXXXXX";
+	const int fd = mkstemp(file);
+	close(fd);
+	config.packets = 1;
+	NetflowBench::SyntheticCapture::WriteFile(config, file);
+
+	const std::string collectorIp = "127.0.0.1";
+	for (const auto format : {ExportFormat::NetflowV5, ExportFormat::Ipfix}) {
+		NetflowBench::UdpSink sink;
+		NetflowExporter exporter({file}, {{collectorIp, sink.Port()}}, ExporterConfig {activeTimer, interval, cacheSize, 1000, 1, 1},
+			BatchConfig {}, ExportConfig {format, 1500}, SamplingConfig {});
+
+		std::vector<FlowRecord> chunk;
+		chunk.reserve(NetflowV5MaxRecords);
+		const std::string name = format == ExportFormat::Ipfix ? "ExportFlows (IPFIX)" : "ExportFlows (v5)";
+		checksum += Measure(name, "records", records.size(), rounds, [&]() {
+			for (std::size_t i = 0; i < records.size(); i += NetflowV5MaxRecords) {
+				const std::size_t n = std::min<std::size_t>(NetflowV5MaxRecords, records.size() - i);
+				chunk.assign(records.begin() + i, records.begin() + i + n);
+				exporter.ExportFlows(chunk);
+			}
+			exporter.FlushExports();
+			return records.size();
+		});
+		sink.WaitIdle(100);
+		std::cout << "  received: " << sink.Datagrams() << " datagrams, " << sink.Records() << " records\n";
+	}
+	std::remove(file);
+
+	// aby překladač výpočet nevyhodil
+	std::cerr << "checksum: " << checksum << "\n";
+	return 0;
+}
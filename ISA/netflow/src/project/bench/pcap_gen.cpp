@@ -0,0 +1,25 @@
+/**
+ * @file pcap_gen.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Generátor syntetického pcap souboru pro měření exportéru
+ */
+
+#include "synthetic_capture.h"
+
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || std::string(argv[1]).find('=') != std::string::npos) {
+		std::cerr << "Usage: " << argv[0] << " <out.pcap> [flows=N] [packets=N] [zipf=S] [duration=SEC] [lifetime=SEC] [ipv6=FRACTION] [seed=N]\n";
+		return 1;
+	}
+
+	const auto config = NetflowBench::CaptureConfig::FromArgs(argc, argv);
+	if (!NetflowBench::SyntheticCapture::WriteFile(config, argv[1])) {
+		std::cerr << "Couldn't write " << argv[1] << "\n";
+		return 1;
+	}
+	std::cout << "Written " << config.packets << " packets of " << config.flows << " flows to " << argv[1] << "\n";
+	return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file serialize_bench.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Microbenchmark serializace NetFlow v5 datagramů - původní způsob (vector + insert, dvojité htons/htonl)
+ * proti zápisu do předalokovaného bufferu.
+ */
+
+#include "netflow_datagram.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+
+namespace
+{
+	/// Původní serializace 2 a 4 bytů (každé pole volá htons/htonl dvakrát)
+	#define LEGACY_S2B(v) static_cast<uint8_t>(htons(v)), static_cast<uint8_t>(htons(v) >> 8)
+	#define LEGACY_S4B(v) static_cast<uint8_t>(htonl(v)), static_cast<uint8_t>(htonl(v) >> 8), static_cast<uint8_t>(htonl(v) >> 16), static_cast<uint8_t>(htonl(v) >> 24)
+
+	using namespace Netflow;
+
+	std::array<uint8_t, NetflowV5HeaderSize> LegacySerialize(const NetflowV5Header & h)
+	{
+		return {
+			LEGACY_S2B(h.version), LEGACY_S2B(h.count), LEGACY_S4B(h.sysUptime), LEGACY_S4B(h.unixSecs), LEGACY_S4B(h.unixNsecs),
+			LEGACY_S4B(h.flowSequence), h.engineType, h.engineId, LEGACY_S2B(h.samplingInterval)
+		};
+	}
+
+	std::array<uint8_t, NetflowV5RecordSize> LegacySerialize(const NetflowV5FlowRecord & r)
+	{
+		return {
+			LEGACY_S4B(r.srcAddr), LEGACY_S4B(r.dstAddr), LEGACY_S4B(r.nextHop), LEGACY_S2B(r.input), LEGACY_S2B(r.output),
+			LEGACY_S4B(r.dPkts), LEGACY_S4B(r.dOctets), LEGACY_S4B(r.first), LEGACY_S4B(r.last), LEGACY_S2B(r.srcPort),
+			LEGACY_S2B(r.dstPort), r.pad1, r.tcpFlags, r.prot, r.tos, LEGACY_S2B(r.srcAs), LEGACY_S2B(r.dstAs), r.srcMask,
+			r.dstMask, LEGACY_S2B(r.pad2)
+		};
+	}
+
+	/**
+	 * @brief Původní ExportFlows: nový vector pro každý datagram, insert dočasných polí
+	 */
+	std::uint64_t LegacyExport(const std::vector<NetflowV5FlowRecord> & records)
+	{
+		std::uint64_t checksum = 0;
+		std::vector<std::uint8_t> data;
+		for (std::size_t i = 0; i < records.size(); i += NetflowV5MaxRecords) {
+			const std::size_t n = std::min<std::size_t>(NetflowV5MaxRecords, records.size() - i);
+			NetflowV5Header h {};
+			h.count = n;
+			h.flowSequence = i;
+
+			auto hdr = LegacySerialize(h);
+			data.insert(data.end(), &hdr[0], &hdr[hdr.size()]);
+			for (std::size_t j = 0; j < n; j++) {
+				auto rec = LegacySerialize(records[i + j]);
+				data.insert(data.end(), &rec[0], &rec[rec.size()]);
+			}
+			checksum += data[data.size() - 1] + data.size();
+			data = std::vector<std::uint8_t>();
+		}
+		return checksum;
+	}
+
+	/**
+	 * @brief Současný ExportFlows: zápis do jednoho předalokovaného bufferu
+	 */
+	std::uint64_t BufferExport(const std::vector<NetflowV5FlowRecord> & records, std::array<std::uint8_t, NetflowV5MaxDatagramSize> & buffer)
+	{
+		std::uint64_t checksum = 0;
+		for (std::size_t i = 0; i < records.size(); i += NetflowV5MaxRecords) {
+			const std::size_t n = std::min<std::size_t>(NetflowV5MaxRecords, records.size() - i);
+			NetflowV5Header h {};
+			h.count = n;
+			h.flowSequence = i;
+
+			std::uint8_t * out = h.SerializeTo(buffer.data());
+			for (std::size_t j = 0; j < n; j++) {
+				out = records[i + j].SerializeTo(out);
+			}
+			checksum += out[-1] + (out - buffer.data());
+		}
+		return checksum;
+	}
+
+	/**
+	 * @brief Spustí `f` `rounds`-krát a vypíše počet záznamů za sekundu
+	 */
+	template <typename F>
+	std::uint64_t Measure(const std::string & name, std::size_t nRecords, std::uint32_t rounds, F f)
+	{
+		std::uint64_t checksum = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (std::uint32_t i = 0; i < rounds; i++) {
+			checksum += f();
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		std::cout << name << ": " << static_cast<std::uint64_t>(nRecords * rounds / elapsed.count()) << " records/s\n";
+		return checksum;
+	}
+} // namespace
+
+int main(int argc, char **argv)
+{
+	const std::size_t nRecords = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+	const std::uint32_t rounds = argc > 2 ? std::stoul(argv[2]) : 10;
+
+	std::mt19937 rng(42);
+	std::vector<NetflowV5FlowRecord> records(nRecords);
+	for (auto & r : records) {
+		r.srcAddr = rng();
+		r.dstAddr = rng();
+		r.dPkts = rng() % 1000;
+		r.dOctets = rng();
+		r.first = rng();
+		r.last = r.first + rng() % 60;
+		r.srcPort = rng();
+		r.dstPort = rng();
+		r.prot = 6;
+	}
+
+	std::array<std::uint8_t, NetflowV5MaxDatagramSize> buffer;
+	std::uint64_t checksum = 0;
+	checksum += Measure("legacy (vector + insert)", nRecords, rounds, [&records]() { return LegacyExport(records); });
+	checksum += Measure("preallocated buffer", nRecords, rounds, [&records, &buffer]() { return BufferExport(records, buffer); });
+
+	// aby překladač výpočet nevyhodil
+	std::cerr << "checksum: " << checksum << "\n";
+	return 0;
+}
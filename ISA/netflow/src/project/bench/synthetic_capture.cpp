@@ -0,0 +1,202 @@
+/**
+ * @file synthetic_capture.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "synthetic_capture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	/// @brief Čas prvního paketu
+	constexpr std::uint64_t StartSec = 1'600'000'000;
+
+	/// @brief Cílové porty TCP/UDP flow
+	constexpr std::uint16_t DstPorts[] = {80, 443, 53, 22, 8080, 123, 5060, 3306};
+
+	/**
+	 * @brief Promíchá číslo (SplitMix64) - odvozuje vlastnosti flow z jeho indexu
+	 */
+	std::uint64_t Mix(std::uint64_t x)
+	{
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+
+	void Put16(std::uint8_t * out, std::uint16_t v)
+	{
+		out[0] = v >> 8;
+		out[1] = v;
+	}
+
+	void Put32(std::uint8_t * out, std::uint32_t v)
+	{
+		out[0] = v >> 24;
+		out[1] = v >> 16;
+		out[2] = v >> 8;
+		out[3] = v;
+	}
+} // namespace
+
+namespace NetflowBench
+{
+	CaptureConfig CaptureConfig::FromArgs(int argc, char **argv)
+	{
+		CaptureConfig c;
+		c.flows = std::stoul(ArgValue(argc, argv, "flows", std::to_string(c.flows)));
+		c.packets = std::stoull(ArgValue(argc, argv, "packets", std::to_string(c.packets)));
+		c.zipf = std::stod(ArgValue(argc, argv, "zipf", std::to_string(c.zipf)));
+		c.duration = std::stod(ArgValue(argc, argv, "duration", std::to_string(c.duration)));
+		c.lifetime = std::stod(ArgValue(argc, argv, "lifetime", std::to_string(c.lifetime)));
+		c.ipv6 = std::stod(ArgValue(argc, argv, "ipv6", std::to_string(c.ipv6)));
+		c.seed = std::stoul(ArgValue(argc, argv, "seed", std::to_string(c.seed)));
+		c.flows = std::max<std::uint32_t>(c.flows, 1);
+		return c;
+	}
+
+	std::string ArgValue(int argc, char **argv, const std::string & key, const std::string & def)
+	{
+		const std::string prefix = key + "=";
+		for (int i = 1; i < argc; i++) {
+			const std::string arg(argv[i]);
+			if (arg.compare(0, prefix.size(), prefix) == 0) {
+				return arg.substr(prefix.size());
+			}
+		}
+		return def;
+	}
+
+	SyntheticCapture::SyntheticCapture(const CaptureConfig & config) : _config(config), _rng(config.seed)
+	{
+		_cdf.resize(_config.flows);
+		double sum = 0;
+		for (std::uint32_t i = 0; i < _config.flows; i++) {
+			sum += 1.0 / std::pow(i + 1.0, _config.zipf);
+			_cdf[i] = sum;
+		}
+		for (auto & c : _cdf) {
+			c /= sum;
+		}
+	}
+
+	std::uint32_t SyntheticCapture::PickFlow()
+	{
+		const double u = std::uniform_real_distribution<double>(0.0, 1.0)(_rng);
+		const auto it = std::lower_bound(_cdf.begin(), _cdf.end(), u);
+		// pořadí popularity nezávislé na adresách
+		const std::uint32_t rank = std::min<std::size_t>(it - _cdf.begin(), _config.flows - 1);
+		return Mix(rank) % _config.flows;
+	}
+
+	bool SyntheticCapture::Next(pcap_pkthdr & header, std::uint8_t * data)
+	{
+		if (_generated >= _config.packets) {
+			return false;
+		}
+
+		const double t = _config.duration * _generated / _config.packets;
+		_generated++;
+		header.ts.tv_sec = StartSec + static_cast<std::uint64_t>(t);
+		header.ts.tv_usec = static_cast<std::uint64_t>((t - std::floor(t)) * 1'000'000);
+
+		const std::uint32_t flow = PickFlow();
+		const std::uint64_t props = Mix(flow ^ (static_cast<std::uint64_t>(_config.seed) << 32));
+		const bool ipv6 = static_cast<double>(props % 1'000'000) / 1'000'000 < _config.ipv6;
+		const std::uint32_t protSel = (props >> 20) % 10;
+		const std::uint8_t prot = protSel < 7 ? 6 : (protSel < 9 ? 17 : 1);
+
+		// obměna spojení: každé flow má vlastní fázi, aby se neobměnila všechna naráz
+		std::uint64_t generation = 0;
+		if (_config.lifetime > 0) {
+			const double phase = static_cast<double>((props >> 32) % 1000) / 1000 * _config.lifetime;
+			generation = static_cast<std::uint64_t>((t + phase) / _config.lifetime);
+		}
+		const std::uint16_t srcPort = 1024 + (flow * 7 + generation * 7919) % 64000;
+		const std::uint16_t dstPort = DstPorts[(props >> 40) % (sizeof(DstPorts) / sizeof(DstPorts[0]))];
+		const std::uint32_t payload = std::uniform_int_distribution<std::uint32_t>(0, 1400)(_rng);
+
+		std::memset(data, 0, MaxCaplen);
+		std::uint8_t * out = data + 12;
+		Put16(out, ipv6 ? 0x86DD : 0x0800);
+		out += 2;
+
+		const std::uint32_t l4Size = prot == 6 ? 20 : 8;
+		const std::uint32_t srcAddr = 0x0A000000 | (flow & 0x00FFFFFF);
+		const std::uint32_t dstAddr = 0xC0A80000 | ((props >> 48) & 0xFFFF);
+		if (ipv6) {
+			out[0] = 0x60;
+			Put16(out + 4, l4Size + payload);
+			out[6] = prot == 1 ? 58 : prot;
+			out[7] = 64;
+			Put16(out + 8, 0x2001);
+			Put32(out + 20, srcAddr);
+			Put16(out + 24, 0x2001);
+			Put32(out + 36, dstAddr);
+			out += 40;
+		}
+		else {
+			out[0] = 0x45;
+			Put16(out + 2, 20 + l4Size + payload);
+			out[8] = 64;
+			out[9] = prot;
+			Put32(out + 12, srcAddr);
+			Put32(out + 16, dstAddr);
+			out += 20;
+		}
+
+		if (prot == 6) {
+			Put16(out, srcPort);
+			Put16(out + 2, dstPort);
+			out[12] = 5 << 4;
+			out[13] = 0x18; // ACK | PSH
+		}
+		else if (prot == 17) {
+			Put16(out, srcPort);
+			Put16(out + 2, dstPort);
+			Put16(out + 4, 8 + payload);
+		}
+		else {
+			out[0] = 8; // echo request
+		}
+		out += l4Size;
+
+		header.caplen = out - data;
+		header.len = header.caplen + payload;
+		return true;
+	}
+
+	bool SyntheticCapture::WriteFile(const CaptureConfig & config, const std::string & file)
+	{
+		std::ofstream f(file, std::ios::binary);
+		if (!f) {
+			return false;
+		}
+
+		// klasický pcap v pořadí bytů hostitele, mikrosekundy, ethernet
+		const std::uint32_t magic = 0xA1B2C3D4;
+		const std::uint16_t version[2] = {2, 4};
+		const std::uint32_t rest[4] = {0, 0, 65535, 1};
+		f.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+		f.write(reinterpret_cast<const char *>(version), sizeof(version));
+		f.write(reinterpret_cast<const char *>(rest), sizeof(rest));
+
+		SyntheticCapture capture(config);
+		pcap_pkthdr header {};
+		std::uint8_t data[MaxCaplen];
+		while (capture.Next(header, data)) {
+			const std::uint32_t record[4] = {
+				static_cast<std::uint32_t>(header.ts.tv_sec), static_cast<std::uint32_t>(header.ts.tv_usec), header.caplen, header.len
+			};
+			f.write(reinterpret_cast<const char *>(record), sizeof(record));
+			f.write(reinterpret_cast<const char *>(data), header.caplen);
+		}
+		return static_cast<bool>(f);
+	}
+} // namespace NetflowBench
@@ -0,0 +1,111 @@
+/**
+ * @file synthetic_capture.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Generátor syntetického provozu (pcap) pro benchmarky
+ */
+
+#pragma once
+
+#include <pcap.h>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace NetflowBench
+{
+	/**
+	 * @brief Nastavení generovaného provozu
+	 */
+	struct CaptureConfig
+	{
+		std::uint32_t flows {10'000};       ///< Počet různých flow (klíčů)
+		std::uint64_t packets {1'000'000};  ///< Počet paketů
+		double zipf {1.0};                  ///< Exponent Zipfova rozdělení popularity flow (0 = rovnoměrné)
+		double duration {60.0};             ///< Délka zachyceného provozu v sekundách (> active timer -> active timeouty)
+		double lifetime {0.0};              ///< Životnost spojení v sekundách; poté flow dostane nový zdrojový port
+		                                    ///< (staré flow vyprší inactive timeoutem). 0 = bez obměny
+		double ipv6 {0.0};                  ///< Podíl IPv6 flow (0-1)
+		std::uint32_t seed {42};            ///< Seed generátoru
+
+		/**
+		 * @brief Načte hodnoty z argumentů ve tvaru `klíč=hodnota` (flows, packets, zipf, duration, lifetime, ipv6, seed);
+		 * ostatní argumenty ignoruje
+		 *
+		 * @param argc počet argumentů
+		 * @param argv argumenty
+		 * @return CaptureConfig nastavení
+		 */
+		static CaptureConfig FromArgs(int argc, char **argv);
+	};
+
+	/**
+	 * @brief Hodnota argumentu `klíč=hodnota`
+	 *
+	 * @param argc počet argumentů
+	 * @param argv argumenty
+	 * @param key klíč
+	 * @param def výchozí hodnota, pokud argument chybí
+	 * @return std::string hodnota
+	 */
+	std::string ArgValue(int argc, char **argv, const std::string & key, const std::string & def);
+
+	/**
+	 * @brief Syntetický ethernet provoz - TCP (70 %), UDP (20 %) a ICMP (10 %) flow, IPv4 i IPv6. Flow se vybírají podle
+	 * Zipfova rozdělení, časy paketů jsou rovnoměrně rozložené v `duration`. Zachycují se pouze hlavičky (caplen),
+	 * `len` zahrnuje i náhodnou velikost payloadu.
+	 */
+	class SyntheticCapture
+	{
+	public:
+		/// @brief Maximální caplen (ethernet + IPv6 + TCP)
+		static constexpr std::uint32_t MaxCaplen = 14 + 40 + 20;
+
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param config nastavení
+		 */
+		SyntheticCapture(const CaptureConfig & config);
+
+		/**
+		 * @brief Vygeneruje další paket
+		 *
+		 * @param header hlavička (čas, caplen, len)
+		 * @param data buffer, alespoň MaxCaplen bytů
+		 * @return true paket byl vygenerován
+		 * @return false všechny pakety už byly vygenerovány
+		 */
+		bool Next(pcap_pkthdr & header, std::uint8_t * data);
+
+		/**
+		 * @brief Zapíše celý provoz do klasického pcap souboru
+		 *
+		 * @param config nastavení
+		 * @param file výstupní soubor
+		 * @return true zapsáno
+		 * @return false soubor nelze zapsat
+		 */
+		static bool WriteFile(const CaptureConfig & config, const std::string & file);
+	private:
+		/// @brief Nastavení
+		const CaptureConfig _config;
+
+		/// @brief Kumulativní pravděpodobnosti flow (Zipf)
+		std::vector<double> _cdf;
+
+		/// @brief Generátor
+		std::mt19937_64 _rng;
+
+		/// @brief Počet vygenerovaných paketů
+		std::uint64_t _generated = 0;
+
+		/**
+		 * @brief Vybere flow podle Zipfova rozdělení
+		 *
+		 * @return std::uint32_t index flow
+		 */
+		std::uint32_t PickFlow();
+	};
+} // namespace NetflowBench
@@ -0,0 +1,109 @@
+/**
+ * @file udp_sink.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "udp_sink.h"
+
+#include "ipfix_datagram.h"
+
+#include <chrono>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace NetflowBench
+{
+	UdpSink::UdpSink()
+	{
+		_socket = socket(AF_INET, SOCK_DGRAM, 0);
+
+		// velký buffer - exportér posílá rychleji, než stíháme číst
+		int bufSize = 64 << 20;
+		setsockopt(_socket, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+		timeval timeout {0, 50'000};
+		setsockopt(_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+		sockaddr_in addr {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+		bind(_socket, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+
+		socklen_t len = sizeof(addr);
+		getsockname(_socket, reinterpret_cast<sockaddr *>(&addr), &len);
+		_port = ntohs(addr.sin_port);
+
+		_thread = std::thread(&UdpSink::Receive, this);
+	}
+
+	UdpSink::~UdpSink()
+	{
+		_stop.store(true, std::memory_order_relaxed);
+		_thread.join();
+		close(_socket);
+	}
+
+	void UdpSink::WaitIdle(std::uint32_t idleMs)
+	{
+		std::uint64_t last = Datagrams();
+		while (true) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(idleMs));
+			const std::uint64_t now = Datagrams();
+			if (now == last) {
+				return;
+			}
+			last = now;
+		}
+	}
+
+	void UdpSink::Receive()
+	{
+		std::uint8_t buffer[Netflow::IpfixMaxMessageSize];
+		while (!_stop.load(std::memory_order_relaxed)) {
+			const ssize_t n = recv(_socket, buffer, sizeof(buffer), 0);
+			if (n <= 0) {
+				continue;
+			}
+			_records.fetch_add(CountRecords(buffer, n), std::memory_order_relaxed);
+			_datagrams.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	std::uint64_t UdpSink::CountRecords(const std::uint8_t * data, std::size_t size)
+	{
+		if (size < 4) {
+			return 0;
+		}
+		const std::uint8_t * in = data;
+		const std::uint16_t version = Get16(in);
+		if (version == 5) {
+			return Get16(in);
+		}
+		if (version != 10) {
+			return 0;
+		}
+
+		std::uint64_t records = 0;
+		for (std::size_t off = Netflow::IpfixHeaderSize; off + Netflow::IpfixSetHeaderSize <= size;) {
+			const std::uint8_t * set = data + off;
+			const std::uint16_t setId = Get16(set);
+			const std::uint16_t setLength = Get16(set);
+			if (setLength < Netflow::IpfixSetHeaderSize) {
+				break;
+			}
+			const std::uint32_t payload = setLength - Netflow::IpfixSetHeaderSize;
+			if (setId == Netflow::IpfixTemplateIpv4) {
+				records += payload / Netflow::IpfixRecordSizeIpv4;
+			}
+			else if (setId == Netflow::IpfixTemplateIpv6) {
+				records += payload / Netflow::IpfixRecordSizeIpv6;
+			}
+			off += setLength;
+		}
+		return records;
+	}
+} // namespace NetflowBench
@@ -0,0 +1,98 @@
+/**
+ * @file udp_sink.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Loopback UDP kolektor pro benchmarky - počítá přijaté datagramy a flow záznamy
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace NetflowBench
+{
+	/**
+	 * @brief UDP socket na 127.0.0.1 (volný port), který ve vlastním vlákně přijímá datagramy a počítá záznamy
+	 * v Netflow v5 datagramech i IPFIX zprávách (datové sety šablon 256/257).
+	 */
+	class UdpSink
+	{
+	public:
+		/**
+		 * @brief Konstruktor - otevře socket a spustí přijímací vlákno
+		 */
+		UdpSink();
+
+		/**
+		 * @brief Destruktor - zastaví vlákno a zavře socket
+		 */
+		~UdpSink();
+
+		UdpSink(const UdpSink &) = delete;
+		UdpSink & operator=(const UdpSink &) = delete;
+
+		/**
+		 * @brief Port socketu
+		 *
+		 * @return std::uint16_t port
+		 */
+		std::uint16_t Port() const
+		{
+			return _port;
+		}
+
+		/**
+		 * @brief Počká, dokud nepřestanou chodit datagramy (`idleMs` bez datagramu)
+		 *
+		 * @param idleMs doba nečinnosti v ms
+		 */
+		void WaitIdle(std::uint32_t idleMs);
+
+		/**
+		 * @brief Počet přijatých datagramů
+		 */
+		std::uint64_t Datagrams() const
+		{
+			return _datagrams.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Počet přijatých flow záznamů
+		 */
+		std::uint64_t Records() const
+		{
+			return _records.load(std::memory_order_relaxed);
+		}
+	private:
+		/// @brief Socket
+		int _socket = -1;
+
+		/// @brief Port
+		std::uint16_t _port = 0;
+
+		/// @brief Počítadla
+		std::atomic<std::uint64_t> _datagrams {0};
+		std::atomic<std::uint64_t> _records {0};
+
+		/// @brief Zastavení vlákna
+		std::atomic<bool> _stop {false};
+
+		/// @brief Přijímací vlákno
+		std::thread _thread;
+
+		/**
+		 * @brief Přijímací smyčka
+		 */
+		void Receive();
+
+		/**
+		 * @brief Počet záznamů v datagramu
+		 *
+		 * @param data datagram
+		 * @param size velikost
+		 * @return std::uint64_t počet záznamů
+		 */
+		static std::uint64_t CountRecords(const std::uint8_t * data, std::size_t size);
+	};
+} // namespace NetflowBench
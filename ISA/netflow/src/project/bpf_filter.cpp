@@ -0,0 +1,270 @@
+/**
+ * @file bpf_filter.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "bpf_filter.h"
+
+#include "logger/logger.hpp"
+
+namespace
+{
+	/// @brief Snaplen pro překlad - výrazy s délkou paketu se nemají omezit
+	constexpr int CompileSnaplen = 262144;
+
+	std::uint32_t Load32(const std::uint8_t * p)
+	{
+		return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16)
+			| (static_cast<std::uint32_t>(p[2]) << 8) | p[3];
+	}
+
+	std::uint32_t Load16(const std::uint8_t * p)
+	{
+		return (static_cast<std::uint32_t>(p[0]) << 8) | p[1];
+	}
+
+	/**
+	 * @brief Zda lze číst `size` bytů od `offset` v `capLen` bytech paketu
+	 */
+	bool InBounds(std::uint32_t offset, std::uint32_t size, std::uint32_t capLen)
+	{
+		return offset <= capLen && size <= capLen - offset;
+	}
+} // namespace
+
+namespace Netflow
+{
+	std::unique_ptr<BpfFilter> BpfFilter::Compile(const std::string & expression)
+	{
+		pcap_t * pcap = pcap_open_dead(DLT_EN10MB, CompileSnaplen);
+		if (pcap == nullptr) {
+			Logger::LogError<>("Couldn't compile filter: pcap_open_dead failed");
+			return nullptr;
+		}
+
+		bpf_program program {};
+		if (pcap_compile(pcap, &program, expression.c_str(), 1, PCAP_NETMASK_UNKNOWN) != 0) {
+			Logger::LogError<>("Invalid filter \"" + expression + "\": " + pcap_geterr(pcap));
+			pcap_close(pcap);
+			return nullptr;
+		}
+
+		std::unique_ptr<BpfFilter> filter(new BpfFilter());
+		filter->_expression = expression;
+		filter->_program.assign(program.bf_insns, program.bf_insns + program.bf_len);
+		pcap_freecode(&program);
+		pcap_close(pcap);
+
+		if (!filter->Validate()) {
+			Logger::LogError<>("Invalid BPF program for \"" + expression + "\"");
+			return nullptr;
+		}
+		LOG_DEBUG("Filter \"" + expression + "\": " + std::to_string(filter->_program.size()) + " instructions");
+		return filter;
+	}
+
+	bpf_program BpfFilter::Program() const
+	{
+		bpf_program program {};
+		program.bf_len = _program.size();
+		program.bf_insns = const_cast<bpf_insn *>(_program.data());
+		return program;
+	}
+
+	bool BpfFilter::Validate() const
+	{
+		if (_program.empty() || BPF_CLASS(_program.back().code) != BPF_RET) {
+			return false;
+		}
+		for (std::size_t pc = 0; pc < _program.size(); pc++) {
+			const bpf_insn & insn = _program[pc];
+			const std::size_t remaining = _program.size() - pc - 1;
+			switch (BPF_CLASS(insn.code)) {
+			case BPF_JMP:
+				if (BPF_OP(insn.code) == BPF_JA ? insn.k >= remaining : (insn.jt >= remaining || insn.jf >= remaining)) {
+					return false;
+				}
+				break;
+			case BPF_LD:
+			case BPF_LDX:
+				if (BPF_MODE(insn.code) == BPF_MEM && insn.k >= BPF_MEMWORDS) {
+					return false;
+				}
+				break;
+			case BPF_ST:
+			case BPF_STX:
+				if (insn.k >= BPF_MEMWORDS) {
+					return false;
+				}
+				break;
+			case BPF_ALU:
+				// dělení nulovou konstantou (dělení nulou v X se ošetří za běhu)
+				if ((BPF_OP(insn.code) == BPF_DIV || BPF_OP(insn.code) == BPF_MOD) && BPF_SRC(insn.code) == BPF_K && insn.k == 0) {
+					return false;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		return true;
+	}
+
+	bool BpfFilter::Matches(const std::uint8_t * packet, std::uint32_t wireLen, std::uint32_t capLen) const
+	{
+		std::uint32_t a = 0;
+		std::uint32_t x = 0;
+		std::uint32_t mem[BPF_MEMWORDS] {};
+
+		// Validate() zaručuje, že program skončí návratem a skoky neopustí program
+		for (const bpf_insn * pc = _program.data(); ; pc++) {
+			const std::uint32_t k = pc->k;
+			switch (pc->code) {
+			case BPF_RET | BPF_K:
+				return k != 0;
+			case BPF_RET | BPF_A:
+				return a != 0;
+
+			case BPF_LD | BPF_W | BPF_ABS:
+				if (!InBounds(k, 4, capLen)) {
+					return false;
+				}
+				a = Load32(packet + k);
+				break;
+			case BPF_LD | BPF_H | BPF_ABS:
+				if (!InBounds(k, 2, capLen)) {
+					return false;
+				}
+				a = Load16(packet + k);
+				break;
+			case BPF_LD | BPF_B | BPF_ABS:
+				if (!InBounds(k, 1, capLen)) {
+					return false;
+				}
+				a = packet[k];
+				break;
+			case BPF_LD | BPF_W | BPF_IND:
+				if (k > UINT32_MAX - x || !InBounds(x + k, 4, capLen)) {
+					return false;
+				}
+				a = Load32(packet + x + k);
+				break;
+			case BPF_LD | BPF_H | BPF_IND:
+				if (k > UINT32_MAX - x || !InBounds(x + k, 2, capLen)) {
+					return false;
+				}
+				a = Load16(packet + x + k);
+				break;
+			case BPF_LD | BPF_B | BPF_IND:
+				if (k > UINT32_MAX - x || !InBounds(x + k, 1, capLen)) {
+					return false;
+				}
+				a = packet[x + k];
+				break;
+			case BPF_LDX | BPF_MSH | BPF_B:
+				// délka IPv4 hlavičky
+				if (!InBounds(k, 1, capLen)) {
+					return false;
+				}
+				x = (packet[k] & 0x0F) << 2;
+				break;
+			case BPF_LD | BPF_W | BPF_LEN:
+				a = wireLen;
+				break;
+			case BPF_LDX | BPF_W | BPF_LEN:
+				x = wireLen;
+				break;
+			case BPF_LD | BPF_IMM:
+				a = k;
+				break;
+			case BPF_LDX | BPF_IMM:
+				x = k;
+				break;
+			case BPF_LD | BPF_MEM:
+				a = mem[k];
+				break;
+			case BPF_LDX | BPF_MEM:
+				x = mem[k];
+				break;
+			case BPF_ST:
+				mem[k] = a;
+				break;
+			case BPF_STX:
+				mem[k] = x;
+				break;
+
+			case BPF_JMP | BPF_JA:
+				pc += k;
+				break;
+			case BPF_JMP | BPF_JGT | BPF_K:
+				pc += a > k ? pc->jt : pc->jf;
+				break;
+			case BPF_JMP | BPF_JGE | BPF_K:
+				pc += a >= k ? pc->jt : pc->jf;
+				break;
+			case BPF_JMP | BPF_JEQ | BPF_K:
+				pc += a == k ? pc->jt : pc->jf;
+				break;
+			case BPF_JMP | BPF_JSET | BPF_K:
+				pc += (a & k) ? pc->jt : pc->jf;
+				break;
+			case BPF_JMP | BPF_JGT | BPF_X:
+				pc += a > x ? pc->jt : pc->jf;
+				break;
+			case BPF_JMP | BPF_JGE | BPF_X:
+				pc += a >= x ? pc->jt : pc->jf;
+				break;
+			case BPF_JMP | BPF_JEQ | BPF_X:
+				pc += a == x ? pc->jt : pc->jf;
+				break;
+			case BPF_JMP | BPF_JSET | BPF_X:
+				pc += (a & x) ? pc->jt : pc->jf;
+				break;
+
+			case BPF_ALU | BPF_ADD | BPF_X: a += x; break;
+			case BPF_ALU | BPF_SUB | BPF_X: a -= x; break;
+			case BPF_ALU | BPF_MUL | BPF_X: a *= x; break;
+			case BPF_ALU | BPF_DIV | BPF_X:
+				if (x == 0) {
+					return false;
+				}
+				a /= x;
+				break;
+			case BPF_ALU | BPF_MOD | BPF_X:
+				if (x == 0) {
+					return false;
+				}
+				a %= x;
+				break;
+			case BPF_ALU | BPF_AND | BPF_X: a &= x; break;
+			case BPF_ALU | BPF_OR | BPF_X: a |= x; break;
+			case BPF_ALU | BPF_XOR | BPF_X: a ^= x; break;
+			case BPF_ALU | BPF_LSH | BPF_X: a = x < 32 ? a << x : 0; break;
+			case BPF_ALU | BPF_RSH | BPF_X: a = x < 32 ? a >> x : 0; break;
+			case BPF_ALU | BPF_ADD | BPF_K: a += k; break;
+			case BPF_ALU | BPF_SUB | BPF_K: a -= k; break;
+			case BPF_ALU | BPF_MUL | BPF_K: a *= k; break;
+			case BPF_ALU | BPF_DIV | BPF_K: a /= k; break;
+			case BPF_ALU | BPF_MOD | BPF_K: a %= k; break;
+			case BPF_ALU | BPF_AND | BPF_K: a &= k; break;
+			case BPF_ALU | BPF_OR | BPF_K: a |= k; break;
+			case BPF_ALU | BPF_XOR | BPF_K: a ^= k; break;
+			case BPF_ALU | BPF_LSH | BPF_K: a = k < 32 ? a << k : 0; break;
+			case BPF_ALU | BPF_RSH | BPF_K: a = k < 32 ? a >> k : 0; break;
+			case BPF_ALU | BPF_NEG: a = -a; break;
+
+			case BPF_MISC | BPF_TAX:
+				x = a;
+				break;
+			case BPF_MISC | BPF_TXA:
+				a = x;
+				break;
+
+			default:
+				// neznámá instrukce (rozšíření jádra) - paket nepropustíme
+				return false;
+			}
+		}
+	}
+} // namespace Netflow
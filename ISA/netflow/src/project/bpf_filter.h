@@ -0,0 +1,78 @@
+/**
+ * @file bpf_filter.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief BPF filtr paketů - překlad výrazu (pcap_compile) a interpret klasického BPF
+ */
+
+#pragma once
+
+#include <pcap.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Přeložený BPF výraz (syntaxe tcpdump) pro ethernetové rámce. Program se předává jádru (AfPacketSource)
+	 * nebo libpcap (PcapSource); pro soubory čtené přes mmap ho vyhodnocuje Matches() ještě před parsováním paketu.
+	 */
+	class BpfFilter
+	{
+	public:
+		/**
+		 * @brief Přeloží výraz
+		 *
+		 * @param expression BPF výraz, např. "ip or ip6"
+		 * @return std::unique_ptr<BpfFilter> filtr; nullptr při chybě (ohlásí ji)
+		 */
+		static std::unique_ptr<BpfFilter> Compile(const std::string & expression);
+
+		/**
+		 * @brief Vyhodnotí program nad paketem
+		 *
+		 * @param packet data paketu (od ethernetové hlavičky)
+		 * @param wireLen původní délka paketu
+		 * @param capLen délka zachycených dat
+		 * @return true paket vyhovuje
+		 */
+		bool Matches(const std::uint8_t * packet, std::uint32_t wireLen, std::uint32_t capLen) const;
+
+		/**
+		 * @brief Program jako bpf_program (pro pcap_setfilter; instrukce patří filtru)
+		 */
+		bpf_program Program() const;
+
+		/**
+		 * @brief Instrukce programu (rozložení odpovídá sock_filter pro SO_ATTACH_FILTER)
+		 */
+		const std::vector<bpf_insn> & Instructions() const
+		{
+			return _program;
+		}
+
+		/**
+		 * @brief Původní výraz
+		 */
+		const std::string & Expression() const
+		{
+			return _expression;
+		}
+	private:
+		BpfFilter() = default;
+
+		/// @brief Výraz
+		std::string _expression;
+
+		/// @brief Přeložený program
+		std::vector<bpf_insn> _program;
+
+		/**
+		 * @brief Zkontroluje, že program skončí (skoky jen dopředu a uvnitř programu, poslední instrukce je návrat)
+		 * a nesahá mimo scratch paměť - Matches() pak nemusí kontrolovat pc
+		 */
+		bool Validate() const;
+	};
+} // namespace Netflow
@@ -0,0 +1,187 @@
+/**
+ * @file exporter_stats.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "exporter_stats.h"
+
+#include <csignal>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "logger/logger.hpp"
+
+namespace
+{
+	/// @brief Požadavek na výpis (nastavuje obsluha SIGUSR1)
+	volatile std::sig_atomic_t dumpRequested = 0;
+
+	void OnSigusr1(int)
+	{
+		dumpRequested = 1;
+	}
+
+	/// @brief Jména pro JSON (pořadí podle enumů)
+	const char * const DropNames[] = {"notIp", "malformedIp", "unsupportedProtocol", "ipVersion", "sampling"};
+	const char * const ExpireNames[] = {"activeTimeout", "inactiveTimeout", "evicted", "flushed", "tcpClose"};
+	const char * const StageNames[] = {"parse", "cache", "export"};
+
+	/**
+	 * @brief Horní mez přihrádky, pod kterou leží podíl `q` hodnot
+	 */
+	std::uint64_t Quantile(const std::array<std::uint64_t, Netflow::LatencyHistogram::Buckets> & buckets, std::uint64_t total, double q)
+	{
+		if (total == 0) {
+			return 0;
+		}
+		const std::uint64_t rank = static_cast<std::uint64_t>(q * (total - 1)) + 1;
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < buckets.size(); i++) {
+			seen += buckets[i];
+			if (seen >= rank) {
+				return 1ULL << i;
+			}
+		}
+		return 1ULL << (buckets.size() - 1);
+	}
+} // namespace
+
+namespace Netflow
+{
+	std::uint64_t LatencyHistogram::Quantile(double q) const
+	{
+		std::array<std::uint64_t, Buckets> buckets {};
+		std::uint64_t total = 0;
+		for (std::size_t i = 0; i < Buckets; i++) {
+			buckets[i] = Get(i);
+			total += buckets[i];
+		}
+		return ::Quantile(buckets, total, q);
+	}
+
+	ExporterStats::ExporterStats(const StatsConfig & config)
+		: _config(config), _nextDump(std::chrono::steady_clock::now() + std::chrono::seconds(config.intervalSec))
+	{
+	}
+
+	StatsBlock & ExporterStats::AddBlock()
+	{
+		_blocks.push_back(std::make_unique<StatsBlock>());
+		return *_blocks.back();
+	}
+
+	void ExporterStats::InstallSignalHandler()
+	{
+		std::signal(SIGUSR1, OnSigusr1);
+	}
+
+	void ExporterStats::PollSlow(const SendStats & send, std::uint64_t cacheCapacity)
+	{
+		bool dump = false;
+		if (dumpRequested) {
+			dumpRequested = 0;
+			dump = true;
+		}
+		if (_config.intervalSec > 0) {
+			const auto now = std::chrono::steady_clock::now();
+			if (now >= _nextDump) {
+				_nextDump = now + std::chrono::seconds(_config.intervalSec);
+				dump = true;
+			}
+		}
+		if (dump) {
+			Dump(send, cacheCapacity);
+		}
+	}
+
+	void ExporterStats::Dump(const SendStats & send, std::uint64_t cacheCapacity)
+	{
+		const std::string line = ToJson(send, cacheCapacity) + "\n";
+		if (_config.file.empty()) {
+			std::cerr << line << std::flush;
+			return;
+		}
+
+		// soubor otevíráme při každém výpisu - lze ho mezitím přesunout/smazat (rotace)
+		std::ofstream f(_config.file, std::ios::app);
+		if (!f) {
+			Logger::LogWarning<>("Couldn't write stats to " + _config.file);
+			return;
+		}
+		f << line;
+	}
+
+	std::uint64_t ExporterStats::CacheBytes() const
+	{
+		std::uint64_t bytes = 0;
+		for (const auto & block : _blocks) {
+			bytes += block->cacheBytes.Get();
+		}
+		return bytes;
+	}
+
+	std::string ExporterStats::ToJson(const SendStats & send, std::uint64_t cacheCapacity) const
+	{
+		// součet bloků všech vláken
+		std::uint64_t read = 0, parsed = 0, malformedL4 = 0, created = 0, cacheFlows = 0, cacheBytes = 0;
+		std::array<std::uint64_t, static_cast<std::size_t>(DropReason::Count)> dropped {};
+		std::array<std::uint64_t, static_cast<std::size_t>(ExpireReason::Count)> expired {};
+		std::array<std::array<std::uint64_t, LatencyHistogram::Buckets>, static_cast<std::size_t>(Stage::Count)> latency {};
+
+		for (const auto & block : _blocks) {
+			read += block->packetsRead.Get();
+			parsed += block->packetsParsed.Get();
+			malformedL4 += block->malformedL4.Get();
+			created += block->flowsCreated.Get();
+			cacheFlows += block->cacheFlows.Get();
+			cacheBytes += block->cacheBytes.Get();
+			for (std::size_t i = 0; i < dropped.size(); i++) {
+				dropped[i] += block->dropped[i].Get();
+			}
+			for (std::size_t i = 0; i < expired.size(); i++) {
+				expired[i] += block->expired[i].Get();
+			}
+			for (std::size_t s = 0; s < latency.size(); s++) {
+				for (std::size_t i = 0; i < LatencyHistogram::Buckets; i++) {
+					latency[s][i] += block->latency[s].Get(i);
+				}
+			}
+		}
+
+		std::ostringstream o;
+		o << "{\"time\":" << std::time(nullptr)
+			<< ",\"packets\":{\"read\":" << read << ",\"parsed\":" << parsed << ",\"malformedL4\":" << malformedL4 << ",\"dropped\":{";
+		for (std::size_t i = 0; i < dropped.size(); i++) {
+			o << (i ? "," : "") << "\"" << DropNames[i] << "\":" << dropped[i];
+		}
+		o << "}},\"flows\":{\"created\":" << created;
+		for (std::size_t i = 0; i < expired.size(); i++) {
+			o << ",\"" << ExpireNames[i] << "\":" << expired[i];
+		}
+		o << "},\"cache\":{\"flows\":" << cacheFlows << ",\"capacity\":" << cacheCapacity
+			<< ",\"occupancy\":" << (cacheCapacity ? static_cast<double>(cacheFlows) / cacheCapacity : 0.0)
+			<< ",\"bytes\":" << cacheBytes << ",\"bytesPerMillionFlows\":" << (cacheCapacity ? cacheBytes * 1'000'000 / cacheCapacity : 0)
+			<< "},\"export\":{\"datagrams\":" << send.datagrams << ",\"bytes\":" << send.bytes << ",\"batches\":" << send.batches
+			<< ",\"failed\":" << send.failed << ",\"pacedUs\":" << send.pacedUs << "},\"latencyNs\":{";
+		for (std::size_t s = 0; s < latency.size(); s++) {
+			std::uint64_t total = 0;
+			for (const auto n : latency[s]) {
+				total += n;
+			}
+			o << (s ? "," : "") << "\"" << StageNames[s] << "\":{\"samples\":" << total
+				<< ",\"p50\":" << Quantile(latency[s], total, 0.5)
+				<< ",\"p90\":" << Quantile(latency[s], total, 0.9)
+				<< ",\"p99\":" << Quantile(latency[s], total, 0.99)
+				<< ",\"log2Buckets\":[";
+			for (std::size_t i = 0; i < LatencyHistogram::Buckets; i++) {
+				o << (i ? "," : "") << latency[s][i];
+			}
+			o << "]}";
+		}
+		o << "}}";
+		return o.str();
+	}
+} // namespace Netflow
@@ -0,0 +1,305 @@
+/**
+ * @file exporter_stats.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Statistiky exportéru - počítadla, obsazenost cache a histogramy latencí jednotlivých fází
+ */
+
+#pragma once
+
+#include "netflow_collector_connection.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Důvod zahození paketu před flow-cache
+	 */
+	enum class DropReason
+	{
+		NotIp,               ///< Ethernet rámec nenese IPv4 ani IPv6
+		MalformedIp,         ///< Neplatná IP hlavička
+		UnsupportedProtocol, ///< Jiný protokol než TCP/UDP/ICMP
+		IpVersion,           ///< IPv6 při exportu Netflow v5
+		Sampling,            ///< Nevybrán vzorkováním
+		Count
+	};
+
+	/**
+	 * @brief Důvod odstranění záznamu z flow-cache
+	 */
+	enum class ExpireReason
+	{
+		ActiveTimeout,   ///< Vypršel active timer
+		InactiveTimeout, ///< Vypršel inactive timer
+		Evicted,         ///< Vyřazen z plné cache (LRU)
+		Flushed,         ///< Vyprázdnění cache na konci vstupu
+		TcpClose,        ///< Ukončené TCP spojení (FIN oběma směry nebo RST) po uplynutí doby odkladu
+		Count
+	};
+
+	/**
+	 * @brief Měřené fáze zpracování
+	 */
+	enum class Stage
+	{
+		Parse,  ///< Čtení a parsování jedné dávky paketů
+		Cache,  ///< Expirace, prefetch, AddNewRecord a vyřazení z plné cache pro jednu dávku paketů
+		Export, ///< ExportFlows (serializace a zařazení/odeslání datagramů)
+		Count
+	};
+
+	/**
+	 * @brief Počítadlo s jediným zapisujícím vláknem. Čtení z jiného vlákna je bezpečné (relaxed atomic),
+	 * zápis nepotřebuje atomickou read-modify-write instrukci.
+	 */
+	class Counter
+	{
+	public:
+		void Add(std::uint64_t n = 1)
+		{
+			_value.store(_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+
+		void Set(std::uint64_t value)
+		{
+			_value.store(value, std::memory_order_relaxed);
+		}
+
+		std::uint64_t Get() const
+		{
+			return _value.load(std::memory_order_relaxed);
+		}
+	private:
+		std::atomic<std::uint64_t> _value {0};
+	};
+
+	/**
+	 * @brief Histogram latencí s logaritmickými přihrádkami - přihrádka i obsahuje hodnoty z [2^(i-1), 2^i) ns
+	 */
+	class LatencyHistogram
+	{
+	public:
+		/// @brief Počet přihrádek (poslední obsahuje vše od ~1 s výš)
+		static constexpr std::size_t Buckets = 32;
+
+		/**
+		 * @brief Zaznamená hodnotu
+		 *
+		 * @param ns latence v ns
+		 */
+		void Record(std::uint64_t ns)
+		{
+			std::size_t bucket = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+			_buckets[bucket < Buckets ? bucket : Buckets - 1].Add();
+		}
+
+		/**
+		 * @brief Počet hodnot v přihrádce
+		 *
+		 * @param bucket index přihrádky
+		 * @return std::uint64_t počet
+		 */
+		std::uint64_t Get(std::size_t bucket) const
+		{
+			return _buckets[bucket].Get();
+		}
+
+		/**
+		 * @brief Horní mez přihrádky, pod kterou leží podíl `q` hodnot
+		 *
+		 * @param q kvantil (0-1)
+		 * @return std::uint64_t latence v ns (0 = žádné hodnoty)
+		 */
+		std::uint64_t Quantile(double q) const;
+	private:
+		std::array<Counter, Buckets> _buckets;
+	};
+
+	/**
+	 * @brief Statistiky zapisované jedním vláknem (čtecí vlákno, shard, serializátor). Zarovnáno na cache line,
+	 * aby si bloky různých vláken nepřekážely.
+	 */
+	struct alignas(64) StatsBlock
+	{
+		Counter packetsRead;    ///< Přečtené pakety
+		Counter packetsParsed;  ///< Pakety předané do flow-cache
+		Counter malformedL4;    ///< Pakety s neplatnou TCP/UDP hlavičkou (zpracují se bez portů)
+		std::array<Counter, static_cast<std::size_t>(DropReason::Count)> dropped;
+
+		Counter flowsCreated;   ///< Nové záznamy ve flow-cache
+		std::array<Counter, static_cast<std::size_t>(ExpireReason::Count)> expired;
+		Counter cacheFlows;     ///< Současný počet záznamů ve flow-cache tohoto vlákna
+		Counter cacheBytes;     ///< Paměť flow-cache tohoto vlákna v bytech
+
+		std::array<LatencyHistogram, static_cast<std::size_t>(Stage::Count)> latency;
+
+		void Drop(DropReason reason)
+		{
+			dropped[static_cast<std::size_t>(reason)].Add();
+		}
+
+		void Expire(ExpireReason reason)
+		{
+			expired[static_cast<std::size_t>(reason)].Add();
+		}
+
+		LatencyHistogram & Latency(Stage stage)
+		{
+			return latency[static_cast<std::size_t>(stage)];
+		}
+	};
+
+	/**
+	 * @brief Změří dobu od vytvoření do zániku a zapíše ji do histogramu. Bez histogramu nedělá nic
+	 * (měření lze omezit na vzorek - viz ExporterStats::ShouldTime()).
+	 */
+	class StageTimer
+	{
+	public:
+		StageTimer(LatencyHistogram * histogram) : _histogram(histogram)
+		{
+			if (_histogram != nullptr) {
+				_start = std::chrono::steady_clock::now();
+			}
+		}
+
+		~StageTimer()
+		{
+			if (_histogram != nullptr) {
+				const auto elapsed = std::chrono::steady_clock::now() - _start;
+				_histogram->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+			}
+		}
+
+		StageTimer(const StageTimer &) = delete;
+		StageTimer & operator=(const StageTimer &) = delete;
+	private:
+		LatencyHistogram * _histogram;
+		std::chrono::steady_clock::time_point _start;
+	};
+
+	/**
+	 * @brief Nastavení výpisu statistik
+	 */
+	struct StatsConfig
+	{
+		std::string file {};             ///< Soubor, do kterého se statistiky připisují; prázdný = stderr
+		std::uint32_t intervalSec {0};   ///< Perioda výpisu v sekundách (reálný čas); 0 = pouze na SIGUSR1 a na konci
+		bool enabled {false};            ///< Vypsat statistiky i na konci běhu
+	};
+
+	/**
+	 * @brief Statistiky exportéru. Každé vlákno zapisuje do vlastního StatsBlock; výpis je sečte.
+	 * Výpis je jeden JSON objekt na řádek (JSON Lines) - na SIGUSR1, periodicky a na konci běhu.
+	 */
+	class ExporterStats
+	{
+	public:
+		/// @brief Latence exportu ve vícevláknovém režimu se měří u každého (LatencySamplePeriod)-tého volání (měření času není zadarmo)
+		static constexpr std::uint64_t LatencySamplePeriod = 64;
+
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param config nastavení výpisu
+		 */
+		ExporterStats(const StatsConfig & config);
+
+		/**
+		 * @brief Vytvoří blok pro jedno vlákno. Volat před spuštěním vláken.
+		 *
+		 * @return StatsBlock& blok
+		 */
+		StatsBlock & AddBlock();
+
+		/**
+		 * @brief Zda měřit latenci operace s daným pořadím
+		 *
+		 * @param packetNumber pořadí operace
+		 * @return true měřit
+		 */
+		static bool ShouldTime(std::uint64_t packetNumber)
+		{
+			return packetNumber % LatencySamplePeriod == 0;
+		}
+
+		/**
+		 * @brief Nastaví obsluhu SIGUSR1 (požadavek na výpis)
+		 */
+		static void InstallSignalHandler();
+
+		/**
+		 * @brief Vypíše statistiky, pokud přišel SIGUSR1 nebo uplynula perioda. Levné - volat lze pro každý paket.
+		 *
+		 * @param send statistiky odesílání
+		 * @param cacheCapacity celková kapacita flow-cache
+		 */
+		void Poll(const SendStats & send, std::uint64_t cacheCapacity)
+		{
+			if ((++_polls % PollPeriod) == 0) {
+				PollSlow(send, cacheCapacity);
+			}
+		}
+
+		/**
+		 * @brief Vypíše statistiky
+		 *
+		 * @param send statistiky odesílání
+		 * @param cacheCapacity celková kapacita flow-cache
+		 */
+		void Dump(const SendStats & send, std::uint64_t cacheCapacity);
+
+		/**
+		 * @brief Statistiky jako jeden řádek JSON
+		 *
+		 * @param send statistiky odesílání
+		 * @param cacheCapacity celková kapacita flow-cache
+		 * @return std::string JSON
+		 */
+		std::string ToJson(const SendStats & send, std::uint64_t cacheCapacity) const;
+
+		/**
+		 * @brief Nastavení
+		 *
+		 * @return const StatsConfig& nastavení
+		 */
+		const StatsConfig & Config() const
+		{
+			return _config;
+		}
+
+		/**
+		 * @brief Paměť flow-cache všech vláken v bytech
+		 *
+		 * @return std::uint64_t byty
+		 */
+		std::uint64_t CacheBytes() const;
+	private:
+		/// @brief Jak často Poll() kontroluje signál a čas
+		static constexpr std::uint64_t PollPeriod = 1024;
+
+		/// @brief Nastavení
+		const StatsConfig _config;
+
+		/// @brief Bloky vláken
+		std::vector<std::unique_ptr<StatsBlock>> _blocks;
+
+		/// @brief Počet volání Poll()
+		std::uint64_t _polls = 0;
+
+		/// @brief Čas dalšího periodického výpisu
+		std::chrono::steady_clock::time_point _nextDump;
+
+		/**
+		 * @brief Kontrola signálu a periody
+		 */
+		void PollSlow(const SendStats & send, std::uint64_t cacheCapacity);
+	};
+} // namespace Netflow
@@ -0,0 +1,213 @@
+/**
+ * @file flow_aggregator.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "flow_aggregator.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+//#define _loggerDebug
+#include "logger/logger.hpp"
+
+namespace
+{
+	/**
+	 * @brief Vynuluje bity adresy za prefixem
+	 */
+	void MaskAddress(std::array<std::uint8_t, 16> & addr, std::uint32_t prefix)
+	{
+		for (std::uint32_t i = 0; i < addr.size(); i++) {
+			const std::uint32_t bits = prefix > i * 8 ? std::min<std::uint32_t>(prefix - i * 8, 8) : 0;
+			addr[i] &= static_cast<std::uint8_t>(0xFF00 >> bits);
+		}
+	}
+
+	/**
+	 * @brief Sčítání, které při přetečení zůstane na maximu (agregované čítače se nesmí přetočit přes nulu)
+	 */
+	std::uint32_t SaturatingAdd(std::uint32_t a, std::uint32_t b)
+	{
+		const std::uint64_t sum = static_cast<std::uint64_t>(a) + b;
+		return static_cast<std::uint32_t>(std::min<std::uint64_t>(sum, std::numeric_limits<std::uint32_t>::max()));
+	}
+
+	/**
+	 * @brief Naparsuje `<len>[/<len6>]` (délky prefixu IPv4 a IPv6)
+	 */
+	bool ParsePrefix(const std::string & spec, std::uint8_t & v4, std::uint8_t & v6)
+	{
+		try {
+			const auto slash = spec.find('/');
+			const unsigned long len = std::stoul(spec.substr(0, slash));
+			// bez délky pro IPv6 použijeme /64 (nebo celou adresu, pokud je IPv4 prefix celá adresa)
+			const unsigned long len6 = slash != std::string::npos ? std::stoul(spec.substr(slash + 1)) : (len >= 32 ? 128 : 64);
+			if (len < 1 || len > 32 || len6 < 1 || len6 > 128) {
+				return false;
+			}
+			v4 = len;
+			v6 = len6;
+			return true;
+		}
+		catch (const std::exception &) {
+			return false;
+		}
+	}
+} // namespace
+
+namespace Netflow
+{
+	bool AggregationConfig::Parse(const std::string & spec, AggregationConfig & out)
+	{
+		AggregationConfig c;
+		c.enabled = true;
+
+		const auto colonPos = spec.find(':');
+		if (colonPos != std::string::npos) {
+			try {
+				c.timeout = std::max<unsigned long>(std::stoul(spec.substr(colonPos + 1)), 1);
+			}
+			catch (const std::exception &) {
+				return false;
+			}
+		}
+
+		std::stringstream fields(spec.substr(0, colonPos));
+		std::string field;
+		while (std::getline(fields, field, ',')) {
+			if (field == "proto-port") {
+				c.prot = c.srcPort = c.dstPort = true;
+			}
+			else if (field == "src-prefix") {
+				c.srcPrefixV4 = 24;
+				c.srcPrefixV6 = 64;
+			}
+			else if (field == "dst-prefix") {
+				c.dstPrefixV4 = 24;
+				c.dstPrefixV6 = 64;
+			}
+			else if (field == "prefix") {
+				c.srcPrefixV4 = c.dstPrefixV4 = 24;
+				c.srcPrefixV6 = c.dstPrefixV6 = 64;
+			}
+			else if (field.rfind("src/", 0) == 0) {
+				if (!ParsePrefix(field.substr(4), c.srcPrefixV4, c.srcPrefixV6)) {
+					return false;
+				}
+			}
+			else if (field.rfind("dst/", 0) == 0) {
+				if (!ParsePrefix(field.substr(4), c.dstPrefixV4, c.dstPrefixV6)) {
+					return false;
+				}
+			}
+			else if (field == "proto") {
+				c.prot = true;
+			}
+			else if (field == "ports") {
+				c.srcPort = c.dstPort = true;
+			}
+			else if (field == "srcport") {
+				c.srcPort = true;
+			}
+			else if (field == "dstport") {
+				c.dstPort = true;
+			}
+			else if (field == "tos") {
+				c.tos = true;
+			}
+			else {
+				return false;
+			}
+		}
+
+		out = c;
+		return true;
+	}
+
+	FlowKey AggregationConfig::Apply(const FlowKey & key) const
+	{
+		FlowKey k = key;
+		MaskAddress(k.srcAddr, SrcPrefix(key.ipVersion));
+		MaskAddress(k.dstAddr, DstPrefix(key.ipVersion));
+		if (!prot) {
+			k.prot = 0;
+		}
+		if (!srcPort) {
+			k.srcPort = 0;
+		}
+		if (!dstPort) {
+			k.dstPort = 0;
+		}
+		if (!tos) {
+			k.tos = 0;
+		}
+		return k;
+	}
+
+	FlowAggregator::FlowAggregator(const AggregationConfig & config, std::uint32_t cacheSize, std::uint32_t timerGranularity)
+		: _config(config), _cacheSize(std::max<std::uint32_t>(cacheSize, 1)), _aggregates(_cacheSize),
+		_timers(_aggregates.Capacity(), timerGranularity, config.timeout * 1000ULL), _lru(_aggregates.Capacity())
+	{
+	}
+
+	void FlowAggregator::Add(const std::vector<FlowRecord> & records, const timeval & now)
+	{
+		for (const auto & record : records) {
+			_flowsIn++;
+			const FlowKey key = _config.Apply(record.key);
+			const std::uint64_t hash = key.Hash();
+
+			const std::uint32_t index = _aggregates.Find(key, hash);
+			if (index != FlowTable::InvalidIndex) {
+				FlowRecord & aggregate = _aggregates.At(index);
+				aggregate.dPkts = SaturatingAdd(aggregate.dPkts, record.dPkts);
+				aggregate.dOctets = SaturatingAdd(aggregate.dOctets, record.dOctets);
+				aggregate.firstUs = std::min(aggregate.firstUs, record.firstUs);
+				aggregate.lastUs = std::max<std::uint64_t>(aggregate.lastUs, record.lastUs);
+				aggregate.tcpFlags |= record.tcpFlags;
+				_lru.Touch(index);
+				continue;
+			}
+
+			if (_aggregates.Size() >= _cacheSize) {
+				// plná cache; exportujeme nejdéle nepoužitý záznam
+				ExportAggregate(_lru.Coldest());
+			}
+
+			FlowRecord aggregate = record;
+			aggregate.key = key;
+			const std::uint32_t newIndex = _aggregates.Insert(aggregate, hash);
+			// pevné okno od vzniku záznamu - agregát se neprodlužuje dalšími flow
+			_timers.Schedule(newIndex, TimevalToMs(now) + _config.timeout * 1000ULL);
+			_lru.Touch(newIndex);
+		}
+	}
+
+	void FlowAggregator::Expire(const timeval & now)
+	{
+		_timers.Advance(TimevalToMs(now), [this](std::uint32_t index) {
+			ExportAggregate(index);
+		});
+	}
+
+	void FlowAggregator::Flush()
+	{
+		_aggregates.ForEach([this](std::uint32_t index, FlowRecord &) {
+			ExportAggregate(index);
+		});
+	}
+
+	void FlowAggregator::ExportAggregate(std::uint32_t index)
+	{
+		LOG_DEBUG("Exporting aggregate");
+		_toExport.push_back(_aggregates.At(index));
+		_recordsOut++;
+
+		_timers.Cancel(index);
+		_lru.Remove(index);
+		_aggregates.Erase(index);
+	}
+} // namespace Netflow
@@ -0,0 +1,175 @@
+/**
+ * @file flow_aggregator.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Agregace flow záznamů před exportem (obdoba agregačních schémat Netflow v8)
+ */
+
+#pragma once
+
+#include "flow_record.h"
+#include "flow_table.h"
+#include "timer_wheel.h"
+#include "lru_list.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Agregační schéma - které části klíče se zachovají. Adresy se zkrátí na prefix dané délky
+	 * (0 = adresa se zahodí), ostatní položky se buď zachovají, nebo vynulují.
+	 */
+	struct AggregationConfig
+	{
+		bool enabled {false};
+		std::uint8_t srcPrefixV4 {0};  ///< Délka zdrojového prefixu IPv4
+		std::uint8_t dstPrefixV4 {0};  ///< Délka cílového prefixu IPv4
+		std::uint8_t srcPrefixV6 {0};  ///< Délka zdrojového prefixu IPv6
+		std::uint8_t dstPrefixV6 {0};  ///< Délka cílového prefixu IPv6
+		bool prot {false};
+		bool srcPort {false};
+		bool dstPort {false};
+		bool tos {false};
+		std::uint32_t timeout {60};    ///< Po kolika sekundách od vzniku se agregovaný záznam exportuje
+
+		/**
+		 * @brief Naparsuje schéma z příkazové řádky: `<položka>[,<položka>...][:<sekundy>]`, kde položka je
+		 * `src/<len>[/<len6>]`, `dst/<len>[/<len6>]`, `proto`, `ports`, `srcport`, `dstport`, `tos` nebo jedno
+		 * z předdefinovaných schémat v8: `proto-port`, `src-prefix`, `dst-prefix`, `prefix`
+		 *
+		 * @param spec schéma
+		 * @param out výstupní nastavení
+		 * @return true schéma je platné
+		 */
+		static bool Parse(const std::string & spec, AggregationConfig & out);
+
+		/**
+		 * @brief Klíč agregovaného záznamu
+		 *
+		 * @param key klíč flow záznamu
+		 * @return FlowKey klíč se zachovanými položkami
+		 */
+		FlowKey Apply(const FlowKey & key) const;
+
+		/**
+		 * @brief Délka zdrojového prefixu pro danou verzi IP
+		 */
+		std::uint8_t SrcPrefix(IpVersion version) const
+		{
+			return version == IpVersion::Ipv6 ? srcPrefixV6 : srcPrefixV4;
+		}
+
+		/**
+		 * @brief Délka cílového prefixu pro danou verzi IP
+		 */
+		std::uint8_t DstPrefix(IpVersion version) const
+		{
+			return version == IpVersion::Ipv6 ? dstPrefixV6 : dstPrefixV4;
+		}
+	};
+
+	/**
+	 * @brief Agregační cache. Sčítá flow záznamy se stejným agregovaným klíčem (AggregationConfig::Apply())
+	 * do jednoho záznamu; ten se exportuje `timeout` sekund po svém vzniku nebo při zaplnění cache
+	 * (nejdéle nepoužitý). Stojí mezi flow-cache a serializací exportu; sama nic neodesílá.
+	 */
+	class FlowAggregator
+	{
+	public:
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param config schéma
+		 * @param cacheSize max. počet agregovaných záznamů
+		 * @param timerGranularity granularita časovacího kola v ms
+		 */
+		FlowAggregator(const AggregationConfig & config, std::uint32_t cacheSize, std::uint32_t timerGranularity);
+
+		/**
+		 * @brief Přidá flow záznamy do agregovaných záznamů
+		 *
+		 * @param records flow záznamy
+		 * @param now současný čas (exportéru)
+		 */
+		void Add(const std::vector<FlowRecord> & records, const timeval & now);
+
+		/**
+		 * @brief Připraví k exportu agregované záznamy, kterým vypršel timeout
+		 *
+		 * @param now současný čas
+		 */
+		void Expire(const timeval & now);
+
+		/**
+		 * @brief Připraví k exportu všechny agregované záznamy
+		 */
+		void Flush();
+
+		/**
+		 * @brief Agregované záznamy připravené k exportu. Volající je po odeslání vyprázdní.
+		 *
+		 * @return std::vector<FlowRecord>& záznamy
+		 */
+		std::vector<FlowRecord> & Expired()
+		{
+			return _toExport;
+		}
+
+		/**
+		 * @brief Schéma
+		 */
+		const AggregationConfig & Config() const
+		{
+			return _config;
+		}
+
+		/**
+		 * @brief Počet přijatých flow záznamů
+		 */
+		std::uint64_t FlowsIn() const
+		{
+			return _flowsIn;
+		}
+
+		/**
+		 * @brief Počet agregovaných záznamů připravených k exportu
+		 */
+		std::uint64_t RecordsOut() const
+		{
+			return _recordsOut;
+		}
+	private:
+		/// @brief Schéma
+		const AggregationConfig _config;
+
+		/// @brief Max. počet agregovaných záznamů
+		const std::uint32_t _cacheSize;
+
+		/// @brief Agregované záznamy
+		FlowTable _aggregates;
+
+		/// @brief Časy exportu záznamů v `_aggregates`
+		TimerWheel _timers;
+
+		/// @brief Pořadí záznamů v `_aggregates` podle posledního použití
+		LruList _lru;
+
+		/// @brief Záznamy připravené k exportu
+		std::vector<FlowRecord> _toExport;
+
+		/// @brief Počet přijatých flow záznamů
+		std::uint64_t _flowsIn = 0;
+
+		/// @brief Počet exportovaných agregovaných záznamů
+		std::uint64_t _recordsOut = 0;
+
+		/**
+		 * @brief Připraví záznam k exportu a odstraní ho
+		 *
+		 * @param index index záznamu v `_aggregates`
+		 */
+		void ExportAggregate(std::uint32_t index);
+	};
+} // namespace Netflow
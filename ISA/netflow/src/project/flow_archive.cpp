@@ -0,0 +1,439 @@
+/**
+ * @file flow_archive.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "flow_archive.h"
+
+#include <algorithm>
+#include <cstring>
+
+//#define _loggerDebug
+#include "logger/logger.hpp"
+
+namespace
+{
+	using Netflow::ArchiveColumn;
+
+	/// @brief Verze formátu archivu
+	constexpr std::uint32_t ArchiveVersion = 1;
+
+	/// @brief Magic number na začátku a na konci archivu
+	constexpr char ArchiveMagic[4] = {'N', 'F', 'C', 'A'};
+
+	/**
+	 * @brief Hlavička archivu
+	 */
+	struct ArchiveHeader
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t blockRecords;
+		std::uint32_t reserved;
+	};
+
+	/**
+	 * @brief Konec archivu - kde začíná zápatí
+	 */
+	struct ArchiveTrailer
+	{
+		std::uint64_t footerOffset;
+		std::uint32_t nBlocks;
+		char magic[4];
+	};
+
+	/// @brief Nejmenší velikost záznamu v bloku - dvě IPv4 adresy a alespoň byte pro každý varint sloupec
+	/// (SrcPort, DstPort, Packets, Octets, First, Last); RLE sloupce mohou pokrýt libovolně záznamů
+	constexpr std::size_t MinRecordBytes = 2 * 4 + 6;
+
+	/**
+	 * @brief Sloupec podle jména
+	 */
+	std::vector<std::uint8_t> & Column(std::array<std::vector<std::uint8_t>, Netflow::ArchiveColumnCount> & columns, ArchiveColumn c)
+	{
+		return columns[static_cast<std::size_t>(c)];
+	}
+
+	void PutVarint(std::vector<std::uint8_t> & out, std::uint64_t v)
+	{
+		while (v >= 0x80) {
+			out.push_back(static_cast<std::uint8_t>(v) | 0x80);
+			v >>= 7;
+		}
+		out.push_back(static_cast<std::uint8_t>(v));
+	}
+
+	std::uint64_t ZigZag(std::int64_t v)
+	{
+		return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+	}
+
+	std::int64_t UnZigZag(std::uint64_t v)
+	{
+		return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+	}
+
+	/**
+	 * @brief Zapíše bytový sloupec jako běhy stejných hodnot
+	 */
+	template <typename Get>
+	void PutRle(std::vector<std::uint8_t> & out, const std::vector<Netflow::FlowRecord> & records, Get get)
+	{
+		for (std::size_t i = 0; i < records.size();) {
+			const std::uint8_t v = get(records[i]);
+			std::size_t run = 1;
+			while (i + run < records.size() && get(records[i + run]) == v) {
+				run++;
+			}
+			PutVarint(out, run);
+			out.push_back(v);
+			i += run;
+		}
+	}
+
+	/**
+	 * @brief Čtení sloupce s kontrolou mezí
+	 */
+	class ColumnReader
+	{
+	public:
+		ColumnReader(const std::uint8_t * data, std::size_t size)
+			: _p(data), _end(data + size)
+		{
+		}
+
+		bool Ok() const
+		{
+			return _ok;
+		}
+
+		std::uint64_t Varint()
+		{
+			std::uint64_t v = 0;
+			for (std::uint32_t shift = 0; shift < 64; shift += 7) {
+				if (_p == _end) {
+					_ok = false;
+					return 0;
+				}
+				const std::uint8_t b = *_p++;
+				v |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+				if ((b & 0x80) == 0) {
+					return v;
+				}
+			}
+			_ok = false;
+			return 0;
+		}
+
+		void Bytes(std::uint8_t * out, std::size_t n)
+		{
+			if (static_cast<std::size_t>(_end - _p) < n) {
+				_ok = false;
+				return;
+			}
+			std::memcpy(out, _p, n);
+			_p += n;
+		}
+
+		/**
+		 * @brief Další hodnota RLE sloupce
+		 */
+		std::uint8_t Rle()
+		{
+			if (_run == 0) {
+				_run = Varint();
+				if (_p == _end || _run == 0) {
+					_ok = false;
+					return 0;
+				}
+				_value = *_p++;
+			}
+			_run--;
+			return _value;
+		}
+	private:
+		const std::uint8_t * _p;
+		const std::uint8_t * _end;
+		bool _ok = true;
+		std::uint64_t _run = 0;
+		std::uint8_t _value = 0;
+	};
+
+	/**
+	 * @brief Počet bytů adresy ve sloupci
+	 */
+	std::size_t AddrSize(Netflow::IpVersion version)
+	{
+		return version == Netflow::IpVersion::Ipv6 ? 16 : 4;
+	}
+} // namespace
+
+namespace Netflow
+{
+	FlowArchiveWriter::FlowArchiveWriter(const std::string & path, std::uint32_t blockRecords)
+		: _path(path), _blockRecords(std::max<std::uint32_t>(blockRecords, 1)), _out(path, std::ios::binary | std::ios::trunc)
+	{
+		Logger::LogInfo<>("Writing flows to archive " + _path);
+		ArchiveHeader header {};
+		std::memcpy(header.magic, ArchiveMagic, sizeof(ArchiveMagic));
+		header.version = ArchiveVersion;
+		header.blockRecords = _blockRecords;
+		_out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		CheckStream();
+		_block.reserve(_blockRecords);
+	}
+
+	FlowArchiveWriter::~FlowArchiveWriter()
+	{
+		Close();
+	}
+
+	bool FlowArchiveWriter::Write(const std::vector<FlowRecord> & records)
+	{
+		if (!IsInitialized()) {
+			return false;
+		}
+		for (const auto & record : records) {
+			_block.push_back(record);
+			if (_block.size() >= _blockRecords) {
+				WriteBlock();
+			}
+		}
+		return IsInitialized();
+	}
+
+	void FlowArchiveWriter::Flush()
+	{
+		if (!_block.empty() && IsInitialized()) {
+			WriteBlock();
+		}
+		_out.flush();
+	}
+
+	void FlowArchiveWriter::Close()
+	{
+		if (!_out.is_open()) {
+			return;
+		}
+		Flush();
+
+		if (IsInitialized()) {
+			ArchiveTrailer trailer {};
+			trailer.footerOffset = _out.tellp();
+			trailer.nBlocks = _blocks.size();
+			std::memcpy(trailer.magic, ArchiveMagic, sizeof(ArchiveMagic));
+			_out.write(reinterpret_cast<const char *>(_blocks.data()), _blocks.size() * sizeof(ArchiveBlockInfo));
+			_out.write(reinterpret_cast<const char *>(&trailer), sizeof(trailer));
+			if (CheckStream()) {
+				Logger::LogInfo<>("Archived " + std::to_string(_nRecords) + " records in " + std::to_string(_blocks.size())
+					+ " blocks (" + std::to_string(static_cast<std::uint64_t>(_out.tellp())) + " bytes) to " + _path);
+			}
+		}
+		_out.close();
+	}
+
+	void FlowArchiveWriter::WriteBlock()
+	{
+		for (auto & column : _columns) {
+			column.clear();
+		}
+
+		ArchiveBlockInfo info {};
+		info.nRecords = _block.size();
+		info.minFirst = UINT32_MAX;
+
+		PutRle(Column(_columns, ArchiveColumn::IpVersion), _block, [](const FlowRecord & r) {
+			return static_cast<std::uint8_t>(r.key.ipVersion);
+		});
+		PutRle(Column(_columns, ArchiveColumn::Prot), _block, [](const FlowRecord & r) {
+			return r.key.prot;
+		});
+		PutRle(Column(_columns, ArchiveColumn::Tos), _block, [](const FlowRecord & r) {
+			return r.key.tos;
+		});
+		PutRle(Column(_columns, ArchiveColumn::TcpFlags), _block, [](const FlowRecord & r) {
+			return r.tcpFlags;
+		});
+
+		std::uint32_t prevFirst = 0;
+		for (const auto & r : _block) {
+			const std::size_t addrSize = AddrSize(r.key.ipVersion);
+			auto & src = Column(_columns, ArchiveColumn::SrcAddr);
+			src.insert(src.end(), r.key.srcAddr.begin(), r.key.srcAddr.begin() + addrSize);
+			auto & dst = Column(_columns, ArchiveColumn::DstAddr);
+			dst.insert(dst.end(), r.key.dstAddr.begin(), r.key.dstAddr.begin() + addrSize);
+
+			PutVarint(Column(_columns, ArchiveColumn::SrcPort), r.key.srcPort);
+			PutVarint(Column(_columns, ArchiveColumn::DstPort), r.key.dstPort);
+			PutVarint(Column(_columns, ArchiveColumn::Packets), r.dPkts);
+			PutVarint(Column(_columns, ArchiveColumn::Octets), r.dOctets);
+			// záznamy přicházejí přibližně podle času - rozdíly jsou malé
+			// v archivu jsou časy v sekundách (jako v exportních formátech)
+			PutVarint(Column(_columns, ArchiveColumn::First), ZigZag(static_cast<std::int64_t>(r.FirstSec()) - prevFirst));
+			PutVarint(Column(_columns, ArchiveColumn::Last), ZigZag(static_cast<std::int64_t>(r.LastSec()) - r.FirstSec()));
+			prevFirst = r.FirstSec();
+
+			info.minFirst = std::min(info.minFirst, r.FirstSec());
+			info.maxLast = std::max(info.maxLast, r.LastSec());
+		}
+
+		std::array<std::uint32_t, ArchiveColumnCount> sizes;
+		std::uint32_t blockSize = sizeof(sizes);
+		for (std::size_t i = 0; i < ArchiveColumnCount; i++) {
+			sizes[i] = _columns[i].size();
+			blockSize += sizes[i];
+		}
+		info.offset = _out.tellp();
+		info.size = blockSize;
+
+		_out.write(reinterpret_cast<const char *>(sizes.data()), sizeof(sizes));
+		for (const auto & column : _columns) {
+			_out.write(reinterpret_cast<const char *>(column.data()), column.size());
+		}
+		if (CheckStream()) {
+			_blocks.push_back(info);
+			_nRecords += _block.size();
+		}
+		LOG_DEBUG("Archived block of " + std::to_string(_block.size()) + " records, " + std::to_string(blockSize) + " bytes");
+		_block.clear();
+	}
+
+	bool FlowArchiveWriter::CheckStream()
+	{
+		if (!_out && !_failed) {
+			Logger::LogError<>("Couldn't write archive " + _path);
+			_failed = true;
+		}
+		return !_failed;
+	}
+
+	std::unique_ptr<FlowArchiveReader> FlowArchiveReader::Open(const std::string & path)
+	{
+		std::unique_ptr<FlowArchiveReader> reader(new FlowArchiveReader());
+		reader->_in.open(path, std::ios::binary);
+		if (!reader->_in) {
+			Logger::LogError<>("Couldn't open archive " + path);
+			return nullptr;
+		}
+
+		ArchiveHeader header {};
+		ArchiveTrailer trailer {};
+		reader->_in.seekg(0, std::ios::end);
+		reader->_fileSize = reader->_in.tellg();
+		reader->_in.seekg(0);
+		reader->_in.read(reinterpret_cast<char *>(&header), sizeof(header));
+		reader->_in.seekg(-static_cast<std::streamoff>(sizeof(trailer)), std::ios::end);
+		reader->_in.read(reinterpret_cast<char *>(&trailer), sizeof(trailer));
+		if (!reader->_in || std::memcmp(header.magic, ArchiveMagic, sizeof(ArchiveMagic)) != 0 || header.version != ArchiveVersion
+				|| std::memcmp(trailer.magic, ArchiveMagic, sizeof(ArchiveMagic)) != 0) {
+			// bez koncové značky nebyl archiv dokončen (exportér neskončil)
+			Logger::LogError<>("Invalid or unfinished archive " + path);
+			return nullptr;
+		}
+
+		// počet bloků ze zápatí se před alokací ověří proti velikosti souboru
+		const std::uint64_t footerEnd = reader->_fileSize - sizeof(trailer);
+		if (trailer.footerOffset < sizeof(header) || trailer.footerOffset > footerEnd
+				|| footerEnd - trailer.footerOffset != static_cast<std::uint64_t>(trailer.nBlocks) * sizeof(ArchiveBlockInfo)) {
+			Logger::LogError<>("Invalid archive footer in " + path);
+			return nullptr;
+		}
+
+		reader->_blocks.resize(trailer.nBlocks);
+		reader->_in.seekg(trailer.footerOffset);
+		reader->_in.read(reinterpret_cast<char *>(reader->_blocks.data()), trailer.nBlocks * sizeof(ArchiveBlockInfo));
+		if (!reader->_in) {
+			Logger::LogError<>("Truncated archive footer in " + path);
+			return nullptr;
+		}
+		return reader;
+	}
+
+	bool FlowArchiveReader::ReadBlock(std::size_t index, std::vector<FlowRecord> & out)
+	{
+		const ArchiveBlockInfo & info = _blocks.at(index);
+		out.clear();
+
+		std::array<std::uint32_t, ArchiveColumnCount> sizes;
+		// velikosti ze zápatí se před alokací ověří proti souboru; každý záznam zabírá alespoň MinRecordBytes
+		if (info.offset > _fileSize || info.size > _fileSize - info.offset || info.size < sizeof(sizes)
+				|| info.nRecords > (info.size - sizeof(sizes)) / MinRecordBytes) {
+			Logger::LogError<>("Corrupted archive block " + std::to_string(index));
+			return false;
+		}
+		_data.resize(info.size);
+		_in.clear();
+		_in.seekg(info.offset);
+		_in.read(reinterpret_cast<char *>(_data.data()), info.size);
+		if (!_in) {
+			return false;
+		}
+		std::memcpy(sizes.data(), _data.data(), sizeof(sizes));
+
+		std::vector<ColumnReader> columns;
+		std::size_t offset = sizeof(sizes);
+		for (std::size_t i = 0; i < ArchiveColumnCount; i++) {
+			if (sizes[i] > info.size - offset) {
+				return false;
+			}
+			columns.emplace_back(_data.data() + offset, sizes[i]);
+			offset += sizes[i];
+		}
+		const auto column = [&columns](ArchiveColumn c) -> ColumnReader & {
+			return columns[static_cast<std::size_t>(c)];
+		};
+
+		out.resize(info.nRecords);
+		std::uint32_t prevFirst = 0;
+		for (auto & r : out) {
+			r.key.ipVersion = static_cast<IpVersion>(column(ArchiveColumn::IpVersion).Rle());
+			const std::size_t addrSize = AddrSize(r.key.ipVersion);
+			column(ArchiveColumn::SrcAddr).Bytes(r.key.srcAddr.data(), addrSize);
+			column(ArchiveColumn::DstAddr).Bytes(r.key.dstAddr.data(), addrSize);
+			r.key.srcPort = column(ArchiveColumn::SrcPort).Varint();
+			r.key.dstPort = column(ArchiveColumn::DstPort).Varint();
+			r.key.prot = column(ArchiveColumn::Prot).Rle();
+			r.key.tos = column(ArchiveColumn::Tos).Rle();
+			r.dPkts = column(ArchiveColumn::Packets).Varint();
+			r.dOctets = column(ArchiveColumn::Octets).Varint();
+			const std::uint32_t first = prevFirst + UnZigZag(column(ArchiveColumn::First).Varint());
+			const std::uint32_t last = first + UnZigZag(column(ArchiveColumn::Last).Varint());
+			r.firstUs = first * 1'000'000ULL;
+			r.lastUs = last * 1'000'000ULL;
+			r.tcpFlags = column(ArchiveColumn::TcpFlags).Rle();
+			prevFirst = first;
+		}
+
+		const bool ok = std::all_of(columns.begin(), columns.end(), [](const ColumnReader & c) {
+			return c.Ok();
+		});
+		if (!ok) {
+			Logger::LogError<>("Corrupted archive block " + std::to_string(index));
+			out.clear();
+		}
+		return ok;
+	}
+
+	std::uint32_t FlowArchiveReader::Scan(std::uint32_t fromSec, std::uint32_t toSec, const std::function<void(const FlowRecord &)> & f)
+	{
+		std::uint32_t decoded = 0;
+		std::vector<FlowRecord> records;
+		for (std::size_t i = 0; i < _blocks.size(); i++) {
+			// bloky mimo okno přeskočíme jen podle zápatí
+			if (_blocks[i].maxLast < fromSec || _blocks[i].minFirst > toSec) {
+				continue;
+			}
+			decoded++;
+			if (!ReadBlock(i, records)) {
+				continue;
+			}
+			for (const auto & r : records) {
+				if (r.LastSec() >= fromSec && r.FirstSec() <= toSec) {
+					f(r);
+				}
+			}
+		}
+		return decoded;
+	}
+} // namespace Netflow
@@ -0,0 +1,191 @@
+/**
+ * @file flow_archive.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Sloupcový archiv flow záznamů na disku - zápis (cíl exportu) a čtení časového okna
+ */
+
+#pragma once
+
+#include "flow_sink.h"
+#include "flow_record.h"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Sloupce archivu - jeden pro každou položku FlowRecord (pořadí v bloku)
+	 */
+	enum class ArchiveColumn
+	{
+		IpVersion, ///< RLE (délka běhu varint, byte)
+		SrcAddr,   ///< 4 nebo 16 bytů podle IpVersion
+		DstAddr,   ///< 4 nebo 16 bytů podle IpVersion
+		SrcPort,   ///< varint
+		DstPort,   ///< varint
+		Prot,      ///< RLE
+		Tos,       ///< RLE
+		Packets,   ///< varint
+		Octets,    ///< varint
+		First,     ///< zigzag varint rozdílu proti předchozímu záznamu
+		Last,      ///< zigzag varint rozdílu proti `first` téhož záznamu
+		TcpFlags,  ///< RLE
+		Count
+	};
+
+	/// @brief Počet sloupců
+	constexpr std::size_t ArchiveColumnCount = static_cast<std::size_t>(ArchiveColumn::Count);
+
+	/**
+	 * @brief Položka zápatí archivu - umístění bloku a rozsah jeho časů
+	 */
+	struct ArchiveBlockInfo
+	{
+		std::uint64_t offset;   ///< Offset bloku v souboru
+		std::uint32_t size;     ///< Velikost bloku v bytech
+		std::uint32_t nRecords; ///< Počet záznamů v bloku
+		std::uint32_t minFirst; ///< Nejmenší `first` v bloku
+		std::uint32_t maxLast;  ///< Největší `last` v bloku
+	};
+
+	/**
+	 * @brief Zapisuje flow záznamy do sloupcového archivu po blocích. Soubor: hlavička, bloky (velikosti sloupců,
+	 * pak sloupce), zápatí s ArchiveBlockInfo pro každý blok a koncová značka s offsetem zápatí.
+	 * Zápatí se zapíše až při Close() (nebo v destruktoru) - do té doby archiv nelze číst.
+	 */
+	class FlowArchiveWriter : public FlowSink
+	{
+	public:
+		/// @brief Výchozí počet záznamů v bloku
+		static constexpr std::uint32_t DefaultBlockRecords = 16384;
+
+		/**
+		 * @brief Konstruktor - vytvoří (přepíše) soubor a zapíše hlavičku
+		 *
+		 * @param path cesta k archivu
+		 * @param blockRecords počet záznamů v bloku
+		 */
+		FlowArchiveWriter(const std::string & path, std::uint32_t blockRecords = DefaultBlockRecords);
+
+		/**
+		 * @brief Destruktor - dokončí archiv (Close())
+		 */
+		~FlowArchiveWriter() override;
+
+		bool IsInitialized() const override
+		{
+			return _out.is_open() && !_failed;
+		}
+
+		bool Write(const std::vector<FlowRecord> & records) override;
+
+		/**
+		 * @brief Zapíše neúplný blok
+		 */
+		void Flush() override;
+
+		/**
+		 * @brief Zapíše zbylé záznamy a zápatí a zavře soubor
+		 */
+		void Close();
+	private:
+		/// @brief Cesta k archivu
+		const std::string _path;
+
+		/// @brief Počet záznamů v bloku
+		const std::uint32_t _blockRecords;
+
+		/// @brief Soubor
+		std::ofstream _out;
+
+		/// @brief Chyba zápisu (hlásí se jednou)
+		bool _failed = false;
+
+		/// @brief Rozpracovaný blok
+		std::vector<FlowRecord> _block;
+
+		/// @brief Zapsané bloky
+		std::vector<ArchiveBlockInfo> _blocks;
+
+		/// @brief Buffery sloupců (znovu použité pro každý blok)
+		std::array<std::vector<std::uint8_t>, ArchiveColumnCount> _columns;
+
+		/// @brief Počet zapsaných záznamů
+		std::uint64_t _nRecords = 0;
+
+		/**
+		 * @brief Zakóduje a zapíše `_block`
+		 */
+		void WriteBlock();
+
+		/**
+		 * @brief Zkontroluje stav souboru, při chybě ji ohlásí
+		 *
+		 * @return true bez chyby
+		 */
+		bool CheckStream();
+	};
+
+	/**
+	 * @brief Čte archiv zapsaný FlowArchiveWriter. Časové okno čte jen z bloků, jejichž rozsah časů ho protíná
+	 * (podle zápatí); ostatní bloky se ani nenačtou.
+	 */
+	class FlowArchiveReader
+	{
+	public:
+		/**
+		 * @brief Otevře archiv a načte zápatí
+		 *
+		 * @param path cesta k archivu
+		 * @return std::unique_ptr<FlowArchiveReader> čtenář; nullptr, pokud soubor chybí nebo není platný archiv
+		 */
+		static std::unique_ptr<FlowArchiveReader> Open(const std::string & path);
+
+		/**
+		 * @brief Bloky archivu
+		 */
+		const std::vector<ArchiveBlockInfo> & Blocks() const
+		{
+			return _blocks;
+		}
+
+		/**
+		 * @brief Dekóduje jeden blok
+		 *
+		 * @param index index bloku
+		 * @param out záznamy bloku (přepíše obsah)
+		 * @return true blok je platný
+		 */
+		bool ReadBlock(std::size_t index, std::vector<FlowRecord> & out);
+
+		/**
+		 * @brief Projde záznamy, jejichž interval [first, last] protíná [fromSec, toSec]
+		 *
+		 * @param fromSec začátek okna (unix sekundy)
+		 * @param toSec konec okna (včetně)
+		 * @param f volá se pro každý záznam v okně
+		 * @return std::uint32_t počet dekódovaných bloků
+		 */
+		std::uint32_t Scan(std::uint32_t fromSec, std::uint32_t toSec, const std::function<void(const FlowRecord &)> & f);
+	private:
+		FlowArchiveReader() = default;
+
+		/// @brief Soubor
+		std::ifstream _in;
+
+		/// @brief Velikost souboru (meze pro offsety a velikosti ze zápatí)
+		std::uint64_t _fileSize = 0;
+
+		/// @brief Zápatí
+		std::vector<ArchiveBlockInfo> _blocks;
+
+		/// @brief Data načteného bloku
+		std::vector<std::uint8_t> _data;
+	};
+} // namespace Netflow
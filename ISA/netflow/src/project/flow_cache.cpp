@@ -0,0 +1,240 @@
+/**
+ * @file flow_cache.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "flow_cache.h"
+
+#include <algorithm>
+
+//#define _loggerDebug
+#include "logger/logger.hpp"
+
+namespace Netflow
+{
+	FlowCache::FlowCache(std::uint32_t activeTimer, std::uint32_t interval, std::uint32_t flowCacheSize, std::uint32_t timerGranularity,
+			StatsBlock * stats, std::uint32_t tcpCloseGrace)
+		: _activeTimer(activeTimer), _interval(interval), _flowCacheSize(flowCacheSize), _tcpCloseGrace(tcpCloseGrace),
+		_timerGranularity(std::max<std::uint32_t>(timerGranularity, 1)),
+		_flows(flowCacheSize), _timers(_flows.Capacity(), timerGranularity, std::max(activeTimer, interval) * 1000ULL),
+		_lru(_flows.Capacity()), _stats(stats), _closed(tcpCloseGrace > 0 ? _flows.Capacity() : 0)
+	{
+		_toExport.reserve(30);
+		if (_stats != nullptr) {
+			_stats->cacheBytes.Set(MemoryBytes());
+		}
+	}
+
+	void FlowCache::AddNewRecord(const FlowPacket & pkt)
+	{
+		// volající expiruje jen na začátku dávky; paket, který překročí hranici slotu kola, musí nejdřív nechat vypršet
+		// záznamy s dřívějším časem, jinak by se do nich přidal (časy vypršení jsou zaokrouhlené na sloty, takže
+		// expirace jednou za slot dává stejný výsledek jako expirace před každým paketem)
+		if (TimevalToMs(pkt.ts) >= _nextTickMs) {
+			ExpireFlows(pkt.ts);
+		}
+		_currentTime = pkt.ts;
+
+		std::uint32_t index = _flows.Find(pkt.key, pkt.hash);
+		if (index != FlowTable::InvalidIndex) {
+			AddPacketToFlow(pkt, _flows.At(index));
+			_lru.Touch(index);
+		}
+		else {
+			// paket nepatří do žádné existující flow; vytvoříme novou
+			index = CreateNewFlow(pkt);
+		}
+
+		if (_tcpCloseGrace > 0 && (pkt.tcpFlags & (Th_FIN | Th_RST))) {
+			TrackTcpClose(index, pkt.tcpFlags);
+		}
+	}
+
+	void FlowCache::ExpireFlows(const timeval & now)
+	{
+		_currentTime = now;
+		_nextTickMs = (TimevalToMs(now) / _timerGranularity + 1) * _timerGranularity;
+
+		// pouze záznamy, kterým timer mohl vypršet; ostatních se nedotkneme
+		_timers.Advance(TimevalToMs(_currentTime), [this](std::uint32_t index) {
+			TryFlowExport(index);
+		});
+	}
+
+	void FlowCache::EvictIfFull()
+	{
+		if (_flows.Size() >= _flowCacheSize) {
+			EvictColdestFlow();
+		}
+	}
+
+	void FlowCache::Flush()
+	{
+		_flows.ForEach([this](std::uint32_t index, FlowRecord & record) {
+			SaveFlowExport(record);
+			RemoveFlow(index, ExpireReason::Flushed);
+		});
+	}
+
+	void FlowCache::Checkpoint(CheckpointState & state) const
+	{
+		_lru.ForEachColdestFirst([this, &state](std::uint32_t index) {
+			state.records.push_back(_flows.At(index));
+			state.closed.push_back(IsClosed(index) ? 1 : 0);
+		});
+	}
+
+	void FlowCache::Restore(const FlowRecord & record, bool closed)
+	{
+		const std::uint64_t hash = record.key.Hash();
+		if (_flows.Find(record.key, hash) != FlowTable::InvalidIndex) {
+			// poškozený checkpoint; klíč v cache musí být jedinečný
+			return;
+		}
+		if (_flows.Size() >= _flowCacheSize) {
+			EvictColdestFlow();
+		}
+
+		const std::uint32_t index = _flows.Insert(record, hash);
+		if (closed && !_closed.empty()) {
+			_closed[index] = 1;
+		}
+		_timers.Schedule(index, FlowDeadline(index));
+		_lru.Touch(index);
+
+		if (_stats != nullptr) {
+			_stats->cacheFlows.Set(_flows.Size());
+		}
+	}
+
+	std::size_t FlowCache::MemoryBytes() const
+	{
+		return _flows.MemoryBytes() + _timers.MemoryBytes() + _lru.MemoryBytes() + _closed.capacity() * sizeof(std::uint8_t);
+	}
+
+	void FlowCache::AddPacketToFlow(const FlowPacket & pkt, FlowRecord & record)
+	{
+		record.dPkts++;
+		record.dOctets += pkt.octets;
+		record.lastUs = TimevalToUs(_currentTime);
+		record.tcpFlags |= pkt.tcpFlags;
+	}
+
+	std::uint32_t FlowCache::CreateNewFlow(const FlowPacket & pkt)
+	{
+		if (_flows.Size() >= _flows.Capacity()) {
+			// plná cache; uvolníme místo
+			EvictColdestFlow();
+		}
+
+		FlowRecord r {};
+		r.key = pkt.key;
+		r.dOctets = pkt.octets;
+		r.dPkts = 1;
+		r.firstUs = TimevalToUs(_currentTime);
+		r.lastUs = r.firstUs;
+		r.tcpFlags = pkt.tcpFlags;
+
+		LOG_DEBUG("Saved record");
+		const std::uint32_t index = _flows.Insert(r, pkt.hash);
+		_timers.Schedule(index, FlowDeadline(index));
+		_lru.Touch(index);
+
+		if (_stats != nullptr) {
+			_stats->flowsCreated.Add();
+			_stats->cacheFlows.Set(_flows.Size());
+		}
+		return index;
+	}
+
+	void FlowCache::TrackTcpClose(std::uint32_t index, std::uint8_t tcpFlags)
+	{
+		// opačný směr je samostatný záznam; hledáme ho jen u paketů s FIN/RST
+		const FlowKey reverseKey = _flows.At(index).key.Reversed();
+		const std::uint32_t reverse = _flows.Find(reverseKey, reverseKey.Hash());
+
+		if (tcpFlags & Th_RST) {
+			CloseFlow(index);
+			if (reverse != FlowTable::InvalidIndex) {
+				CloseFlow(reverse);
+			}
+		}
+		else if (reverse != FlowTable::InvalidIndex && (_flows.At(index).tcpFlags & Th_FIN) && (_flows.At(reverse).tcpFlags & Th_FIN)) {
+			CloseFlow(index);
+			CloseFlow(reverse);
+		}
+	}
+
+	void FlowCache::CloseFlow(std::uint32_t index)
+	{
+		if (_closed[index]) {
+			return;
+		}
+		LOG_DEBUG("TCP connection closed");
+		_closed[index] = 1;
+		// nový čas je dřívější než naplánovaný - kolo by ho jinak zkontrolovalo až v původním čase
+		_timers.Schedule(index, FlowDeadline(index));
+	}
+
+	void FlowCache::EvictColdestFlow()
+	{
+		const std::uint32_t coldest = _lru.Coldest();
+		if (coldest != LruList::InvalidIndex) {
+			SaveFlowExport(_flows.At(coldest));
+			RemoveFlow(coldest, ExpireReason::Evicted);
+		}
+	}
+
+	bool FlowCache::TryFlowExport(std::uint32_t index)
+	{
+		FlowRecord & record = _flows.At(index);
+
+		// kolo mohlo mít naplánovaný dřívější čas - záznam mezitím dostal další pakety (`last` se posunul)
+		const std::uint64_t deadline = FlowDeadline(index);
+		if (deadline <= TimevalToMs(_currentTime)) {
+			// vypršel timer, "exportujeme" packet (přidáme ho do paketů k exportu)
+			LOG_DEBUG("Saved flow export");
+			SaveFlowExport(record);
+			// active timer vyprší dřív nebo současně s inactive -> active timeout
+			const bool active = record.firstUs + _activeTimer * 1'000'000ULL
+				<= record.lastUs + InactiveTimer(index) * 1'000'000ULL;
+			const ExpireReason inactiveReason = IsClosed(index) ? ExpireReason::TcpClose : ExpireReason::InactiveTimeout;
+			RemoveFlow(index, active ? ExpireReason::ActiveTimeout : inactiveReason);
+			return true;
+		}
+
+		_timers.Schedule(index, deadline);
+		return false;
+	}
+
+	std::uint64_t FlowCache::FlowDeadline(std::uint32_t index) const
+	{
+		const FlowRecord & record = _flows.At(index);
+		const std::uint64_t activeDeadline = record.firstUs + _activeTimer * 1'000'000ULL;
+		const std::uint64_t inactiveDeadline = record.lastUs + InactiveTimer(index) * 1'000'000ULL;
+		const std::uint64_t granularityUs = _timerGranularity * 1000ULL;
+		return (std::min(activeDeadline, inactiveDeadline) + granularityUs - 1) / granularityUs * _timerGranularity;
+	}
+
+	void FlowCache::RemoveFlow(std::uint32_t index, ExpireReason reason)
+	{
+		_timers.Cancel(index);
+		_lru.Remove(index);
+		_flows.Erase(index);
+		if (!_closed.empty()) {
+			_closed[index] = 0;
+		}
+
+		if (_stats != nullptr) {
+			_stats->Expire(reason);
+			_stats->cacheFlows.Set(_flows.Size());
+		}
+	}
+
+	void FlowCache::SaveFlowExport(FlowRecord & record)
+	{
+		// převod do formátu exportu (a header) až při exportu
+		_toExport.push_back(record);
+	}
+} // namespace Netflow
@@ -0,0 +1,269 @@
+/**
+ * @file flow_cache.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Flow-cache: agregace paketů do flow záznamů, expirace a vyřazování záznamů
+ */
+
+#pragma once
+
+#include "flow_record.h"
+#include "flow_table.h"
+#include "timer_wheel.h"
+#include "lru_list.h"
+#include "exporter_stats.h"
+#include "flow_checkpoint.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Flow-cache. Agreguje pakety do flow záznamů a záznamy, kterým vypršel timer nebo byly vyřazeny z plné cache,
+	 * ukládá do `Expired()`. Nic neodesílá - odeslání je na volajícím.
+	 *
+	 * Instance není thread-safe; při více vláknech má každé vlákno vlastní instanci (shard).
+	 */
+	class FlowCache
+	{
+	public:
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param activeTimer interval v sekundách, po kterém se exportují aktivní záznamy
+		 * @param interval interval v sekundách, po jehož vypršení se exportují neaktivní záznamy
+		 * @param flowCacheSize velikost flow-cache. Při dosažení max. velikosti dojde k exportu nejdéle nepoužitého záznamu
+		 * @param timerGranularity granularita časovacího kola v ms
+		 * @param stats blok statistik vlákna, které cache používá (nullptr = bez statistik)
+		 * @param tcpCloseGrace doba v sekundách, po které se exportuje ukončené TCP spojení (0 = ukončení se nesleduje)
+		 */
+		FlowCache(std::uint32_t activeTimer, std::uint32_t interval, std::uint32_t flowCacheSize, std::uint32_t timerGranularity,
+			StatsBlock * stats = nullptr, std::uint32_t tcpCloseGrace = 0);
+
+		/**
+		 * @brief Přidá paket do existujícího flow záznamu nebo vytvoří nový. Pokud paket patří do dalšího slotu
+		 * časovacího kola než poslední ExpireFlows(), nejdřív připraví k exportu záznamy, kterým mezitím vypršel timer.
+		 *
+		 * @param pkt paket
+		 */
+		void AddNewRecord(const FlowPacket & pkt);
+
+		/**
+		 * @brief Přednačte položky flow tabulky pro dávku paketů, aby se výpadky cache při následných AddNewRecord()
+		 * překrývaly místo čekání na každý zvlášť
+		 *
+		 * @param pkts pakety
+		 * @param n počet paketů
+		 */
+		void Prefetch(const FlowPacket * pkts, std::uint32_t n) const
+		{
+			for (std::uint32_t i = 0; i < n; i++) {
+				_flows.PrefetchBucket(pkts[i].hash);
+			}
+			for (std::uint32_t i = 0; i < n; i++) {
+				_flows.PrefetchRecord(pkts[i].hash);
+			}
+		}
+
+		/**
+		 * @brief Posune čas cache a připraví k exportu záznamy, kterým vypršel timer
+		 *
+		 * @param now současný čas
+		 */
+		void ExpireFlows(const timeval & now);
+
+		/**
+		 * @brief Pokud cache dosáhla maximální velikosti, připraví k exportu nejdéle nepoužitý záznam
+		 */
+		void EvictIfFull();
+
+		/**
+		 * @brief Připraví k exportu všechny záznamy a vyprázdní cache
+		 */
+		void Flush();
+
+		/**
+		 * @brief Připíše otevřené záznamy do checkpointu v pořadí od nejdéle nepoužitého, aby Restore() obnovilo i pořadí LRU.
+		 * Cache se nemění.
+		 *
+		 * @param state checkpoint
+		 */
+		void Checkpoint(CheckpointState & state) const;
+
+		/**
+		 * @brief Vloží záznam z checkpointu, jako by byl naposledy použitý. Čas vypršení se odvodí ze záznamu; je-li cache
+		 * plná, připraví se k exportu nejdéle nepoužitý záznam. Před obnovením je potřeba nastavit čas cache ExpireFlows().
+		 *
+		 * @param record záznam
+		 * @param closed TCP spojení záznamu bylo ukončeno
+		 */
+		void Restore(const FlowRecord & record, bool closed);
+
+		/**
+		 * @brief Současný čas cache (čas posledního paketu nebo posunu)
+		 *
+		 * @return const timeval& čas
+		 */
+		const timeval & CurrentTime() const
+		{
+			return _currentTime;
+		}
+
+		/**
+		 * @brief Záznamy připravené k exportu. Volající je po odeslání vyprázdní.
+		 *
+		 * @return std::vector<FlowRecord>& záznamy
+		 */
+		std::vector<FlowRecord> & Expired()
+		{
+			return _toExport;
+		}
+
+		/**
+		 * @brief Paměť alokovaná cache (tabulka, časovací kolo, LRU, příznaky ukončení), bez záznamů připravených k exportu
+		 *
+		 * @return std::size_t byty
+		 */
+		std::size_t MemoryBytes() const;
+
+		/**
+		 * @brief Počet záznamů v cache
+		 *
+		 * @return std::uint32_t počet záznamů
+		 */
+		std::uint32_t Size() const
+		{
+			return _flows.Size();
+		}
+	private:
+		/// @brief Netflow active timer
+		const std::uint32_t _activeTimer;
+
+		/// @brief Netflow interval
+		const std::uint32_t _interval;
+
+		/// @brief Netflow velikost flow cache
+		const std::uint32_t _flowCacheSize;
+
+		/// @brief Inactive timer ukončeného TCP spojení (0 = ukončení se nesleduje)
+		const std::uint32_t _tcpCloseGrace;
+
+		/// @brief Granularita časovacího kola (ms) - zaokrouhlují se na ni časy vypršení
+		const std::uint32_t _timerGranularity;
+
+		/// @brief Současný čas
+		timeval _currentTime {};
+
+		/// @brief Začátek následujícího slotu časovacího kola v ms; paket s pozdějším časem spustí ExpireFlows()
+		std::uint64_t _nextTickMs = 0;
+
+		/// @brief Existující flow záznamy
+		FlowTable _flows;
+
+		/// @brief Časy vypršení (active/inactive timer) záznamů v `_flows`
+		TimerWheel _timers;
+
+		/// @brief Pořadí záznamů v `_flows` podle posledního použití
+		LruList _lru;
+
+		/// @brief Záznamy připravené k exportu
+		std::vector<FlowRecord> _toExport;
+
+		/// @brief Statistiky (může být nullptr)
+		StatsBlock * const _stats;
+
+		/// @brief Příznak ukončeného TCP spojení pro záznamy v `_flows` (prázdné, pokud se ukončení nesleduje)
+		std::vector<std::uint8_t> _closed;
+
+		/**
+		 * @brief Aktualizuje hodnoty ve flow záznamu daty z příchozího paketu
+		 *
+		 * @param pkt paket
+		 * @param record záznam
+		 */
+		void AddPacketToFlow(const FlowPacket & pkt, FlowRecord & record);
+
+		/**
+		 * @brief Vytvoří nový flow záznam z paketu a přidá ho do `_flows`
+		 *
+		 * @param pkt paket
+		 * @return std::uint32_t index nového záznamu
+		 */
+		std::uint32_t CreateNewFlow(const FlowPacket & pkt);
+
+		/**
+		 * @brief Po paketu s FIN nebo RST zkontroluje, jestli je spojení ukončené (RST, nebo FIN oběma směry),
+		 * a pokud ano, zkrátí inactive timer obou směrů na `_tcpCloseGrace` (koncové ACK ho ještě prodlouží)
+		 *
+		 * @param index index záznamu, do kterého paket patří
+		 * @param tcpFlags TCP flagy paketu
+		 */
+		void TrackTcpClose(std::uint32_t index, std::uint8_t tcpFlags);
+
+		/**
+		 * @brief Označí záznam jako ukončené spojení a přeplánuje ho
+		 *
+		 * @param index index záznamu
+		 */
+		void CloseFlow(std::uint32_t index);
+
+		/**
+		 * @brief Zda záznam patří ukončenému TCP spojení
+		 *
+		 * @param index index záznamu
+		 */
+		bool IsClosed(std::uint32_t index) const
+		{
+			return !_closed.empty() && _closed[index];
+		}
+
+		/**
+		 * @brief Připraví k exportu a odstraní nejdéle nepoužitý záznam v `_flows`
+		 */
+		void EvictColdestFlow();
+
+		/**
+		 * @brief Zkontroluje timery (inactive + active) a pokud je to nutné, tak záznam připraví k exportu (SaveFlowExport())
+		 * a odstraní ho. Jinak ho znovu naplánuje v `_timers`.
+		 *
+		 * @param index index záznamu v `_flows`
+		 * @return true záznam byl připraven k exportu
+		 * @return false záznam nebyl připraven k exportu
+		 */
+		bool TryFlowExport(std::uint32_t index);
+
+		/**
+		 * @brief Čas v ms, kdy záznamu vyprší active nebo inactive timer, zaokrouhlený nahoru na granularitu kola.
+		 * Záznamy vypršelé v rámci jednoho slotu se tak exportují společně (plnější datagramy) a nikdy ne dřív.
+		 *
+		 * @param index index záznamu
+		 * @return std::uint64_t čas vypršení v ms
+		 */
+		std::uint64_t FlowDeadline(std::uint32_t index) const;
+
+		/**
+		 * @brief Inactive timer záznamu v sekundách (kratší pro ukončené TCP spojení)
+		 *
+		 * @param index index záznamu
+		 */
+		std::uint32_t InactiveTimer(std::uint32_t index) const
+		{
+			return IsClosed(index) ? std::min(_tcpCloseGrace, _interval) : _interval;
+		}
+
+		/**
+		 * @brief Odstraní záznam z `_flows`, `_timers` i `_lru`
+		 *
+		 * @param index index záznamu
+		 * @param reason důvod (pro statistiky)
+		 */
+		void RemoveFlow(std::uint32_t index, ExpireReason reason);
+
+		/**
+		 * @brief Uloží záznam do `_toExport` - připraven k exportu
+		 *
+		 * @param record záznam
+		 */
+		void SaveFlowExport(FlowRecord & record);
+	};
+} // namespace Netflow
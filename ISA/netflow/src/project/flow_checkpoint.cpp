@@ -0,0 +1,208 @@
+/**
+ * @file flow_checkpoint.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "flow_checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger/logger.hpp"
+
+namespace
+{
+	/// @brief Verze formátu checkpointu
+	constexpr std::uint32_t CheckpointVersion = 2;
+
+	/// @brief Magic number checkpointu
+	constexpr char CheckpointMagic[8] = {'N', 'F', 'C', 'K', 'P', 'T', '\0', '\0'};
+
+	/**
+	 * @brief Hlavička souboru s checkpointem
+	 */
+	struct CheckpointHeader
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t recordSize;    ///< sizeof(FlowRecord) - jiné sestavení může mít jiné rozložení
+		std::uint32_t nStreams;
+		std::uint32_t reserved;
+		std::uint64_t nRecords;
+		std::int64_t startSec;
+		std::int64_t startUsec;
+		std::int64_t currentSec;
+		std::int64_t currentUsec;
+		std::uint64_t streamsOffset; ///< std::uint32_t[nStreams]
+		std::uint64_t recordsOffset; ///< FlowRecord[nRecords]
+		std::uint64_t closedOffset;  ///< std::uint8_t[nRecords]
+		std::uint64_t fileSize;
+	};
+
+	static_assert(std::is_trivially_copyable_v<Netflow::FlowRecord>, "FlowRecord is stored in its memory representation");
+
+	/**
+	 * @brief Zarovná offset nahoru na násobek `alignment`
+	 */
+	constexpr std::uint64_t AlignUp(std::uint64_t offset, std::uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	/**
+	 * @brief Přečte hlavičku ze začátku mapování
+	 */
+	CheckpointHeader ReadHeader(const std::uint8_t * data)
+	{
+		CheckpointHeader header;
+		std::memcpy(&header, data, sizeof(header));
+		return header;
+	}
+} // namespace
+
+namespace Netflow
+{
+	bool FlowCheckpoint::Save(const std::string & path, const CheckpointState & state)
+	{
+		CheckpointHeader header {};
+		std::memcpy(header.magic, CheckpointMagic, sizeof(CheckpointMagic));
+		header.version = CheckpointVersion;
+		header.recordSize = sizeof(FlowRecord);
+		header.nStreams = state.flowsSeen.size();
+		header.nRecords = state.records.size();
+		header.startSec = state.startTs.tv_sec;
+		header.startUsec = state.startTs.tv_usec;
+		header.currentSec = state.currentTime.tv_sec;
+		header.currentUsec = state.currentTime.tv_usec;
+		header.streamsOffset = sizeof(CheckpointHeader);
+		// záznamy musí být v mapování zarovnané, aby se daly číst přímo
+		header.recordsOffset = AlignUp(header.streamsOffset + header.nStreams * sizeof(std::uint32_t), alignof(FlowRecord));
+		header.closedOffset = header.recordsOffset + header.nRecords * sizeof(FlowRecord);
+		header.fileSize = header.closedOffset + header.nRecords;
+
+		std::vector<std::uint8_t> closed(state.closed);
+		closed.resize(state.records.size());
+		const char padding[alignof(FlowRecord)] {};
+
+		const std::string tmpPath = path + ".tmp";
+		{
+			std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char *>(state.flowsSeen.data()), header.nStreams * sizeof(std::uint32_t));
+			out.write(padding, header.recordsOffset - (header.streamsOffset + header.nStreams * sizeof(std::uint32_t)));
+			out.write(reinterpret_cast<const char *>(state.records.data()), header.nRecords * sizeof(FlowRecord));
+			out.write(reinterpret_cast<const char *>(closed.data()), closed.size());
+			if (!out) {
+				Logger::LogError<>("Couldn't write " + tmpPath);
+				std::remove(tmpPath.c_str());
+				return false;
+			}
+		}
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+			Logger::LogError<>("Couldn't rename " + tmpPath + " to " + path);
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+
+		Logger::LogInfo<>("Saved " + std::to_string(header.nRecords) + " flows into checkpoint " + path + " ("
+			+ std::to_string(header.fileSize) + " bytes)");
+		return true;
+	}
+
+	std::unique_ptr<FlowCheckpoint> FlowCheckpoint::Load(const std::string & path)
+	{
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd == -1) {
+			Logger::LogWarning<>("Couldn't open checkpoint " + path + ", starting with an empty flow cache");
+			return nullptr;
+		}
+
+		struct stat st {};
+		if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || static_cast<std::size_t>(st.st_size) < sizeof(CheckpointHeader)) {
+			close(fd);
+			Logger::LogError<>("Ignoring invalid checkpoint " + path);
+			return nullptr;
+		}
+
+		const std::size_t size = st.st_size;
+		void * map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// mapování zůstává platné i po zavření deskriptoru
+		close(fd);
+		if (map == MAP_FAILED) {
+			Logger::LogError<>("Couldn't map checkpoint " + path);
+			return nullptr;
+		}
+		// záznamy se projdou jednou od začátku do konce
+		madvise(map, size, MADV_SEQUENTIAL);
+		madvise(map, size, MADV_WILLNEED);
+
+		std::unique_ptr<FlowCheckpoint> checkpoint(new FlowCheckpoint(path, static_cast<const std::uint8_t *>(map), size));
+
+		const CheckpointHeader header = ReadHeader(checkpoint->_data);
+		const bool valid = std::memcmp(header.magic, CheckpointMagic, sizeof(CheckpointMagic)) == 0
+			&& header.version == CheckpointVersion
+			&& header.recordSize == sizeof(FlowRecord)
+			&& header.fileSize == size
+			&& header.streamsOffset == sizeof(CheckpointHeader)
+			&& header.recordsOffset % alignof(FlowRecord) == 0
+			&& header.recordsOffset >= header.streamsOffset + static_cast<std::uint64_t>(header.nStreams) * sizeof(std::uint32_t)
+			&& header.nRecords <= size / sizeof(FlowRecord)
+			&& header.closedOffset == header.recordsOffset + header.nRecords * sizeof(FlowRecord)
+			&& header.closedOffset + header.nRecords == size;
+		if (!valid) {
+			Logger::LogError<>("Ignoring invalid checkpoint " + path + " (written by another version?)");
+			return nullptr;
+		}
+
+		checkpoint->_records = reinterpret_cast<const FlowRecord *>(checkpoint->_data + header.recordsOffset);
+		checkpoint->_closed = checkpoint->_data + header.closedOffset;
+		return checkpoint;
+	}
+
+	FlowCheckpoint::FlowCheckpoint(const std::string & path, const std::uint8_t * data, std::size_t size)
+		: _path(path), _data(data), _size(size)
+	{
+	}
+
+	FlowCheckpoint::~FlowCheckpoint()
+	{
+		munmap(const_cast<std::uint8_t *>(_data), _size);
+	}
+
+	timeval FlowCheckpoint::StartTs() const
+	{
+		const CheckpointHeader header = ReadHeader(_data);
+		return timeval {static_cast<time_t>(header.startSec), static_cast<suseconds_t>(header.startUsec)};
+	}
+
+	timeval FlowCheckpoint::CurrentTime() const
+	{
+		const CheckpointHeader header = ReadHeader(_data);
+		return timeval {static_cast<time_t>(header.currentSec), static_cast<suseconds_t>(header.currentUsec)};
+	}
+
+	std::uint32_t FlowCheckpoint::StreamCount() const
+	{
+		return ReadHeader(_data).nStreams;
+	}
+
+	std::uint32_t FlowCheckpoint::FlowsSeen(std::uint32_t stream) const
+	{
+		std::uint32_t flowsSeen;
+		std::memcpy(&flowsSeen, _data + sizeof(CheckpointHeader) + stream * sizeof(std::uint32_t), sizeof(flowsSeen));
+		return flowsSeen;
+	}
+
+	std::uint64_t FlowCheckpoint::Size() const
+	{
+		return ReadHeader(_data).nRecords;
+	}
+} // namespace Netflow
@@ -0,0 +1,147 @@
+/**
+ * @file flow_checkpoint.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Checkpoint flow-cache - uložení otevřených záznamů při ukončení a jejich obnovení po restartu
+ */
+
+#pragma once
+
+#include "flow_record.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/time.h>
+
+namespace Netflow
+{
+	/**
+	 * @brief Stav exportéru ukládaný do checkpointu
+	 */
+	struct CheckpointState
+	{
+		timeval startTs {};                     ///< Čas startu exportéru (základ SysUptime v exportu)
+		timeval currentTime {};                 ///< Čas flow-cache při uložení
+		std::vector<std::uint32_t> flowsSeen {}; ///< Počet odeslaných záznamů pro každý kolektor (sekvenční čísla)
+		std::vector<FlowRecord> records {};     ///< Otevřené záznamy od nejdéle nepoužitého po naposledy použitý
+		std::vector<std::uint8_t> closed {};    ///< Příznak ukončeného TCP spojení pro každý záznam
+	};
+
+	/**
+	 * @brief Checkpoint namapovaný do paměti. Záznamy se do souboru zapisují v paměťové reprezentaci (FlowRecord),
+	 * takže se při obnovení nic neparsuje - záznamy se čtou přímo z mapování a vkládají do flow-cache.
+	 * Časovače se neukládají, čas vypršení se odvodí ze záznamu (`first`, `last`, příznak ukončení);
+	 * pořadí LRU určuje pořadí záznamů.
+	 *
+	 * Formát: hlavička (magic "NFCKPT", verze, velikost FlowRecord, počty a offsety částí), počty odeslaných záznamů
+	 * kolektorů, záznamy, příznaky ukončení; hodnoty jsou v pořadí bytů stroje, který checkpoint vytvořil.
+	 */
+	class FlowCheckpoint
+	{
+	public:
+		/**
+		 * @brief Zapíše checkpoint (přes dočasný soubor a přejmenování - nikdy nevznikne poloviční checkpoint)
+		 *
+		 * @param path cesta k souboru
+		 * @param state uložený stav
+		 * @return true checkpoint byl zapsán
+		 * @return false chyba (zalogována)
+		 */
+		static bool Save(const std::string & path, const CheckpointState & state);
+
+		/**
+		 * @brief Namapuje checkpoint
+		 *
+		 * @param path cesta k souboru
+		 * @return std::unique_ptr<FlowCheckpoint> checkpoint nebo nullptr, pokud neexistuje nebo je neplatný (zalogováno)
+		 */
+		static std::unique_ptr<FlowCheckpoint> Load(const std::string & path);
+
+		/**
+		 * @brief Destruktor - zruší mapování
+		 */
+		~FlowCheckpoint();
+
+		FlowCheckpoint(const FlowCheckpoint &) = delete;
+		FlowCheckpoint & operator=(const FlowCheckpoint &) = delete;
+
+		/**
+		 * @brief Cesta k souboru s checkpointem
+		 */
+		const std::string & Path() const
+		{
+			return _path;
+		}
+
+		/**
+		 * @brief Čas startu exportéru
+		 */
+		timeval StartTs() const;
+
+		/**
+		 * @brief Čas flow-cache při uložení
+		 */
+		timeval CurrentTime() const;
+
+		/**
+		 * @brief Počet kolektorů, pro které jsou uložena sekvenční čísla
+		 */
+		std::uint32_t StreamCount() const;
+
+		/**
+		 * @brief Počet odeslaných záznamů kolektoru
+		 *
+		 * @param stream index kolektoru (< StreamCount())
+		 */
+		std::uint32_t FlowsSeen(std::uint32_t stream) const;
+
+		/**
+		 * @brief Počet uložených záznamů
+		 */
+		std::uint64_t Size() const;
+
+		/**
+		 * @brief Záznamy (ukazují do mapování) od nejdéle nepoužitého po naposledy použitý
+		 */
+		const FlowRecord * Records() const
+		{
+			return _records;
+		}
+
+		/**
+		 * @brief Příznaky ukončeného TCP spojení (ukazují do mapování)
+		 */
+		const std::uint8_t * Closed() const
+		{
+			return _closed;
+		}
+
+	private:
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param path cesta k souboru
+		 * @param data začátek mapování
+		 * @param size velikost mapování
+		 */
+		FlowCheckpoint(const std::string & path, const std::uint8_t * data, std::size_t size);
+
+		/// @brief Cesta k souboru
+		const std::string _path;
+
+		/// @brief Začátek mapování
+		const std::uint8_t * _data;
+
+		/// @brief Velikost mapování
+		const std::size_t _size;
+
+		/// @brief Záznamy v mapování
+		const FlowRecord * _records = nullptr;
+
+		/// @brief Příznaky ukončení v mapování
+		const std::uint8_t * _closed = nullptr;
+	};
+} // namespace Netflow
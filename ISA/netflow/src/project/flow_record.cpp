@@ -0,0 +1,86 @@
+/**
+ * @file flow_record.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "flow_record.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Netflow
+{
+	FlowKey FlowKey::FromPacket(const ParsedPacket & pkt)
+	{
+		FlowKey k {};
+		k.ipVersion = pkt.ipVersion;
+		if (pkt.ipVersion == IpVersion::Ipv4) {
+			std::copy(std::begin(pkt.ipv4h->srcAddr), std::end(pkt.ipv4h->srcAddr), k.srcAddr.begin());
+			std::copy(std::begin(pkt.ipv4h->dstAddr), std::end(pkt.ipv4h->dstAddr), k.dstAddr.begin());
+			k.prot = pkt.ipv4h->prot;
+			k.tos = pkt.ipv4h->Dscp();
+		}
+		else {
+			std::copy(std::begin(pkt.ipv6h->srcAddr), std::end(pkt.ipv6h->srcAddr), k.srcAddr.begin());
+			std::copy(std::begin(pkt.ipv6h->dstAddr), std::end(pkt.ipv6h->dstAddr), k.dstAddr.begin());
+			k.prot = pkt.ipv6h->next;
+			k.tos = pkt.ipv6h->Dscp();
+		}
+
+		if (pkt.protocol == Protocol::Tcp) {
+			k.srcPort = pkt.tcph->SrcPort();
+			k.dstPort = pkt.tcph->DstPort();
+		}
+		else if (pkt.protocol == Protocol::Udp) {
+			k.srcPort = pkt.udph->SrcPort();
+			k.dstPort = pkt.udph->DstPort();
+		}
+		return k;
+	}
+
+	FlowPacket FlowPacket::FromPacket(const ParsedPacket & pkt, const timeval & ts)
+	{
+		FlowPacket p {};
+		p.key = FlowKey::FromPacket(pkt);
+		p.hash = p.key.Hash();
+		p.octets = pkt.ipVersion == IpVersion::Ipv4 ? pkt.ipv4h->Length() : pkt.ipv6h->PayloadLength() + Ipv6HeaderSize;
+		if (pkt.protocol == Protocol::Tcp) {
+			p.tcpFlags = pkt.tcph->flags;
+		}
+		p.ts = ts;
+		return p;
+	}
+
+	uint64_t FlowKey::Hash() const
+	{
+		// adresy po 64b slovech, porty + protokol + tos + verze v posledním; promícháme (finalizer z MurmurHash3)
+		std::uint64_t words[4];
+		std::memcpy(words, srcAddr.data(), 16);
+		std::memcpy(words + 2, dstAddr.data(), 16);
+
+		std::uint64_t h = (static_cast<std::uint64_t>(srcPort) << 48) | (static_cast<std::uint64_t>(dstPort) << 32)
+			| (static_cast<std::uint64_t>(prot) << 16) | (static_cast<std::uint64_t>(tos) << 8) | static_cast<std::uint64_t>(ipVersion);
+		for (std::uint64_t w : words) {
+			h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+			h ^= h >> 32;
+		}
+
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	uint64_t FlowKey::SymmetricHash() const
+	{
+		// oba směry převedeme na stejný klíč - menší (adresa, port) jako zdroj
+		const int cmp = std::memcmp(srcAddr.data(), dstAddr.data(), srcAddr.size());
+		if (cmp > 0 || (cmp == 0 && srcPort > dstPort)) {
+			return Reversed().Hash();
+		}
+		return Hash();
+	}
+} // namespace Netflow
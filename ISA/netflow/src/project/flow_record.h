@@ -0,0 +1,264 @@
+/**
+ * @file flow_record.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Zpracovaný paket, klíč flow záznamu a flow záznam
+ */
+
+#pragma once
+
+#include "pcap_utils.h"
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <sys/time.h>
+
+namespace Netflow
+{
+	namespace Constants
+	{
+		/// @brief ICMP ip protokol číslo
+		constexpr std::uint8_t IcmpProtocolNumber = 1;
+
+		/// @brief TCP ip protokol číslo
+		constexpr std::uint8_t TcpProtocolNumber = 6;
+
+		/// @brief UDP ip protokol číslo
+		constexpr std::uint8_t UdpProtocolNumber = 17;
+
+		/// @brief ICMPv6 ip protokol číslo
+		constexpr std::uint8_t Icmpv6ProtocolNumber = 58;
+	} // namespace Constants
+
+	/**
+	 * @brief Verze IP
+	 */
+	enum class IpVersion : uint8_t
+	{
+		None,
+		Ipv4,
+		Ipv6
+	};
+
+	/**
+	 * @brief Podporované ip protokoly
+	 */
+	enum class Protocol
+	{
+		None,
+		Tcp,
+		Udp,
+		Icmp
+	};
+
+	/**
+	 * @brief Výsledek parsování paketu
+	 */
+	enum class ParseError
+	{
+		None,
+		NotIp,               ///< Ethernet rámec nenese IPv4 ani IPv6
+		MalformedIp,         ///< Neplatná IP hlavička
+		UnsupportedProtocol, ///< Jiný protokol než TCP/UDP/ICMP
+		MalformedL4          ///< Neplatná TCP/UDP hlavička (IP část je v pořádku)
+	};
+
+	/**
+	 * @brief Pomocná struktura pro uložení ukazatelů na začátky headerů.
+	 */
+	struct ParsedPacket
+	{
+		const EthernetHeader * eth {nullptr};
+
+		IpVersion ipVersion {IpVersion::None};
+		union {
+			const Ipv4Header * ipv4h {nullptr};
+			const Ipv6Header * ipv6h;
+		};
+
+		Protocol protocol {Protocol::None};
+		union
+		{
+			const TcpHeader * tcph {nullptr};
+			const UdpHeader * udph;
+			const IcmpHeader * icmph;
+		};
+
+		const std::uint8_t * payload {nullptr};
+		uint32_t size; ///< Celková velikost paketu
+		ParseError error {ParseError::None};
+	};
+
+	/**
+	 * @brief Klíč flow záznamu - hodnoty, podle kterých se pakety přiřazují do flow.
+	 * Adresy jsou v síťovém pořadí bytů; IPv4 adresa zabírá první 4 byty, zbytek je nulový.
+	 */
+	struct FlowKey
+	{
+		std::array<uint8_t, 16> srcAddr {};
+		std::array<uint8_t, 16> dstAddr {};
+		uint16_t srcPort {};
+		uint16_t dstPort {};
+		uint8_t prot {};
+		uint8_t tos {};
+		IpVersion ipVersion {IpVersion::None};
+
+		/**
+		 * @brief Vytvoří klíč z (ipv4 nebo ipv6) paketu. Porty se vyplňují pouze pro TCP a UDP, jinak jsou nulové.
+		 *
+		 * @param pkt paket
+		 * @return FlowKey klíč
+		 */
+		static FlowKey FromPacket(const ParsedPacket & pkt);
+
+		/**
+		 * @brief Hash klíče. Dolních 32 bitů určuje pozici ve flow tabulce, shard a vzorkování, horních 16 otisk
+		 * ve flow tabulce (FlowTable) - otisk tak rozlišuje i klíče se stejnou pozicí a shardem.
+		 *
+		 * @return uint64_t hash
+		 */
+		uint64_t Hash() const;
+
+		/**
+		 * @brief Hash, který je stejný pro oba směry spojení (pro rozdělení paketů mezi shardy)
+		 *
+		 * @return uint64_t hash
+		 */
+		uint64_t SymmetricHash() const;
+
+		/**
+		 * @brief Klíč opačného směru - prohozené adresy a porty
+		 *
+		 * @return FlowKey klíč
+		 */
+		FlowKey Reversed() const
+		{
+			FlowKey k = *this;
+			std::swap(k.srcAddr, k.dstAddr);
+			std::swap(k.srcPort, k.dstPort);
+			return k;
+		}
+
+		/**
+		 * @brief Zdrojová IPv4 adresa (v pořadí bytů hosta)
+		 *
+		 * @return uint32_t adresa
+		 */
+		uint32_t SrcAddrV4() const
+		{
+			return ReadAddrV4(srcAddr);
+		}
+
+		/**
+		 * @brief Cílová IPv4 adresa (v pořadí bytů hosta)
+		 *
+		 * @return uint32_t adresa
+		 */
+		uint32_t DstAddrV4() const
+		{
+			return ReadAddrV4(dstAddr);
+		}
+
+		bool operator==(const FlowKey & other) const
+		{
+			return srcAddr == other.srcAddr
+				&& dstAddr == other.dstAddr
+				&& srcPort == other.srcPort
+				&& dstPort == other.dstPort
+				&& prot == other.prot
+				&& tos == other.tos
+				&& ipVersion == other.ipVersion;
+		}
+	private:
+		static uint32_t ReadAddrV4(const std::array<uint8_t, 16> & addr)
+		{
+			return (static_cast<uint32_t>(addr[0]) << 24) | (static_cast<uint32_t>(addr[1]) << 16)
+				| (static_cast<uint32_t>(addr[2]) << 8) | addr[3];
+		}
+	};
+
+	/**
+	 * @brief Údaje z paketu, které potřebuje flow-cache. Na rozdíl od ParsedPacket neukazuje do dat paketu,
+	 * takže ho lze předat jinému vláknu.
+	 */
+	struct FlowPacket
+	{
+		FlowKey key {};
+		uint64_t hash {};     ///< `key.Hash()`
+		uint32_t octets {};   ///< Velikost L3 paketu
+		uint8_t tcpFlags {};  ///< TCP flagy (0 pro ostatní protokoly)
+		timeval ts {};        ///< Čas příchodu paketu
+
+		/**
+		 * @brief Vytvoří FlowPacket z (ipv4 nebo ipv6) paketu
+		 *
+		 * @param pkt paket
+		 * @param ts čas příchodu paketu
+		 * @return FlowPacket
+		 */
+		static FlowPacket FromPacket(const ParsedPacket & pkt, const timeval & ts);
+	};
+
+	/**
+	 * @brief Flow záznam - klíč a agregované hodnoty. Před odesláním se převádí do formátu exportu
+	 * (NetflowV5FlowRecord nebo IPFIX datový záznam).
+	 *
+	 * Záznam zabírá přesně jednu cache line: klíč (40 B), se kterým se porovnává při vyhledávání, je na začátku,
+	 * čítače a časy za ním - vyhledání i aktualizace záznamu tak načtou jedinou line.
+	 * Časy jsou v µs od epochy; `last` sdílí 8 bytů s TCP flagy (56 bitů stačí do roku 4253).
+	 */
+	struct alignas(64) FlowRecord
+	{
+		FlowKey key;
+		uint32_t dPkts;
+		uint32_t dOctets;
+		uint64_t firstUs;       ///< Čas prvního paketu (µs)
+		uint64_t lastUs : 56;   ///< Čas posledního paketu (µs)
+		uint64_t tcpFlags : 8;  ///< OR TCP flagů všech paketů
+
+		/**
+		 * @brief Čas prvního paketu v sekundách (pro formáty exportu)
+		 *
+		 * @return uint32_t sekundy od epochy
+		 */
+		uint32_t FirstSec() const
+		{
+			return static_cast<uint32_t>(firstUs / 1'000'000);
+		}
+
+		/**
+		 * @brief Čas posledního paketu v sekundách (pro formáty exportu)
+		 *
+		 * @return uint32_t sekundy od epochy
+		 */
+		uint32_t LastSec() const
+		{
+			return static_cast<uint32_t>(lastUs / 1'000'000);
+		}
+	};
+
+	static_assert(sizeof(FlowKey) == 40, "FlowKey must stay 40 bytes");
+	static_assert(sizeof(FlowRecord) == 64, "FlowRecord must fit one cache line");
+
+	/**
+	 * @brief Převede timeval na milisekundy
+	 * 
+	 * @param t timeval
+	 * @return std::uint64_t milisekundy
+	 */
+	inline std::uint64_t TimevalToMs(const timeval & t)
+	{
+		return static_cast<std::uint64_t>(t.tv_sec) * 1000 + static_cast<std::uint64_t>(t.tv_usec) / 1000;
+	}
+
+	/**
+	 * @brief Převede timeval na mikrosekundy
+	 * 
+	 * @param t timeval
+	 * @return std::uint64_t mikrosekundy
+	 */
+	inline std::uint64_t TimevalToUs(const timeval & t)
+	{
+		return static_cast<std::uint64_t>(t.tv_sec) * 1'000'000 + static_cast<std::uint64_t>(t.tv_usec);
+	}
+} // namespace Netflow
@@ -0,0 +1,42 @@
+/**
+ * @file flow_sink.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Rozhraní cíle exportu, který ukládá flow záznamy jinam než na kolektor
+ */
+
+#pragma once
+
+#include "flow_record.h"
+
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Cíl exportu (např. FlowArchiveWriter). Pokud ho exportér má, zapisuje do něj záznamy místo
+	 * serializace do datagramů pro CollectorConnection.
+	 */
+	class FlowSink
+	{
+	public:
+		virtual ~FlowSink() = default;
+
+		/**
+		 * @brief Zda je cíl připraven k zápisu
+		 */
+		virtual bool IsInitialized() const = 0;
+
+		/**
+		 * @brief Zapíše záznamy (může je držet v bufferu do Flush())
+		 *
+		 * @param records záznamy
+		 * @return true zapsáno (nebo uloženo do bufferu)
+		 */
+		virtual bool Write(const std::vector<FlowRecord> & records) = 0;
+
+		/**
+		 * @brief Zapíše vše, co je v bufferu
+		 */
+		virtual void Flush() = 0;
+	};
+} // namespace Netflow
@@ -0,0 +1,119 @@
+/**
+ * @file flow_table.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "flow_table.h"
+
+#include <algorithm>
+
+namespace Netflow
+{
+	FlowTable::FlowTable(std::uint32_t capacity)
+	{
+		capacity = std::max<std::uint32_t>(capacity, 1);
+
+		std::uint32_t nBuckets = 2;
+		while (nBuckets < capacity * 2ULL) {
+			nBuckets <<= 1;
+		}
+		_fingerprints.resize(nBuckets, EmptyFingerprint);
+		_slots.resize(nBuckets, InvalidIndex);
+		_mask = nBuckets - 1;
+
+		_records.resize(capacity);
+		_hashes.resize(capacity);
+		_livePos.resize(capacity, InvalidIndex);
+		_live.reserve(capacity);
+
+		// volné indexy bereme od konce - nejdříve se obsadí nízké indexy
+		_free.reserve(capacity);
+		for (std::uint32_t i = capacity; i > 0; i--) {
+			_free.push_back(i - 1);
+		}
+	}
+
+	std::uint32_t FlowTable::Find(const FlowKey & key, std::uint64_t hash) const
+	{
+		const std::uint16_t fingerprint = Fingerprint(hash);
+		for (std::uint32_t pos = hash & _mask; ; pos = (pos + 1) & _mask) {
+			const std::uint16_t f = _fingerprints[pos];
+			if (f == EmptyFingerprint) {
+				return InvalidIndex;
+			}
+			if (f == fingerprint && _records[_slots[pos]].key == key) {
+				return _slots[pos];
+			}
+		}
+	}
+
+	std::uint32_t FlowTable::Insert(const FlowRecord & record, std::uint64_t hash)
+	{
+		if (_free.empty()) {
+			return InvalidIndex;
+		}
+
+		const std::uint32_t index = _free.back();
+		_free.pop_back();
+
+		_records[index] = record;
+		_hashes[index] = static_cast<std::uint32_t>(hash);
+		_livePos[index] = static_cast<std::uint32_t>(_live.size());
+		_live.push_back(index);
+
+		// zaplnění je max. 50 %, prázdná položka vždy existuje
+		std::uint32_t pos = hash & _mask;
+		while (_fingerprints[pos] != EmptyFingerprint) {
+			pos = (pos + 1) & _mask;
+		}
+		_fingerprints[pos] = Fingerprint(hash);
+		_slots[pos] = index;
+
+		return index;
+	}
+
+	void FlowTable::Erase(std::uint32_t index)
+	{
+		if (index >= _records.size() || _livePos[index] == InvalidIndex) {
+			return;
+		}
+
+		// najdeme položku indexu - mezi domovskou pozicí a záznamem nejsou prázdné pozice, stačí porovnat index
+		std::uint32_t pos = _hashes[index] & _mask;
+		while (_slots[pos] != index) {
+			pos = (pos + 1) & _mask;
+		}
+
+		// backward-shift deletion; bez "tombstone" položek se sondovací řetězce nezhoršují
+		std::uint32_t next = (pos + 1) & _mask;
+		while (_fingerprints[next] != EmptyFingerprint) {
+			const std::uint32_t ideal = _hashes[_slots[next]] & _mask;
+			// položku `next` lze posunout na `pos`, pokud její ideální pozice neleží v cyklickém intervalu (pos, next]
+			if (((next - ideal) & _mask) >= ((next - pos) & _mask)) {
+				_fingerprints[pos] = _fingerprints[next];
+				_slots[pos] = _slots[next];
+				pos = next;
+			}
+			next = (next + 1) & _mask;
+		}
+		_fingerprints[pos] = EmptyFingerprint;
+
+		// na uvolněné místo v `_live` přesuneme poslední záznam
+		const std::uint32_t last = _live.back();
+		_live[_livePos[index]] = last;
+		_livePos[last] = _livePos[index];
+		_live.pop_back();
+		_livePos[index] = InvalidIndex;
+
+		_free.push_back(index);
+	}
+
+	std::size_t FlowTable::MemoryBytes() const
+	{
+		return _fingerprints.capacity() * sizeof(std::uint16_t) + _slots.capacity() * sizeof(std::uint32_t)
+			+ _records.capacity() * sizeof(FlowRecord) + _hashes.capacity() * sizeof(std::uint32_t)
+			+ _live.capacity() * sizeof(std::uint32_t) + _livePos.capacity() * sizeof(std::uint32_t)
+			+ _free.capacity() * sizeof(std::uint32_t);
+	}
+} // namespace Netflow
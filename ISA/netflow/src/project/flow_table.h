@@ -0,0 +1,187 @@
+/**
+ * @file flow_table.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Hashovací tabulka flow záznamů (flow-cache)
+ */
+
+#pragma once
+
+#include "flow_record.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Flow-cache s pevnou kapacitou. Záznamy leží v poli s pevnými indexy (index se po dobu života záznamu nemění),
+	 * vyhledávání probíhá přes index s otevřenou adresací (lineární sondování) a předpočítanými hashi.
+	 * Vyhledání, vložení i odstranění mají konstantní očekávanou složitost nezávislou na velikosti cache.
+	 *
+	 * Index je rozdělený na pole (structure of arrays): sondování prochází pouze 16bitové otisky hashe (32 pozic
+	 * v jedné cache line), index záznamu a záznam se čtou až při shodě otisku.
+	 */
+	class FlowTable
+	{
+	public:
+		/// @brief Neplatný index záznamu
+		static constexpr std::uint32_t InvalidIndex = UINT32_MAX;
+
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param capacity maximální počet záznamů
+		 */
+		FlowTable(std::uint32_t capacity);
+
+		/**
+		 * @brief Najde záznam podle klíče
+		 *
+		 * @param key klíč
+		 * @param hash hash klíče (`key.Hash()`)
+		 * @return std::uint32_t index záznamu nebo InvalidIndex
+		 */
+		std::uint32_t Find(const FlowKey & key, std::uint64_t hash) const;
+
+		/**
+		 * @brief Přednačte (prefetch) položku indexu pro hash - první krok dávkového vyhledávání
+		 *
+		 * @param hash hash klíče
+		 */
+		void PrefetchBucket(std::uint64_t hash) const
+		{
+			__builtin_prefetch(&_fingerprints[hash & _mask]);
+			__builtin_prefetch(&_slots[hash & _mask]);
+		}
+
+		/**
+		 * @brief Přednačte záznam, na který ukazuje domovská položka indexu (pokud sedí hash) - druhý krok
+		 * dávkového vyhledávání, po PrefetchBucket() pro celou dávku
+		 *
+		 * @param hash hash klíče
+		 */
+		void PrefetchRecord(std::uint64_t hash) const
+		{
+			const std::uint32_t pos = hash & _mask;
+			if (_fingerprints[pos] == Fingerprint(hash)) {
+				__builtin_prefetch(&_records[_slots[pos]]);
+			}
+		}
+
+		/**
+		 * @brief Vloží nový záznam. Záznam se stejným klíčem nesmí v tabulce existovat.
+		 *
+		 * @param record záznam
+		 * @param hash hash klíče záznamu
+		 * @return std::uint32_t index vloženého záznamu nebo InvalidIndex, pokud je tabulka plná
+		 */
+		std::uint32_t Insert(const FlowRecord & record, std::uint64_t hash);
+
+		/**
+		 * @brief Odstraní záznam
+		 *
+		 * @param index index záznamu
+		 */
+		void Erase(std::uint32_t index);
+
+		/**
+		 * @brief Vrátí záznam na indexu
+		 *
+		 * @param index index záznamu
+		 * @return FlowRecord& záznam
+		 */
+		FlowRecord & At(std::uint32_t index)
+		{
+			return _records[index];
+		}
+
+		const FlowRecord & At(std::uint32_t index) const
+		{
+			return _records[index];
+		}
+
+		/**
+		 * @brief Počet uložených záznamů
+		 *
+		 * @return std::uint32_t počet záznamů
+		 */
+		std::uint32_t Size() const
+		{
+			return static_cast<std::uint32_t>(_live.size());
+		}
+
+		/**
+		 * @brief Maximální počet záznamů
+		 *
+		 * @return std::uint32_t kapacita
+		 */
+		std::uint32_t Capacity() const
+		{
+			return static_cast<std::uint32_t>(_records.size());
+		}
+
+		/**
+		 * @brief Paměť alokovaná tabulkou (index, záznamy a pomocná pole)
+		 *
+		 * @return std::size_t byty
+		 */
+		std::size_t MemoryBytes() const;
+
+		/**
+		 * @brief Zavolá `f(index, record)` pro každý uložený záznam. Uvnitř `f` je možné volat Erase() na právě procházený záznam.
+		 * Složitost je úměrná počtu uložených záznamů, ne kapacitě.
+		 *
+		 * @param f funkce
+		 */
+		template <typename F>
+		void ForEach(F f)
+		{
+			// odzadu - Erase() přesune na místo odstraněného záznamu poslední (už navštívený) záznam
+			for (std::uint32_t i = _live.size(); i > 0; i--) {
+				const std::uint32_t index = _live[i - 1];
+				f(index, _records[index]);
+			}
+		}
+	private:
+		/// @brief Otisk prázdné pozice indexu
+		static constexpr std::uint16_t EmptyFingerprint = 0;
+
+		/**
+		 * @brief Otisk hashe - horních 16 bitů 64bitového hashe. Pozici v indexu i shard určuje dolních 32 bitů,
+		 * klíče porovnávané při sondování se tak v otisku liší stejně jako libovolné jiné; nikdy není EmptyFingerprint
+		 *
+		 * @param hash hash klíče
+		 * @return std::uint16_t otisk
+		 */
+		static std::uint16_t Fingerprint(std::uint64_t hash)
+		{
+			const std::uint16_t fingerprint = static_cast<std::uint16_t>(hash >> 48);
+			return fingerprint != EmptyFingerprint ? fingerprint : 1;
+		}
+
+		/// @brief Otisky hashů pozic indexu; EmptyFingerprint = prázdná pozice (velikost je mocnina 2, zaplnění max. 50 %)
+		std::vector<std::uint16_t> _fingerprints;
+
+		/// @brief Indexy do `_records` pro pozice indexu (platné jen u neprázdných pozic)
+		std::vector<std::uint32_t> _slots;
+
+		/// @brief Maska pro výpočet pozice v indexu
+		std::uint32_t _mask;
+
+		/// @brief Záznamy
+		std::vector<FlowRecord> _records;
+
+		/// @brief Dolních 32 bitů hashe klíče každého záznamu (pro nalezení pozice v indexu a ideální pozice při odstranění)
+		std::vector<std::uint32_t> _hashes;
+
+		/// @brief Indexy uložených záznamů (husté pole pro procházení)
+		std::vector<std::uint32_t> _live;
+
+		/// @brief Pozice záznamu v `_live`; InvalidIndex = volný záznam
+		std::vector<std::uint32_t> _livePos;
+
+		/// @brief Volné indexy v `_records`
+		std::vector<std::uint32_t> _free;
+	};
+} // namespace Netflow
@@ -0,0 +1,50 @@
+/**
+ * @file flush_timer.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "flush_timer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "logger/logger.hpp"
+
+namespace Netflow
+{
+	FlushTimer::FlushTimer(std::uint32_t periodMs) : _fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+	{
+		if (_fd == -1) {
+			Logger::LogError<>("Couldn't create timerfd: " + std::string(std::strerror(errno)));
+			return;
+		}
+
+		itimerspec spec {};
+		spec.it_interval.tv_sec = periodMs / 1000;
+		spec.it_interval.tv_nsec = static_cast<long>(periodMs % 1000) * 1000000;
+		spec.it_value = spec.it_interval;
+		if (timerfd_settime(_fd, 0, &spec, nullptr) != 0) {
+			Logger::LogError<>("Couldn't start timerfd: " + std::string(std::strerror(errno)));
+			close(_fd);
+			_fd = -1;
+		}
+	}
+
+	FlushTimer::~FlushTimer()
+	{
+		if (_fd != -1) {
+			close(_fd);
+		}
+	}
+
+	bool FlushTimer::Consume()
+	{
+		std::uint64_t expirations = 0;
+		return read(_fd, &expirations, sizeof(expirations)) == sizeof(expirations) && expirations > 0;
+	}
+} // namespace Netflow
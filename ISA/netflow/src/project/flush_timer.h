@@ -0,0 +1,61 @@
+/**
+ * @file flush_timer.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Periodický časovač (timerfd) pro export, když nepřicházejí pakety
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace Netflow
+{
+	/**
+	 * @brief Periodický časovač nad timerfd. Jeho deskriptor se čeká spolu se zdrojem paketů
+	 * (PacketSource::WaitReadable()), takže čtení paketů se po uplynutí periody přeruší i na tichém vstupu.
+	 */
+	class FlushTimer
+	{
+	public:
+		/**
+		 * @brief Konstruktor - vytvoří a spustí časovač
+		 *
+		 * @param periodMs perioda v ms
+		 */
+		FlushTimer(std::uint32_t periodMs);
+
+		/**
+		 * @brief Destruktor - zavře deskriptor
+		 */
+		~FlushTimer();
+
+		FlushTimer(const FlushTimer &) = delete;
+		FlushTimer & operator=(const FlushTimer &) = delete;
+
+		/**
+		 * @brief Zda se časovač podařilo vytvořit
+		 */
+		bool IsInitialized() const
+		{
+			return _fd != -1;
+		}
+
+		/**
+		 * @brief Deskriptor časovače (čitelný po uplynutí periody)
+		 */
+		int Fd() const
+		{
+			return _fd;
+		}
+
+		/**
+		 * @brief Potvrdí uplynulé periody (deskriptor přestane být čitelný)
+		 *
+		 * @return true od posledního volání uplynula alespoň jedna perioda
+		 */
+		bool Consume();
+	private:
+		/// @brief timerfd
+		int _fd;
+	};
+} // namespace Netflow
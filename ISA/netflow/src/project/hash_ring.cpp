@@ -0,0 +1,56 @@
+/**
+ * @file hash_ring.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "hash_ring.h"
+
+#include <algorithm>
+
+namespace
+{
+	/**
+	 * @brief Hash řetězce (FNV-1a, promíchaný finalizerem z MurmurHash3)
+	 */
+	std::uint32_t HashString(const std::string & s)
+	{
+		std::uint64_t h = 0xCBF29CE484222325ULL;
+		for (const unsigned char c : s) {
+			h = (h ^ c) * 0x100000001B3ULL;
+		}
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ULL;
+		h ^= h >> 33;
+		return static_cast<std::uint32_t>(h);
+	}
+} // namespace
+
+namespace Netflow
+{
+	HashRing::HashRing(const std::vector<std::string> & nodes, std::uint32_t replicas)
+	{
+		_points.reserve(nodes.size() * replicas);
+		for (std::uint32_t node = 0; node < nodes.size(); node++) {
+			for (std::uint32_t i = 0; i < replicas; i++) {
+				_points.emplace_back(HashString(nodes[node] + "#" + std::to_string(i)), node);
+			}
+		}
+		std::sort(_points.begin(), _points.end());
+	}
+
+	std::uint32_t HashRing::NodeFor(std::uint32_t hash) const
+	{
+		if (_points.size() <= 1) {
+			return 0;
+		}
+		auto it = std::lower_bound(_points.begin(), _points.end(), std::make_pair(hash, std::uint32_t {0}));
+		if (it == _points.end()) {
+			// kruh - za posledním bodem následuje první
+			it = _points.begin();
+		}
+		return it->second;
+	}
+} // namespace Netflow
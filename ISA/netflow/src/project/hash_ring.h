@@ -0,0 +1,46 @@
+/**
+ * @file hash_ring.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Konzistentní hashování - rozdělení flow mezi kolektory
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Kruh konzistentního hashování. Každý uzel má na kruhu `replicas` bodů (podle hashe jména);
+	 * hash patří prvnímu bodu za ním. Přidání nebo odebrání uzlu přesune jen flow, které patřily jemu
+	 * (nebo mu nově připadnou), ostatní zůstanou na svých uzlech.
+	 */
+	class HashRing
+	{
+	public:
+		/// @brief Výchozí počet bodů na uzel (vyrovnává podíly uzlů)
+		static constexpr std::uint32_t DefaultReplicas = 160;
+
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param nodes jména uzlů (index ve vektoru = výsledek NodeFor())
+		 * @param replicas počet bodů na uzel
+		 */
+		HashRing(const std::vector<std::string> & nodes, std::uint32_t replicas = DefaultReplicas);
+
+		/**
+		 * @brief Uzel, kterému patří hash
+		 *
+		 * @param hash hash klíče (např. FlowKey::SymmetricHash())
+		 * @return std::uint32_t index uzlu
+		 */
+		std::uint32_t NodeFor(std::uint32_t hash) const;
+	private:
+		/// @brief Body kruhu (pozice, index uzlu) seřazené podle pozice
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> _points;
+	};
+} // namespace Netflow
@@ -0,0 +1,198 @@
+/**
+ * @file ipfix_datagram.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Struktury a serializace IPFIX (RFC 7011) zprávy - hlavička, šablony a datové záznamy
+ */
+
+#pragma once
+
+#include "netflow_datagram.h"
+#include "flow_record.h"
+
+#include <cstdint>
+#include <array>
+
+namespace Netflow
+{
+	/// @brief Velikost IPFIX hlavičky
+	constexpr uint32_t IpfixHeaderSize = 16;
+
+	/// @brief Velikost hlavičky setu
+	constexpr uint32_t IpfixSetHeaderSize = 4;
+
+	/// @brief Maximální velikost IPFIX zprávy (pole `length` má 16 bitů)
+	constexpr uint32_t IpfixMaxMessageSize = 65535;
+
+	/// @brief ID setu se šablonami
+	constexpr uint16_t IpfixTemplateSetId = 2;
+
+	/// @brief ID šablony pro IPv4 záznamy
+	constexpr uint16_t IpfixTemplateIpv4 = 256;
+
+	/// @brief ID šablony pro IPv6 záznamy
+	constexpr uint16_t IpfixTemplateIpv6 = 257;
+
+	/**
+	 * @brief Pole šablony - information element (IANA ID) a jeho délka
+	 */
+	struct IpfixField
+	{
+		uint16_t id;
+		uint16_t length;
+	};
+
+	/// @brief Pole IPv4 šablony; pořadí odpovídá SerializeIpfixRecord()
+	constexpr std::array<IpfixField, 11> IpfixFieldsIpv4 {{
+		{8, 4},   // sourceIPv4Address
+		{12, 4},  // destinationIPv4Address
+		{7, 2},   // sourceTransportPort
+		{11, 2},  // destinationTransportPort
+		{4, 1},   // protocolIdentifier
+		{195, 1}, // ipDiffServCodePoint
+		{6, 1},   // tcpControlBits (zkrácené kódování)
+		{2, 8},   // packetDeltaCount
+		{1, 8},   // octetDeltaCount
+		{150, 4}, // flowStartSeconds
+		{151, 4}  // flowEndSeconds
+	}};
+
+	/// @brief Pole IPv6 šablony; pořadí odpovídá SerializeIpfixRecord()
+	constexpr std::array<IpfixField, 11> IpfixFieldsIpv6 {{
+		{27, 16}, // sourceIPv6Address
+		{28, 16}, // destinationIPv6Address
+		{7, 2},   // sourceTransportPort
+		{11, 2},  // destinationTransportPort
+		{4, 1},   // protocolIdentifier
+		{195, 1}, // ipDiffServCodePoint
+		{6, 1},   // tcpControlBits (zkrácené kódování)
+		{2, 8},   // packetDeltaCount
+		{1, 8},   // octetDeltaCount
+		{150, 4}, // flowStartSeconds
+		{151, 4}  // flowEndSeconds
+	}};
+
+	/**
+	 * @brief Součet délek polí šablony
+	 */
+	template <std::size_t N>
+	constexpr uint32_t IpfixRecordSize(const std::array<IpfixField, N> & fields)
+	{
+		uint32_t size = 0;
+		for (const auto & f : fields) {
+			size += f.length;
+		}
+		return size;
+	}
+
+	/// @brief Velikost IPv4 datového záznamu
+	constexpr uint32_t IpfixRecordSizeIpv4 = IpfixRecordSize(IpfixFieldsIpv4);
+
+	/// @brief Velikost IPv6 datového záznamu
+	constexpr uint32_t IpfixRecordSizeIpv6 = IpfixRecordSize(IpfixFieldsIpv6);
+
+	/// @brief Velikost setu s oběma šablonami
+	constexpr uint32_t IpfixTemplateSetSize = IpfixSetHeaderSize
+		+ 4 + 4 * IpfixFieldsIpv4.size()
+		+ 4 + 4 * IpfixFieldsIpv6.size();
+
+	/// @brief Nejmenší použitelná zpráva - hlavička, šablony a jeden IPv6 záznam
+	constexpr uint32_t IpfixMinMessageSize = IpfixHeaderSize + IpfixTemplateSetSize + IpfixSetHeaderSize + IpfixRecordSizeIpv6;
+
+	/**
+	 * @brief IPFIX hlavička zprávy
+	 */
+	struct IpfixHeader
+	{
+		const uint16_t version {10};     ///< (0-1)   - "Version of IPFIX to which this Message conforms"
+		uint16_t length {};              ///< (2-3)   - "Total length of the IPFIX Message, in octets, including Message Header and Set(s)"
+		uint32_t exportTime {};          ///< (4-7)   - "Time at which the IPFIX Message Header leaves the Exporter"
+		uint32_t sequenceNumber {};      ///< (8-11)  - "Incremental sequence counter modulo 2^32 of all IPFIX Data Records sent"
+		uint32_t observationDomainId {}; ///< (12-15) - "Identifier of the Observation Domain"
+
+		/**
+		 * @brief Serializace této struktury přímo do bufferu
+		 * 
+		 * @param out buffer (alespoň IpfixHeaderSize bytů)
+		 * @return uint8_t* ukazatel za zapsaná data
+		 */
+		uint8_t * SerializeTo(uint8_t * out) const
+		{
+			Put16(out, version);
+			Put16(out, length);
+			Put32(out, exportTime);
+			Put32(out, sequenceNumber);
+			Put32(out, observationDomainId);
+			return out;
+		}
+	};
+
+	/**
+	 * @brief Zapíše hlavičku setu
+	 * 
+	 * @param out buffer (alespoň IpfixSetHeaderSize bytů)
+	 * @param setId ID setu (2 pro šablony, ID šablony pro data)
+	 * @param length délka setu včetně hlavičky
+	 * @return uint8_t* ukazatel za zapsaná data
+	 */
+	inline uint8_t * SerializeIpfixSetHeader(uint8_t * out, uint16_t setId, uint16_t length)
+	{
+		Put16(out, setId);
+		Put16(out, length);
+		return out;
+	}
+
+	/**
+	 * @brief Zapíše set s IPv4 i IPv6 šablonou
+	 * 
+	 * @param out buffer (alespoň IpfixTemplateSetSize bytů)
+	 * @return uint8_t* ukazatel za zapsaná data
+	 */
+	inline uint8_t * SerializeIpfixTemplateSet(uint8_t * out)
+	{
+		out = SerializeIpfixSetHeader(out, IpfixTemplateSetId, IpfixTemplateSetSize);
+
+		Put16(out, IpfixTemplateIpv4);
+		Put16(out, IpfixFieldsIpv4.size());
+		for (const auto & f : IpfixFieldsIpv4) {
+			Put16(out, f.id);
+			Put16(out, f.length);
+		}
+
+		Put16(out, IpfixTemplateIpv6);
+		Put16(out, IpfixFieldsIpv6.size());
+		for (const auto & f : IpfixFieldsIpv6) {
+			Put16(out, f.id);
+			Put16(out, f.length);
+		}
+		return out;
+	}
+
+	/**
+	 * @brief Zapíše datový záznam podle šablony odpovídající verzi IP záznamu
+	 * 
+	 * @param record flow záznam
+	 * @param out buffer (alespoň IpfixRecordSizeIpv4/IpfixRecordSizeIpv6 bytů)
+	 * @return uint8_t* ukazatel za zapsaná data
+	 */
+	inline uint8_t * SerializeIpfixRecord(const FlowRecord & record, uint8_t * out)
+	{
+		// adresy jsou už v síťovém pořadí
+		const std::size_t addrSize = record.key.ipVersion == IpVersion::Ipv6 ? 16 : 4;
+		for (std::size_t i = 0; i < addrSize; i++) {
+			*out++ = record.key.srcAddr[i];
+		}
+		for (std::size_t i = 0; i < addrSize; i++) {
+			*out++ = record.key.dstAddr[i];
+		}
+		Put16(out, record.key.srcPort);
+		Put16(out, record.key.dstPort);
+		*out++ = record.key.prot;
+		*out++ = record.key.tos;
+		*out++ = record.tcpFlags;
+		Put64(out, record.dPkts);
+		Put64(out, record.dOctets);
+		Put32(out, record.FirstSec());
+		Put32(out, record.LastSec());
+		return out;
+	}
+} // namespace Netflow
@@ -0,0 +1,182 @@
+/**
+ * @file async_logger.hpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Asynchronní výstup logu - lock-free kruhový buffer vyprazdňovaný vlastním vláknem
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace Logger
+{
+	/**
+	 * @brief Kruhový buffer zpráv pro více zapisujících vláken a jedno čtecí (fronta D. Vyukova). Zprávy vypisuje vlákno
+	 * na pozadí, takže logování neblokuje zpracování paketů. Při plném bufferu se informační a ladicí zprávy zahodí;
+	 * varování a chyby počkají, až vlákno buffer uvolní.
+	 */
+	class AsyncLogger
+	{
+	public:
+		/// @brief Počet zpráv v bufferu
+		static constexpr std::size_t Capacity = 1024;
+
+		/**
+		 * @brief Instance pro celý proces; vlákno se spustí při prvním použití
+		 *
+		 * @return AsyncLogger& instance
+		 */
+		static AsyncLogger & Instance()
+		{
+			static AsyncLogger logger;
+			return logger;
+		}
+
+		/**
+		 * @brief Destruktor - vypíše zbývající zprávy a ukončí vlákno
+		 */
+		~AsyncLogger()
+		{
+			_stop.store(true, std::memory_order_release);
+			_thread.join();
+			Drain();
+			if (_dropped.load(std::memory_order_relaxed) > 0) {
+				std::cerr << "[!] WARNING: " << _dropped.load(std::memory_order_relaxed) << " log messages dropped\n";
+			}
+			std::cout.flush();
+		}
+
+		AsyncLogger(const AsyncLogger &) = delete;
+		AsyncLogger & operator=(const AsyncLogger &) = delete;
+
+		/**
+		 * @brief Zařadí zprávu k výpisu
+		 *
+		 * @param prefix prefix podle úrovně (např. "[+] INFO: ")
+		 * @param msg zpráva
+		 * @param toStderr vypsat na stderr (jinak stdout)
+		 * @param droppable při plném bufferu zprávu zahodit (jinak se čeká)
+		 */
+		void Push(const char * prefix, std::string msg, bool toStderr, bool droppable)
+		{
+			std::uint64_t pos = _tail.load(std::memory_order_relaxed);
+			Slot * slot;
+			while (true) {
+				slot = &_slots[pos % Capacity];
+				const std::uint64_t seq = slot->seq.load(std::memory_order_acquire);
+				const std::int64_t diff = static_cast<std::int64_t>(seq) - static_cast<std::int64_t>(pos);
+				if (diff == 0) {
+					if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					if (droppable) {
+						_dropped.fetch_add(1, std::memory_order_relaxed);
+						return;
+					}
+					if (_stop.load(std::memory_order_acquire)) {
+						// vlákno už skončilo (ukončení procesu) - buffer nikdo neuvolní
+						Write(prefix, msg, toStderr);
+						return;
+					}
+					std::this_thread::yield();
+					pos = _tail.load(std::memory_order_relaxed);
+				}
+				else {
+					pos = _tail.load(std::memory_order_relaxed);
+				}
+			}
+
+			slot->prefix = prefix;
+			slot->toStderr = toStderr;
+			slot->text = std::move(msg);
+			slot->seq.store(pos + 1, std::memory_order_release);
+		}
+	private:
+		/**
+		 * @brief Zpráva v bufferu. `seq` určuje, kdo smí slot použít (pos = volný pro zápis, pos + 1 = připraven ke čtení).
+		 */
+		struct Slot
+		{
+			std::atomic<std::uint64_t> seq;
+			const char * prefix;
+			bool toStderr;
+			std::string text;
+		};
+
+		/// @brief Jak dlouho vlákno spí při prázdném bufferu
+		static constexpr std::chrono::milliseconds IdleSleep {2};
+
+		Slot _slots[Capacity];
+
+		/// @brief Pozice zápisu (sdílí zapisující vlákna)
+		alignas(64) std::atomic<std::uint64_t> _tail {0};
+
+		/// @brief Pozice čtení (pouze vlákno na pozadí)
+		alignas(64) std::uint64_t _head = 0;
+
+		/// @brief Počet zahozených zpráv
+		std::atomic<std::uint64_t> _dropped {0};
+
+		/// @brief Ukončení vlákna
+		std::atomic<bool> _stop {false};
+
+		/// @brief Vlákno vypisující zprávy
+		std::thread _thread;
+
+		AsyncLogger()
+		{
+			for (std::size_t i = 0; i < Capacity; i++) {
+				_slots[i].seq.store(i, std::memory_order_relaxed);
+			}
+			_thread = std::thread([this]() {
+				while (!_stop.load(std::memory_order_acquire)) {
+					if (!Drain()) {
+						std::this_thread::sleep_for(IdleSleep);
+					}
+				}
+			});
+		}
+
+		/**
+		 * @brief Vypíše všechny připravené zprávy
+		 *
+		 * @return true byla vypsána alespoň jedna zpráva
+		 */
+		bool Drain()
+		{
+			bool any = false;
+			while (true) {
+				Slot & slot = _slots[_head % Capacity];
+				if (slot.seq.load(std::memory_order_acquire) != _head + 1) {
+					break;
+				}
+
+				Write(slot.prefix, slot.text, slot.toStderr);
+
+				slot.seq.store(_head + Capacity, std::memory_order_release);
+				_head++;
+				any = true;
+			}
+			if (any) {
+				std::cout.flush();
+			}
+			return any;
+		}
+
+		/**
+		 * @brief Vypíše zprávu
+		 */
+		static void Write(const char * prefix, const std::string & msg, bool toStderr)
+		{
+			std::ostream & out = toStderr ? std::cerr : std::cout;
+			out << prefix << msg << '\n';
+		}
+	};
+} // namespace Logger
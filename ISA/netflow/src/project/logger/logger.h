@@ -9,6 +9,16 @@
 #include <string>
 #include <iostream>
 
+/**
+ * @brief Debug zpráva. Bez definovaného _loggerDebug (před vložením logger.hpp) se výraz `msg` vůbec nevyhodnotí -
+ * žádné skládání řetězců ani alokace v horkých cestách.
+ */
+#ifdef _loggerDebug
+#define LOG_DEBUG(msg) ::Logger::LogDebug(msg)
+#else
+#define LOG_DEBUG(msg) ((void)0)
+#endif
+
 namespace Logger
 {
 	/**
@@ -23,7 +33,8 @@ namespace Logger
 	};
 
 	/**
-	 * @brief Vypíše zprávu na stderr nebo stdout (dle typu zprávy)
+	 * @brief Zařadí zprávu na stderr nebo stdout (dle typu zprávy). Zprávy vypisuje vlákno na pozadí (AsyncLogger),
+	 * volající nečeká na výstup - jen varování a chyby počkají na místo v plném bufferu.
 	 * 
 	 * @param msg zpráva
 	 * @param level typ zprávy
@@ -56,7 +67,8 @@ namespace Logger
 	void LogError(T msg);
 
 	/**
-	 * @brief Vypíše zprávu úrovně "Debug" na stdout pokud je definován _loggerDebug
+	 * @brief Vypíše zprávu úrovně "Debug" na stdout pokud je definován _loggerDebug.
+	 * V horkých cestách používat LOG_DEBUG, který při vypnutém debugu nevyhodnotí ani argument.
 	 * 
 	 * @param value zpráva
 	 */
@@ -5,9 +5,28 @@
  */
 
 #include "logger.h"
+#include "async_logger.hpp"
+
+#include <sstream>
 
 namespace Logger
 {
+	/**
+	 * @brief Převede zprávu na řetězec
+	 */
+	inline const std::string & ToMessage(const std::string & msg)
+	{
+		return msg;
+	}
+
+	template <typename T>
+	std::string ToMessage(const T & msg)
+	{
+		std::ostringstream o;
+		o << msg;
+		return o.str();
+	}
+
 	template <typename T>
 	void Log(T msg, LogLevel level)
 	{
@@ -16,13 +35,13 @@ namespace Logger
 			LogInfo(msg);
 			break;
 		case LogLevel::Warning:
-			LogInfo(msg);
+			LogWarning(msg);
 			break;
 		case LogLevel::Error:
-			LogInfo(msg);
+			LogError(msg);
 			break;
 		case LogLevel::Debug:
-			LogInfo(msg);
+			LogDebug(msg);
 			break;
 		default:
 			std::cerr << "[Unknown log level]: " << msg << "\n";
@@ -33,26 +52,28 @@ namespace Logger
 	template <typename T>
 	void LogInfo(T msg)
 	{
-		std::cout << "[+] INFO: " << msg << "\n";
+		AsyncLogger::Instance().Push("[+] INFO: ", ToMessage(msg), false, true);
 	}
 
 	template <typename T>
 	void LogWarning(T msg)
 	{
-		std::cerr << "[!] WARNING: " << msg << "\n";
+		AsyncLogger::Instance().Push("[!] WARNING: ", ToMessage(msg), true, false);
 	}
 
 	template <typename T>
 	void LogError(T msg)
 	{
-		std::cerr << "[-] ERROR: " << msg << "\n";
+		AsyncLogger::Instance().Push("[-] ERROR: ", ToMessage(msg), true, false);
 	}
 
 	template <typename T>
 	void LogDebug(T msg)
 	{
 		#ifdef _loggerDebug
-		std::cout << "[?] DEBUG: " << msg << "\n";
+		AsyncLogger::Instance().Push("[?] DEBUG: ", ToMessage(msg), false, true);
+		#else
+		(void)msg;
 		#endif
 	}
 } // namespace Logger
@@ -0,0 +1,60 @@
+/**
+ * @file lru_list.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "lru_list.h"
+
+namespace Netflow
+{
+	LruList::LruList(std::uint32_t capacity)
+		: _next(capacity, InvalidIndex), _prev(capacity, InvalidIndex), _linked(capacity)
+	{
+	}
+
+	void LruList::Touch(std::uint32_t index)
+	{
+		if (_head == index) {
+			return;
+		}
+		Remove(index);
+
+		_prev[index] = InvalidIndex;
+		_next[index] = _head;
+		if (_head != InvalidIndex) {
+			_prev[_head] = index;
+		}
+		else {
+			_tail = index;
+		}
+		_head = index;
+		_linked[index] = 1;
+	}
+
+	std::size_t LruList::MemoryBytes() const
+	{
+		return (_next.capacity() + _prev.capacity()) * sizeof(std::uint32_t) + _linked.capacity() * sizeof(std::uint8_t);
+	}
+
+	void LruList::Remove(std::uint32_t index)
+	{
+		if (!_linked[index]) {
+			return;
+		}
+
+		if (_prev[index] != InvalidIndex) {
+			_next[_prev[index]] = _next[index];
+		}
+		else {
+			_head = _next[index];
+		}
+		if (_next[index] != InvalidIndex) {
+			_prev[_next[index]] = _prev[index];
+		}
+		else {
+			_tail = _prev[index];
+		}
+		_linked[index] = 0;
+	}
+} // namespace Netflow
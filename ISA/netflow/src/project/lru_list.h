@@ -0,0 +1,91 @@
+/**
+ * @file lru_list.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief LRU pořadí záznamů flow-cache
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Intruzivní obousměrně vázaný seznam indexů záznamů (z FlowTable) seřazený od naposledy použitého
+	 * po nejdéle nepoužitý. Všechny operace jsou O(1).
+	 */
+	class LruList
+	{
+	public:
+		/// @brief Neplatný index
+		static constexpr std::uint32_t InvalidIndex = UINT32_MAX;
+
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param capacity maximální index záznamu + 1
+		 */
+		LruList(std::uint32_t capacity);
+
+		/**
+		 * @brief Označí záznam jako naposledy použitý (přesune ho na začátek, případně ho vloží)
+		 *
+		 * @param index index záznamu
+		 */
+		void Touch(std::uint32_t index);
+
+		/**
+		 * @brief Odebere záznam ze seznamu (pokud v něm je)
+		 *
+		 * @param index index záznamu
+		 */
+		void Remove(std::uint32_t index);
+
+		/**
+		 * @brief Paměť alokovaná seznamem
+		 *
+		 * @return std::size_t byty
+		 */
+		std::size_t MemoryBytes() const;
+
+		/**
+		 * @brief Nejdéle nepoužitý záznam
+		 *
+		 * @return std::uint32_t index záznamu nebo InvalidIndex, pokud je seznam prázdný
+		 */
+		std::uint32_t Coldest() const
+		{
+			return _tail;
+		}
+
+		/**
+		 * @brief Zavolá `f(index)` pro každý záznam od nejdéle nepoužitého po naposledy použitý
+		 *
+		 * @param f funkce (nesmí měnit seznam)
+		 */
+		template <typename F>
+		void ForEachColdestFirst(F f) const
+		{
+			for (std::uint32_t index = _tail; index != InvalidIndex; index = _prev[index]) {
+				f(index);
+			}
+		}
+	private:
+		/// @brief Naposledy použitý záznam
+		std::uint32_t _head = InvalidIndex;
+
+		/// @brief Nejdéle nepoužitý záznam
+		std::uint32_t _tail = InvalidIndex;
+
+		/// @brief Následník (směrem k méně použitým)
+		std::vector<std::uint32_t> _next;
+
+		/// @brief Předchůdce (směrem k více použitým)
+		std::vector<std::uint32_t> _prev;
+
+		/// @brief Příznak, jestli je záznam v seznamu
+		std::vector<std::uint8_t> _linked;
+	};
+} // namespace Netflow
@@ -0,0 +1,132 @@
+/**
+ * @file mmap_pcap_source.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "mmap_pcap_source.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger/logger.hpp"
+
+namespace
+{
+	/// @brief Velikost globální hlavičky pcap souboru
+	constexpr std::size_t PcapFileHeaderSize = 24;
+
+	/// @brief Velikost hlavičky záznamu v pcap souboru
+	constexpr std::size_t PcapRecordHeaderSize = 16;
+
+	/// @brief Magic number - mikrosekundová časová razítka
+	constexpr std::uint32_t PcapMagicUsec = 0xA1B2C3D4;
+
+	/// @brief Magic number - nanosekundová časová razítka
+	constexpr std::uint32_t PcapMagicNsec = 0xA1B23C4D;
+} // namespace
+
+namespace Netflow
+{
+	std::unique_ptr<MmapPcapSource> MmapPcapSource::Open(const std::string & file)
+	{
+		const int fd = open(file.c_str(), O_RDONLY);
+		if (fd == -1) {
+			return nullptr;
+		}
+
+		struct stat st {};
+		if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || static_cast<std::size_t>(st.st_size) < PcapFileHeaderSize) {
+			close(fd);
+			return nullptr;
+		}
+
+		const std::size_t size = st.st_size;
+		void * map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// mapování zůstává platné i po zavření deskriptoru
+		close(fd);
+		if (map == MAP_FAILED) {
+			return nullptr;
+		}
+
+		// čteme sekvenčně; huge pages jsou pouze nápověda (pro souborová mapování je jádro nemusí podporovat)
+		madvise(map, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+		madvise(map, size, MADV_HUGEPAGE);
+#endif
+
+		std::unique_ptr<MmapPcapSource> source(new MmapPcapSource(static_cast<const std::uint8_t *>(map), size));
+
+		std::uint32_t magic;
+		std::memcpy(&magic, source->_data, sizeof(magic));
+		if (magic == PcapMagicUsec || magic == PcapMagicNsec) {
+			source->_nanosecond = magic == PcapMagicNsec;
+		}
+		else if (magic == __builtin_bswap32(PcapMagicUsec) || magic == __builtin_bswap32(PcapMagicNsec)) {
+			source->_swapped = true;
+			source->_nanosecond = magic == __builtin_bswap32(PcapMagicNsec);
+		}
+		else {
+			// pcapng nebo neznámý formát - necháme na libpcap
+			return nullptr;
+		}
+
+		return source;
+	}
+
+	MmapPcapSource::MmapPcapSource(const std::uint8_t * data, std::size_t size)
+		: _data(data), _size(size), _offset(PcapFileHeaderSize)
+	{
+	}
+
+	MmapPcapSource::~MmapPcapSource()
+	{
+		munmap(const_cast<std::uint8_t *>(_data), _size);
+	}
+
+	std::uint32_t MmapPcapSource::Read32(const std::uint8_t * p) const
+	{
+		std::uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return _swapped ? __builtin_bswap32(v) : v;
+	}
+
+	bool MmapPcapSource::Seek(std::uint64_t offset)
+	{
+		if (offset < PcapFileHeaderSize || offset > _size) {
+			return false;
+		}
+		_offset = offset;
+		return true;
+	}
+
+	Packet MmapPcapSource::GetNextPacket()
+	{
+		Packet pkt;
+		if (_size - _offset < PcapRecordHeaderSize) {
+			return pkt;
+		}
+
+		const std::uint8_t * rec = _data + _offset;
+		const std::uint32_t caplen = Read32(rec + 8);
+		if (_size - _offset - PcapRecordHeaderSize < caplen) {
+			Logger::LogWarning<>("Truncated pcap record at offset " + std::to_string(_offset));
+			_offset = _size;
+			return pkt;
+		}
+
+		_header.ts.tv_sec = Read32(rec);
+		_header.ts.tv_usec = _nanosecond ? Read32(rec + 4) / 1000 : Read32(rec + 4);
+		_header.caplen = caplen;
+		_header.len = Read32(rec + 12);
+
+		pkt.pktHeader = &_header;
+		pkt.pktData = rec + PcapRecordHeaderSize;
+		_offset += PcapRecordHeaderSize + caplen;
+		return pkt;
+	}
+} // namespace Netflow
@@ -0,0 +1,82 @@
+/**
+ * @file mmap_pcap_source.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Čtení klasických pcap souborů přes mmap (bez libpcap)
+ */
+
+#pragma once
+
+#include "packet_source.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Netflow
+{
+	/**
+	 * @brief Zdroj paketů nad souborem namapovaným do paměti. Prochází hlavičky záznamů přímo v mapování
+	 * a vrací pakety, jejichž data ukazují do mapování (bez kopírování).
+	 * Podporuje pouze klasický pcap formát (mikro- i nanosekundový, obě pořadí bytů).
+	 */
+	class MmapPcapSource : public PacketSource
+	{
+	public:
+		/**
+		 * @brief Otevře a namapuje soubor
+		 * 
+		 * @param file cesta k souboru
+		 * @return std::unique_ptr<MmapPcapSource> zdroj nebo nullptr, pokud soubor nejde namapovat nebo není klasický pcap
+		 */
+		static std::unique_ptr<MmapPcapSource> Open(const std::string & file);
+
+		/**
+		 * @brief Destruktor - zruší mapování
+		 */
+		~MmapPcapSource() override;
+
+		Packet GetNextPacket() override;
+
+		bool Seek(std::uint64_t offset) override;
+
+		std::uint64_t Offset() const override
+		{
+			return _offset;
+		}
+	private:
+		/**
+		 * @brief Konstruktor
+		 * 
+		 * @param data začátek mapování
+		 * @param size velikost mapování
+		 */
+		MmapPcapSource(const std::uint8_t * data, std::size_t size);
+
+		/// @brief Začátek mapování
+		const std::uint8_t * _data;
+
+		/// @brief Velikost mapování
+		const std::size_t _size;
+
+		/// @brief Pozice další hlavičky záznamu
+		std::size_t _offset;
+
+		/// @brief Hodnoty v souboru jsou v opačném pořadí bytů
+		bool _swapped = false;
+
+		/// @brief Časová razítka jsou v nanosekundách
+		bool _nanosecond = false;
+
+		/// @brief Hlavička naposledy vráceného paketu (v souboru má jiné rozložení než pcap_pkthdr)
+		pcap_pkthdr _header {};
+
+		/**
+		 * @brief Přečte 32b hodnotu ze souboru (nezarovnaně, v pořadí bytů souboru)
+		 * 
+		 * @param p ukazatel do mapování
+		 * @return std::uint32_t hodnota
+		 */
+		std::uint32_t Read32(const std::uint8_t * p) const;
+	};
+} // namespace Netflow
@@ -0,0 +1,203 @@
+/**
+ * @file multi_file_reader.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "multi_file_reader.h"
+#include "pcap_index.h"
+
+#include <algorithm>
+#include <filesystem>
+
+//#define _loggerDebug
+#include "logger/logger.hpp"
+
+namespace
+{
+	/**
+	 * @brief Pořadí souborů v min-haldě: std::push_heap staví max-haldu, proto "větší" = pozdější paket
+	 */
+	template <typename Input>
+	bool LaterHead(const Input * a, const Input * b)
+	{
+		if (timercmp(&a->head.pkt.ts, &b->head.pkt.ts, !=)) {
+			return timercmp(&a->head.pkt.ts, &b->head.pkt.ts, >);
+		}
+		return a->order > b->order;
+	}
+} // namespace
+
+namespace Netflow
+{
+	MultiFileReader::MultiFileReader(const std::vector<std::string> & files, ExporterStats & stats, std::uint32_t burstSize,
+			ParseFunction parse, const ReadRange & range, std::shared_ptr<const BpfFilter> filter)
+		: _burstSize(std::max<std::uint32_t>(burstSize, 1)), _parse(std::move(parse)), _range(range), _filter(std::move(filter))
+	{
+		for (const auto & file : files) {
+			// čas prvního paketu určuje pořadí souborů ve slévání
+			auto reader = std::make_unique<Reader>(file, _range, _filter);
+			if (!reader->IsOpen()) {
+				_failed = true;
+				continue;
+			}
+			const Packet first = reader->GetNextPacket();
+			if (first.pktHeader == nullptr) {
+				Logger::LogWarning<>("No packets in " + file + ", skipping");
+				continue;
+			}
+
+			// bloky statistik zakládáme předem - AddBlock() není thread-safe vůči výpisu statistik
+			auto input = std::make_unique<Input>(file, stats.AddBlock());
+			input->reader = std::move(reader);
+			input->first = first;
+			input->firstTs = first.pktHeader->ts;
+			_inputs.push_back(std::move(input));
+		}
+
+		std::stable_sort(_inputs.begin(), _inputs.end(), [](const auto & a, const auto & b) {
+			return timercmp(&a->firstTs, &b->firstTs, <);
+		});
+		for (std::size_t i = 0; i < _inputs.size(); i++) {
+			_inputs[i]->order = i;
+		}
+		_heap.reserve(_inputs.size());
+		Logger::LogInfo<>("Merging " + std::to_string(_inputs.size()) + " pcap files");
+	}
+
+	MultiFileReader::~MultiFileReader()
+	{
+		_stop.store(true, std::memory_order_release);
+		for (auto & input : _inputs) {
+			if (input->thread.joinable()) {
+				input->thread.join();
+			}
+		}
+	}
+
+	bool MultiFileReader::Next(InputPacket & out)
+	{
+		// do slévání zařadíme soubory, jejichž první paket nepředchází nejstaršímu čekajícímu paketu
+		while (_nextInput < _inputs.size()
+				&& (_heap.empty() || !timercmp(&_inputs[_nextInput]->firstTs, &_heap.front()->head.pkt.ts, >))) {
+			Activate(*_inputs[_nextInput++]);
+		}
+		if (_heap.empty()) {
+			return false;
+		}
+
+		std::pop_heap(_heap.begin(), _heap.end(), LaterHead<Input>);
+		Input & input = *_heap.back();
+		out = input.head;
+
+		if (FetchHead(input)) {
+			std::push_heap(_heap.begin(), _heap.end(), LaterHead<Input>);
+		}
+		else {
+			_heap.pop_back();
+			input.thread.join();
+			LOG_DEBUG("Finished " + input.file);
+		}
+		return true;
+	}
+
+	void MultiFileReader::StartReadAhead()
+	{
+		while (_nextStart < _inputs.size() && _nextStart < _nextInput + ReadAheadFiles) {
+			Input & input = *_inputs[_nextStart++];
+			input.thread = std::thread([this, &input]() {
+				ReadFile(input);
+			});
+		}
+	}
+
+	std::vector<std::string> MultiFileReader::ExpandInputs(const std::vector<std::string> & inputs)
+	{
+		std::vector<std::string> files;
+		for (const auto & input : inputs) {
+			std::error_code ec;
+			if (input == "-" || !std::filesystem::is_directory(input, ec)) {
+				files.push_back(input);
+				continue;
+			}
+
+			std::vector<std::string> dirFiles;
+			for (const auto & entry : std::filesystem::directory_iterator(input, ec)) {
+				// indexy (PcapIndex) leží vedle pcap souborů
+				if (entry.is_regular_file(ec) && entry.path().filename().string().front() != '.'
+						&& PcapIndex::PathFor(entry.path().stem().string()) != entry.path().filename().string()) {
+					dirFiles.push_back(entry.path().string());
+				}
+			}
+			if (ec) {
+				Logger::LogError<>("Couldn't read directory " + input + ": " + ec.message());
+			}
+			std::sort(dirFiles.begin(), dirFiles.end());
+			files.insert(files.end(), dirFiles.begin(), dirFiles.end());
+		}
+		return files;
+	}
+
+	void MultiFileReader::Activate(Input & input)
+	{
+		// překrývajících se souborů může být víc než předstihu - vlákno tohoto souboru ještě nemusí běžet
+		StartReadAhead();
+		if (FetchHead(input)) {
+			_heap.push_back(&input);
+			std::push_heap(_heap.begin(), _heap.end(), LaterHead<Input>);
+		}
+		else {
+			input.thread.join();
+		}
+	}
+
+	bool MultiFileReader::FetchHead(Input & input)
+	{
+		while (true) {
+			// `done` čteme před frontou - pokud je nastaveno a fronta je prázdná, nic dalšího už nepřijde
+			const bool done = input.done.load(std::memory_order_acquire);
+			if (input.queue.TryPop(input.head)) {
+				return true;
+			}
+			if (done) {
+				return false;
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	void MultiFileReader::ReadFile(Input & input)
+	{
+		Reader & reader = *input.reader;
+		std::vector<InputPacket> burst(_burstSize);
+
+		Packet p = input.first;
+		while (p.pktHeader != nullptr && p.pktData != nullptr && !_stop.load(std::memory_order_relaxed)) {
+			// dávku naparsujeme, pak ji předáme slévání
+			std::uint32_t n = 0;
+			{
+				StageTimer timer(&input.stats.Latency(Stage::Parse));
+				do {
+					input.stats.packetsRead.Add();
+					InputPacket & in = burst[n];
+					in.parsed = _parse(p.pktData, p.pktHeader->caplen, p.pktHeader->ts, input.stats, in.pkt);
+					in.pkt.ts = p.pktHeader->ts;
+					n++;
+					p = reader.GetNextPacket();
+				} while (n < _burstSize && p.pktHeader != nullptr && p.pktData != nullptr);
+			}
+
+			for (std::uint32_t i = 0; i < n; i++) {
+				while (!input.queue.TryPush(burst[i])) {
+					if (_stop.load(std::memory_order_relaxed)) {
+						return;
+					}
+					std::this_thread::yield();
+				}
+			}
+		}
+		// přečtený soubor hned zavřeme (mapování, deskriptor)
+		input.reader.reset();
+		input.done.store(true, std::memory_order_release);
+	}
+} // namespace Netflow
@@ -0,0 +1,190 @@
+/**
+ * @file multi_file_reader.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Paralelní čtení a parsování více pcap souborů se sléváním podle času paketů
+ */
+
+#pragma once
+
+#include "flow_record.h"
+#include "exporter_stats.h"
+#include "spsc_queue.h"
+#include "pcap_reader.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Přečtený paket po parsování. Čas `pkt.ts` je vyplněn vždy - i zahozený paket posouvá čas.
+	 */
+	struct InputPacket
+	{
+		FlowPacket pkt;
+		bool parsed; ///< false = paket byl zahozen při parsování (důvod je ve statistikách), nese pouze čas
+	};
+
+	/**
+	 * @brief Čte a parsuje více pcap souborů, každý ve vlastním vlákně, a slévá je (k-way merge) podle času paketů.
+	 * Soubory se do slévání zařazují podle času prvního paketu. Vlákna souborů ale běží s předstihem - kromě souborů,
+	 * které slévání právě čte, vždy čte a parsuje i následujících `ReadAheadFiles` souborů, takže i rotované (časově
+	 * navazující) soubory se zpracovávají souběžně. Paměť omezují fronty mezi vlákny a sléváním.
+	 *
+	 * Předpokládá, že pakety uvnitř jednoho souboru jsou seřazené podle času. Next() smí volat pouze jedno vlákno.
+	 */
+	class MultiFileReader
+	{
+	public:
+		/**
+		 * @brief Funkce, která naparsuje paket (volá se z vláken souborů, musí být thread-safe)
+		 *
+		 * @param packet data paketu
+		 * @param caplen počet zachycených bytů paketu
+		 * @param ts čas příchodu paketu
+		 * @param stats statistiky vlákna souboru
+		 * @param out výstupní paket
+		 * @return true paket se má přidat do flow-cache
+		 */
+		using ParseFunction = std::function<bool(const std::uint8_t * packet, std::uint32_t caplen, const timeval & ts, StatsBlock & stats,
+			FlowPacket & out)>;
+
+		/**
+		 * @brief Konstruktor - otevře každý soubor, zjistí čas jeho prvního paketu a založí jejich bloky statistik.
+		 * Otevřený soubor se předá jeho vláknu (stdin lze přečíst jen jednou). Vlákna se spouští až z Next().
+		 *
+		 * @param files soubory (viz ExpandInputs())
+		 * @param stats statistiky
+		 * @param burstSize kolik paketů vlákno souboru parsuje najednou
+		 * @param parse parsovací funkce
+		 * @param range časový rozsah (pro všechny soubory)
+		 * @param filter BPF filtr (pro všechny soubory; nullptr = bez filtru)
+		 */
+		MultiFileReader(const std::vector<std::string> & files, ExporterStats & stats, std::uint32_t burstSize, ParseFunction parse,
+			const ReadRange & range = ReadRange {}, std::shared_ptr<const BpfFilter> filter = nullptr);
+
+		/**
+		 * @brief Destruktor - zastaví a počká na vlákna souborů
+		 */
+		~MultiFileReader();
+
+		MultiFileReader(const MultiFileReader &) = delete;
+		MultiFileReader & operator=(const MultiFileReader &) = delete;
+
+		/**
+		 * @brief Vrátí paket s nejmenším časem ze všech souborů. Pokud vlákno souboru ještě paket nepřipravilo, čeká.
+		 *
+		 * @param out výstupní paket
+		 * @return true paket byl vrácen
+		 * @return false všechny soubory jsou přečtené
+		 */
+		bool Next(InputPacket & out);
+
+		/**
+		 * @brief Zda se některý soubor nepodařilo otevřít (chyba je zalogována)
+		 */
+		bool Failed() const
+		{
+			return _failed;
+		}
+
+		/**
+		 * @brief Rozbalí vstupy z příkazové řádky: adresář se nahradí svými soubory (seřazenými podle jména, bez skrytých
+		 * a bez indexů PcapIndex), ostatní cesty zůstanou beze změny
+		 *
+		 * @param inputs soubory a adresáře
+		 * @return std::vector<std::string> soubory
+		 */
+		static std::vector<std::string> ExpandInputs(const std::vector<std::string> & inputs);
+	private:
+		/// @brief Kapacita fronty mezi vláknem souboru a sléváním
+		static constexpr std::uint32_t QueueCapacity = 4096;
+
+		/// @brief Kolik dalších souborů se čte s předstihem před sléváním
+		static constexpr std::size_t ReadAheadFiles = 4;
+
+		/**
+		 * @brief Jeden vstupní soubor
+		 */
+		struct Input
+		{
+			Input(const std::string & file, StatsBlock & stats) : file(file), stats(stats), queue(QueueCapacity)
+			{
+			}
+
+			const std::string file;
+			StatsBlock & stats;               ///< Statistiky vlákna souboru
+			std::unique_ptr<Reader> reader;   ///< Otevřený soubor (vlákno ho po přečtení zavře)
+			Packet first {};                  ///< První paket (přečtený konstruktorem, data jsou v `reader`)
+			timeval firstTs {};               ///< Čas prvního paketu
+			std::size_t order {};             ///< Pořadí v `_inputs` (rozhoduje při shodném čase)
+			SpscQueue<InputPacket> queue;     ///< Vlákno souboru -> slévání
+			std::atomic<bool> done {false};   ///< Vlákno přečetlo celý soubor
+			std::thread thread;
+			InputPacket head {};              ///< Nejstarší paket souboru, který ještě nebyl vrácen
+		};
+
+		/// @brief Kolik paketů vlákno souboru parsuje najednou
+		const std::uint32_t _burstSize;
+
+		/// @brief Parsovací funkce
+		const ParseFunction _parse;
+
+		/// @brief Časový rozsah
+		const ReadRange _range;
+
+		/// @brief BPF filtr
+		const std::shared_ptr<const BpfFilter> _filter;
+
+		/// @brief Neprázdné soubory seřazené podle času prvního paketu
+		std::vector<std::unique_ptr<Input>> _inputs;
+
+		/// @brief Index prvního souboru v `_inputs`, který ještě není ve slévání
+		std::size_t _nextInput = 0;
+
+		/// @brief Index prvního souboru v `_inputs`, jehož vlákno ještě neběží
+		std::size_t _nextStart = 0;
+
+		/// @brief Některý soubor se nepodařilo otevřít
+		bool _failed = false;
+
+		/// @brief Min-halda spuštěných souborů podle času `head`
+		std::vector<Input *> _heap;
+
+		/// @brief Ukončení vláken (destruktor)
+		std::atomic<bool> _stop {false};
+
+		/**
+		 * @brief Spustí vlákna souborů do `_nextInput + ReadAheadFiles`
+		 */
+		void StartReadAhead();
+
+		/**
+		 * @brief Zařadí soubor do `_heap` (vlákno už musí běžet)
+		 *
+		 * @param input soubor
+		 */
+		void Activate(Input & input);
+
+		/**
+		 * @brief Načte do `input.head` další paket souboru; čeká, dokud ho vlákno nepřipraví
+		 *
+		 * @param input soubor
+		 * @return true paket byl načten
+		 * @return false soubor je přečtený
+		 */
+		bool FetchHead(Input & input);
+
+		/**
+		 * @brief Tělo vlákna souboru - čte a parsuje pakety po dávkách a vkládá je do fronty
+		 *
+		 * @param input soubor
+		 */
+		void ReadFile(Input & input);
+	};
+} // namespace Netflow
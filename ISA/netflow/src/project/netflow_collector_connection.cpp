@@ -6,8 +6,13 @@
 
 #include "netflow_collector_connection.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
 #include <netdb.h>
 #include <netinet/in.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 //#define _loggerDebug
@@ -15,17 +20,33 @@
 
 namespace Netflow
 {
-	CollectorConnection::CollectorConnection(const std::string & collectorIp, std::uint32_t port)
+	CollectorConnection::CollectorConnection(const std::string & collectorIp, std::uint32_t port, const BatchConfig & batch,
+			const PacingConfig & pacing)
+		: _batch(batch)
 	{
+		_batchData.reserve(_batch.maxBytes);
+		// dávka se odešle nejpozději při dosažení maxDatagrams zpráv
+		_iovecs.resize(std::max<std::uint32_t>(_batch.maxDatagrams, 1));
+		_msgs.resize(_iovecs.size());
 		Logger::LogInfo<>("Initializing UDP socket: " + collectorIp + ":" + std::to_string(port));
 		_initialized = InitConnection(collectorIp.c_str(), std::to_string(port).c_str());
 		if (!_initialized) {
 			Logger::LogError<>("Couldn't initialize socket");
+			return;
+		}
+
+		if (pacing.sndBufBytes > 0) {
+			SetSendBuffer(pacing.sndBufBytes);
+		}
+		if (pacing.maxDatagramsPerSec > 0) {
+			const std::uint32_t burst = pacing.burst > 0 ? pacing.burst : std::max<std::uint32_t>(pacing.maxDatagramsPerSec / 100, 1);
+			_pacer = std::make_unique<TokenBucket>(pacing.maxDatagramsPerSec, burst);
 		}
 	}
 
 	CollectorConnection::~CollectorConnection()
 	{
+		Flush();
 		close(_sockfd);
 	}
 
@@ -52,7 +73,7 @@ namespace Netflow
 		for (addrinfo *p = result; p != nullptr; p = p->ai_next) {
 			_sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
 			if (_sockfd != -1) {
-				_collectorAddr = *p->ai_addr;
+				std::memcpy(&_collectorAddr, p->ai_addr, p->ai_addrlen);
 				_collectorAddrLen = p->ai_addrlen;
 
 				Logger::LogInfo<>("Created socket.");
@@ -64,18 +85,128 @@ namespace Netflow
 		return _sockfd != -1;
 	}
 
+	void CollectorConnection::SetSendBuffer(std::uint32_t bytes)
+	{
+		const int requested = static_cast<int>(std::min<std::uint32_t>(bytes, INT_MAX / 2));
+		setsockopt(_sockfd, SOL_SOCKET, SO_SNDBUF, &requested, sizeof(requested));
+
+		// jádro vrací dvojnásobek (režie); nad net.core.wmem_max ho omezí - to obejde jen SO_SNDBUFFORCE (CAP_NET_ADMIN)
+		int actual = 0;
+		socklen_t len = sizeof(actual);
+		getsockopt(_sockfd, SOL_SOCKET, SO_SNDBUF, &actual, &len);
+		if (actual / 2 < requested) {
+			setsockopt(_sockfd, SOL_SOCKET, SO_SNDBUFFORCE, &requested, sizeof(requested));
+			getsockopt(_sockfd, SOL_SOCKET, SO_SNDBUF, &actual, &len);
+		}
+		if (actual / 2 < requested) {
+			Logger::LogWarning<>("Send buffer limited to " + std::to_string(actual / 2) + " bytes (net.core.wmem_max)");
+		}
+		else {
+			LOG_DEBUG("Send buffer " + std::to_string(actual / 2) + " bytes");
+		}
+	}
+
 	bool CollectorConnection::Send(const std::uint8_t * data, int len) const
 	{
 		if (!_initialized) {
 			return false;
 		}
 
-		int sent = sendto(_sockfd, data, len, 0, &_collectorAddr, _collectorAddrLen);
-		Logger::LogDebug<>("Sent data");
+		int sent = sendto(_sockfd, data, len, 0, reinterpret_cast<const sockaddr *>(&_collectorAddr), _collectorAddrLen);
+		LOG_DEBUG("Sent data");
 		if (sent == -1) {
 			Logger::LogWarning<>("Failed sending " + std::to_string(len) + " bytes of data.");
 		}
 
 		return sent != -1;
 	}
+
+	bool CollectorConnection::Queue(const std::uint8_t * data, int len)
+	{
+		if (!_initialized) {
+			return false;
+		}
+
+		if (!_batchMessages.empty() && _batchData.size() + len > _batch.maxBytes) {
+			// zpráva by se do dávky nevešla
+			Flush();
+		}
+		if (_batchMessages.empty()) {
+			_batchStart = std::chrono::steady_clock::now();
+		}
+
+		_batchMessages.emplace_back(_batchData.size(), len);
+		_batchData.insert(_batchData.end(), data, data + len);
+
+		if (_batchMessages.size() >= _batch.maxDatagrams || _batchData.size() >= _batch.maxBytes) {
+			Flush();
+		}
+		return true;
+	}
+
+	void CollectorConnection::FlushIfDue()
+	{
+		if (_batchMessages.empty()) {
+			return;
+		}
+		if (std::chrono::steady_clock::now() - _batchStart >= std::chrono::milliseconds(_batch.maxDelayMs)) {
+			Flush();
+		}
+	}
+
+	void CollectorConnection::Flush()
+	{
+		if (_batchMessages.empty()) {
+			return;
+		}
+
+		const std::size_t n = _batchMessages.size();
+		for (std::size_t i = 0; i < n; i++) {
+			_iovecs[i].iov_base = _batchData.data() + _batchMessages[i].first;
+			_iovecs[i].iov_len = _batchMessages[i].second;
+
+			_msgs[i] = mmsghdr {};
+			_msgs[i].msg_hdr.msg_name = &_collectorAddr;
+			_msgs[i].msg_hdr.msg_namelen = _collectorAddrLen;
+			_msgs[i].msg_hdr.msg_iov = &_iovecs[i];
+			_msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		std::uint64_t sentDatagrams = 0;
+		std::uint64_t sentBytes = 0;
+		std::uint64_t failed = 0;
+		std::size_t offset = 0;
+		while (offset < n) {
+			// s omezením rychlosti posíláme jen tolik, kolik je tokenů
+			const std::size_t count = _pacer ? _pacer->Acquire(n - offset) : n - offset;
+			const int sent = sendmmsg(_sockfd, _msgs.data() + offset, count, 0);
+			if (sent <= 0) {
+				// chyba se týká první neodeslané zprávy; přeskočíme ji a pokračujeme
+				failed++;
+				offset++;
+				continue;
+			}
+			for (int i = 0; i < sent; i++) {
+				sentBytes += _msgs[offset + i].msg_len;
+			}
+			sentDatagrams += sent;
+			offset += sent;
+		}
+
+		_stats.batches++;
+		_stats.datagrams += sentDatagrams;
+		_stats.bytes += sentBytes;
+		_stats.failed += failed;
+		if (_pacer) {
+			_stats.pacedUs = _pacer->WaitedUs();
+		}
+
+		LOG_DEBUG("Sent batch: " + std::to_string(sentDatagrams) + " datagrams, " + std::to_string(sentBytes) + " bytes");
+		if (failed > 0) {
+			Logger::LogWarning<>("Failed sending " + std::to_string(failed) + " of " + std::to_string(n) + " datagrams in batch.");
+		}
+
+		_batchMessages.clear();
+		_batchData.clear();
+	}
 } // namespace Netflow
@@ -6,14 +6,74 @@
 
 #pragma once
 
+#include "token_bucket.h"
+
 #include <cstdint>
 #include <string>
 #include <array>
+#include <vector>
+#include <chrono>
+#include <memory>
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 namespace Netflow
 {
+	/**
+	 * @brief Prahy pro odeslání dávky datagramů. Dávka se odešle při dosažení kteréhokoliv z nich.
+	 */
+	struct BatchConfig
+	{
+		std::uint32_t maxDatagrams {32};    ///< Počet datagramů v dávce (1 = odeslat ihned)
+		std::uint32_t maxBytes {256 * 1024}; ///< Součet velikostí datagramů v dávce
+		std::uint32_t maxDelayMs {100};      ///< Nejdelší doba (reálný čas), po kterou může datagram čekat ve frontě
+	};
+
+	/**
+	 * @brief Omezení rychlosti odesílání na kolektor
+	 */
+	struct PacingConfig
+	{
+		std::uint32_t maxDatagramsPerSec {0}; ///< Strop datagramů za sekundu (0 = bez omezení)
+		std::uint32_t burst {0};              ///< Kolik datagramů smí odejít najednou (0 = 10 ms provozu)
+		std::uint32_t sndBufBytes {0};        ///< Velikost SO_SNDBUF (0 = výchozí systému)
+	};
+
+	/**
+	 * @brief Adresa kolektoru
+	 */
+	struct CollectorEndpoint
+	{
+		std::string host; ///< IP adresa nebo hostname
+		std::uint32_t port;
+	};
+
+	/**
+	 * @brief Statistiky odesílání
+	 */
+	struct SendStats
+	{
+		std::uint64_t batches {};   ///< Počet odeslaných dávek (volání sendmmsg/sendto)
+		std::uint64_t datagrams {}; ///< Počet úspěšně odeslaných datagramů
+		std::uint64_t bytes {};     ///< Počet úspěšně odeslaných bytů
+		std::uint64_t failed {};    ///< Počet datagramů, které se nepodařilo odeslat
+		std::uint64_t pacedUs {};   ///< Doba čekání na omezení rychlosti (µs)
+
+		/**
+		 * @brief Přičte statistiky jiného kolektoru
+		 */
+		SendStats & operator+=(const SendStats & other)
+		{
+			batches += other.batches;
+			datagrams += other.datagrams;
+			bytes += other.bytes;
+			failed += other.failed;
+			pacedUs += other.pacedUs;
+			return *this;
+		}
+	};
+
 	/**
 	 * @brief Třída sloužící pro vytvoření soketu na kolektor. Komunikace probíhá přes UPD.
 	 */
@@ -25,8 +85,11 @@ namespace Netflow
 		 * 
 		 * @param collectorIp Ip kolektoru
 		 * @param port Port kolektoru
+		 * @param batch prahy pro dávkové odesílání (Queue())
+		 * @param pacing omezení rychlosti odesílání a velikost bufferu soketu
 		 */
-		CollectorConnection(const std::string & collectorIp, std::uint32_t port);
+		CollectorConnection(const std::string & collectorIp, std::uint32_t port, const BatchConfig & batch = BatchConfig {},
+			const PacingConfig & pacing = PacingConfig {});
 
 		/**
 		 * @brief Destruktor - uzavření soketu
@@ -43,6 +106,36 @@ namespace Netflow
 		 */
 		bool Send(const std::uint8_t * data, int len) const;
 
+		/**
+		 * @brief Zkopíruje zprávu do dávky. Dávka se odešle (sendmmsg), pokud dosáhne počtu datagramů nebo velikosti z BatchConfig.
+		 * 
+		 * @param data data zprávy
+		 * @param len délka zprávy
+		 * @return true zpráva byla zařazena
+		 * @return false soket není inicializovaný
+		 */
+		bool Queue(const std::uint8_t * data, int len);
+
+		/**
+		 * @brief Odešle dávku, pokud nejstarší zpráva v ní čeká déle než `BatchConfig::maxDelayMs`
+		 */
+		void FlushIfDue();
+
+		/**
+		 * @brief Odešle všechny zprávy v dávce (při omezení rychlosti čeká na tokeny)
+		 */
+		void Flush();
+
+		/**
+		 * @brief Vrátí statistiky odesílání
+		 * 
+		 * @return const SendStats& statistiky
+		 */
+		const SendStats & GetStats() const
+		{
+			return _stats;
+		}
+
 		/**
 		 * @brief Jestli proběhla inicializace v pořádku
 		 * 
@@ -57,10 +150,32 @@ namespace Netflow
 		/// @brief Inicializační flag
 		bool _initialized;
 
-		/// @brief Adresa kolektoru
-		sockaddr _collectorAddr;
+		/// @brief Adresa kolektoru (sockaddr_storage - pojme i IPv6 adresu)
+		sockaddr_storage _collectorAddr;
 		socklen_t _collectorAddrLen;
 
+		/// @brief Prahy dávky
+		const BatchConfig _batch;
+
+		/// @brief Data zpráv v dávce (za sebou)
+		std::vector<std::uint8_t> _batchData;
+
+		/// @brief Začátek a délka jednotlivých zpráv v `_batchData`
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> _batchMessages;
+
+		/// @brief Popisy zpráv pro sendmmsg (alokované jednou na `_batch.maxDatagrams` zpráv)
+		std::vector<iovec> _iovecs;
+		std::vector<mmsghdr> _msgs;
+
+		/// @brief Kdy byla do prázdné dávky vložena první zpráva
+		std::chrono::steady_clock::time_point _batchStart;
+
+		/// @brief Statistiky odesílání
+		SendStats _stats;
+
+		/// @brief Omezení rychlosti (nullptr = bez omezení)
+		std::unique_ptr<TokenBucket> _pacer;
+
 		/**
 		 * @brief Inicializace socketu
 		 * 
@@ -70,5 +185,12 @@ namespace Netflow
 		 * @return false chyba při inicializaci
 		 */
 		bool InitConnection(const char * collectorIp, const char * collectorPort);
+
+		/**
+		 * @brief Nastaví velikost bufferu soketu (SO_SNDBUF, nad limitem systému SO_SNDBUFFORCE)
+		 * 
+		 * @param bytes požadovaná velikost
+		 */
+		void SetSendBuffer(std::uint32_t bytes);
 	};
 } // namespace Netflow
@@ -8,13 +8,75 @@
 
 #include <cstdint>
 #include <array>
-#include <netinet/in.h>
 
 namespace
 {
-	/// Nekoukat. Serializace 2 a 4 bytů. Spoleháme na optimalizaci překladačem
-	#define S2B(v) static_cast<uint8_t>(htons(v)), static_cast<uint8_t>(htons(v) >> 8)
-	#define S4B(v) static_cast<uint8_t>(htonl(v)), static_cast<uint8_t>(htonl(v) >> 8), static_cast<uint8_t>(htonl(v) >> 16), static_cast<uint8_t>(htonl(v) >> 24)
+	/**
+	 * @brief Zapíše 2 byty v síťovém pořadí a posune ukazatel
+	 * 
+	 * @param out výstup
+	 * @param v hodnota
+	 */
+	inline void Put16(uint8_t *& out, uint16_t v)
+	{
+		out[0] = static_cast<uint8_t>(v >> 8);
+		out[1] = static_cast<uint8_t>(v);
+		out += 2;
+	}
+
+	/**
+	 * @brief Zapíše 4 byty v síťovém pořadí a posune ukazatel
+	 * 
+	 * @param out výstup
+	 * @param v hodnota
+	 */
+	inline void Put32(uint8_t *& out, uint32_t v)
+	{
+		out[0] = static_cast<uint8_t>(v >> 24);
+		out[1] = static_cast<uint8_t>(v >> 16);
+		out[2] = static_cast<uint8_t>(v >> 8);
+		out[3] = static_cast<uint8_t>(v);
+		out += 4;
+	}
+
+	/**
+	 * @brief Zapíše 8 bytů v síťovém pořadí a posune ukazatel
+	 * 
+	 * @param out výstup
+	 * @param v hodnota
+	 */
+	inline void Put64(uint8_t *& out, uint64_t v)
+	{
+		Put32(out, static_cast<uint32_t>(v >> 32));
+		Put32(out, static_cast<uint32_t>(v));
+	}
+
+	/**
+	 * @brief Přečte 2 byty v síťovém pořadí a posune ukazatel
+	 * 
+	 * @param in vstup
+	 * @return uint16_t hodnota
+	 */
+	inline uint16_t Get16(const uint8_t *& in)
+	{
+		const uint16_t v = (static_cast<uint16_t>(in[0]) << 8) | in[1];
+		in += 2;
+		return v;
+	}
+
+	/**
+	 * @brief Přečte 4 byty v síťovém pořadí a posune ukazatel
+	 * 
+	 * @param in vstup
+	 * @return uint32_t hodnota
+	 */
+	inline uint32_t Get32(const uint8_t *& in)
+	{
+		const uint32_t v = (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16)
+			| (static_cast<uint32_t>(in[2]) << 8) | in[3];
+		in += 4;
+		return v;
+	}
 } // namespace
 
 
@@ -28,6 +90,12 @@ namespace Netflow
 	/// @brief Velikost netflow záznamu
 	constexpr uint32_t NetflowV5RecordSize = 48;
 
+	/// @brief Maximální počet záznamů v jednom datagramu
+	constexpr uint32_t NetflowV5MaxRecords = 30;
+
+	/// @brief Maximální velikost datagramu
+	constexpr uint32_t NetflowV5MaxDatagramSize = NetflowV5HeaderSize + NetflowV5MaxRecords * NetflowV5RecordSize;
+
 	/**
 	 * @brief Netflow V5 hlavička
 	 */
@@ -59,19 +127,51 @@ namespace Netflow
 		 * @return std::array<uint8_t, NetflowV5HeaderSize> serializace této struktury
 		 */
 		std::array<uint8_t, NetflowV5HeaderSize> Serialize() const
+		{
+			std::array<uint8_t, NetflowV5HeaderSize> out;
+			SerializeTo(out.data());
+			return out;
+		}
+
+		/**
+		 * @brief Serializace této struktury přímo do bufferu
+		 * 
+		 * @param out buffer (alespoň NetflowV5HeaderSize bytů)
+		 * @return uint8_t* ukazatel za zapsaná data
+		 */
+		uint8_t * SerializeTo(uint8_t * out) const
 		{
 			// Zarovnání není zaručené, musíme ručně
-			return {
-				S2B(version),
-				S2B(count),
-				S4B(sysUptime),
-				S4B(unixSecs),
-				S4B(unixNsecs),
-				S4B(flowSequence),
-				engineType,
-				engineId,
-				S2B(samplingInterval)
-			};
+			Put16(out, version);
+			Put16(out, count);
+			Put32(out, sysUptime);
+			Put32(out, unixSecs);
+			Put32(out, unixNsecs);
+			Put32(out, flowSequence);
+			*out++ = engineType;
+			*out++ = engineId;
+			Put16(out, samplingInterval);
+			return out;
+		}
+
+		/**
+		 * @brief Opak SerializeTo() - naplní strukturu z bufferu. Verzi (konstantní) musí zkontrolovat volající.
+		 * 
+		 * @param in buffer (alespoň NetflowV5HeaderSize bytů)
+		 * @return const uint8_t* ukazatel za přečtená data
+		 */
+		const uint8_t * DeserializeFrom(const uint8_t * in)
+		{
+			in += 2; // version
+			count = Get16(in);
+			sysUptime = Get32(in);
+			unixSecs = Get32(in);
+			unixNsecs = Get32(in);
+			flowSequence = Get32(in);
+			engineType = *in++;
+			engineId = *in++;
+			samplingInterval = Get16(in);
+			return in;
 		}
 	};
 
@@ -117,30 +217,73 @@ namespace Netflow
 		 * @return std::array<uint8_t, NetflowV5RecordSize> serializace této struktury
 		 */
 		std::array<uint8_t, NetflowV5RecordSize> Serialize() const
+		{
+			std::array<uint8_t, NetflowV5RecordSize> out;
+			SerializeTo(out.data());
+			return out;
+		}
+
+		/**
+		 * @brief Serializace této struktury přímo do bufferu
+		 * 
+		 * @param out buffer (alespoň NetflowV5RecordSize bytů)
+		 * @return uint8_t* ukazatel za zapsaná data
+		 */
+		uint8_t * SerializeTo(uint8_t * out) const
 		{
 			// Zarovnání není zaručené, musíme ručně
-			return {
-				S4B(srcAddr),
-				S4B(dstAddr),
-				S4B(nextHop),
-				S2B(input),
-				S2B(output),
-				S4B(dPkts),
-				S4B(dOctets),
-				S4B(first),
-				S4B(last),
-				S2B(srcPort),
-				S2B(dstPort),
-				pad1,
-				tcpFlags,
-				prot,
-				tos,
-				S2B(srcAs),
-				S2B(dstAs),
-				srcMask,
-				dstMask,
-				S2B(pad2)
-			};
+			Put32(out, srcAddr);
+			Put32(out, dstAddr);
+			Put32(out, nextHop);
+			Put16(out, input);
+			Put16(out, output);
+			Put32(out, dPkts);
+			Put32(out, dOctets);
+			Put32(out, first);
+			Put32(out, last);
+			Put16(out, srcPort);
+			Put16(out, dstPort);
+			*out++ = pad1;
+			*out++ = tcpFlags;
+			*out++ = prot;
+			*out++ = tos;
+			Put16(out, srcAs);
+			Put16(out, dstAs);
+			*out++ = srcMask;
+			*out++ = dstMask;
+			Put16(out, pad2);
+			return out;
+		}
+
+		/**
+		 * @brief Opak SerializeTo() - naplní strukturu z bufferu
+		 * 
+		 * @param in buffer (alespoň NetflowV5RecordSize bytů)
+		 * @return const uint8_t* ukazatel za přečtená data
+		 */
+		const uint8_t * DeserializeFrom(const uint8_t * in)
+		{
+			srcAddr = Get32(in);
+			dstAddr = Get32(in);
+			nextHop = Get32(in);
+			input = Get16(in);
+			output = Get16(in);
+			dPkts = Get32(in);
+			dOctets = Get32(in);
+			first = Get32(in);
+			last = Get32(in);
+			srcPort = Get16(in);
+			dstPort = Get16(in);
+			pad1 = *in++;
+			tcpFlags = *in++;
+			prot = *in++;
+			tos = *in++;
+			srcAs = Get16(in);
+			dstAs = Get16(in);
+			srcMask = *in++;
+			dstMask = *in++;
+			pad2 = Get16(in);
+			return in;
 		}
 	};
 } // namespace Netflow
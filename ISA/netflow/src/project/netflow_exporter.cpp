@@ -5,91 +5,780 @@
  */
 
 #include "netflow_exporter.h"
+#include "flow_archive.h"
 
-#include <chrono>
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <unordered_map>
 
 //#define _loggerDebug
 #include "logger/logger.hpp"
 
-namespace Netflow
+namespace
 {
-	bool FlowRecord::PacketEq(const ParsedPacket & pkt) const
+	/// @brief Požadavek na ukončení s checkpointem (nastavuje NetflowExporter::RequestCheckpoint())
+	volatile std::sig_atomic_t checkpointRequested = 0;
+
+	/// @brief Kapacita front mezi vlákny
+	constexpr std::uint32_t ShardQueueCapacity = 1 << 14;
+
+	/// @brief Velikost IP (IPv6 - horší případ) a UDP hlavičky, o kterou je IPFIX zpráva menší než MTU
+	constexpr std::uint32_t IpUdpOverhead = 48;
+
+	/// @brief Jak dlouho (ms času zachycení) mohou záznamy čekat na zaplnění IPFIX zprávy
+	constexpr std::uint64_t IpfixMaxHoldMs = 1000;
+
+	/// @brief Po kolika zprávách se znovu posílají šablony (UDP - kolektor je mohl ztratit, RFC 7011, 8.4)
+	constexpr std::uint64_t IpfixTemplateRefresh = 20;
+
+	/**
+	 * @brief Zpráva čtecího vlákna pro shard: paket nebo pouze posun času (aby expirovaly i shardy bez provozu)
+	 */
+	struct ShardMessage
+	{
+		Netflow::FlowPacket pkt;
+		bool tick;
+	};
+
+	/**
+	 * @brief Záznam připravený k exportu spolu s časem shardu, ve kterém vznikl
+	 */
+	struct ExpiredFlow
+	{
+		Netflow::FlowRecord record;
+		timeval ts;
+	};
+
+	/**
+	 * @brief Shard - vlastní flow-cache jednoho pracovního vlákna a fronty z/do něj
+	 */
+	struct Shard
+	{
+		Shard(std::uint32_t activeTimer, std::uint32_t interval, std::uint32_t flowCacheSize, std::uint32_t timerGranularity,
+				std::uint32_t tcpCloseGrace, Netflow::StatsBlock & stats)
+			: stats(stats), cache(activeTimer, interval, flowCacheSize, timerGranularity, &stats, tcpCloseGrace), in(ShardQueueCapacity),
+			out(ShardQueueCapacity)
+		{
+		}
+
+		Netflow::StatsBlock & stats;          ///< Statistiky pracovního vlákna
+		Netflow::FlowCache cache;
+		Netflow::SpscQueue<ShardMessage> in;  ///< Čtecí vlákno -> shard
+		Netflow::SpscQueue<ExpiredFlow> out;  ///< Shard -> serializátor
+		std::atomic<bool> done {false};       ///< Shard zpracoval vše a vyprázdnil cache
+	};
+
+	/**
+	 * @brief Část souboru zpracovávaná jedním vláknem (viz NetflowExporter::LoopSliced())
+	 */
+	struct Slice
 	{
-		return srcAddr == pkt.ipv4h->SrcAddr()
-			&& dstAddr == pkt.ipv4h->DstAddr()
-			&& prot == pkt.ipv4h->prot
-			&& tos == pkt.ipv4h->Dscp()
-			&& srcPort == pkt.tcph->SrcPort()
-			&& dstPort == pkt.tcph->DstPort();
+		Slice(const Netflow::ReadRange & range, std::uint32_t activeTimer, std::uint32_t interval, std::uint32_t flowCacheSize,
+				std::uint32_t timerGranularity, std::uint32_t tcpCloseGrace, Netflow::StatsBlock & stats, const Netflow::PacketSampler & sampler)
+			: range(range), stats(stats), cache(activeTimer, interval, flowCacheSize, timerGranularity, &stats, tcpCloseGrace), sampler(sampler),
+			out(ShardQueueCapacity)
+		{
+		}
+
+		const Netflow::ReadRange range;
+		Netflow::StatsBlock & stats;            ///< Statistiky vlákna části
+		Netflow::FlowCache cache;
+		Netflow::PacketSampler sampler;         ///< Vlastní kopie - deterministické vzorkování počítá pakety
+		Netflow::SpscQueue<ExpiredFlow> out;    ///< Záznamy, které nemohou pokračovat flow z předchozí části -> serializátor
+		std::vector<Netflow::FlowRecord> head;  ///< Záznamy vzniklé do `interval` od začátku části (mohou pokračovat flow z předchozí)
+		std::vector<Netflow::FlowRecord> tail;  ///< Záznamy otevřené na konci části (mohou pokračovat v následující)
+		timeval startTs {};                     ///< Čas prvního paketu části
+		std::atomic<bool> done {false};         ///< Vlákno zpracovalo celou část
+	};
+
+	/**
+	 * @brief Hash klíče pro std::unordered_map
+	 */
+	struct FlowKeyHash
+	{
+		std::size_t operator()(const Netflow::FlowKey & key) const
+		{
+			return key.Hash();
+		}
+	};
+
+	/**
+	 * @brief Rozdělí soubor podle indexu na `n` částí s přibližně stejným počtem paketů
+	 *
+	 * @return std::vector<Netflow::ReadRange> části; prázdné, pokud soubor nelze rozdělit
+	 */
+	std::vector<Netflow::ReadRange> SliceByIndex(const std::string & file, const Netflow::ReadRange & range, std::uint32_t n)
+	{
+		const auto index = Netflow::PcapIndex::Load(file);
+		if (!index) {
+			Logger::LogWarning<>("Splitting " + file + " needs an index (--index), processing it in one piece");
+			return {};
+		}
+
+		const auto & entries = index->Entries();
+		const std::size_t lo = index->EntryFor(range.fromUs);
+		const std::size_t hi = std::max(index->EndEntryFor(range.toUs), lo + 1);
+		n = std::min<std::size_t>(n, hi - lo);
+		if (n <= 1) {
+			return {};
+		}
+
+		std::vector<Netflow::ReadRange> slices;
+		for (std::uint32_t i = 0; i < n; i++) {
+			Netflow::ReadRange slice = range;
+			slice.startOffset = entries[lo + (hi - lo) * i / n].offset;
+			// poslední část končí podle času (`toUs`)
+			slice.endOffset = i + 1 < n ? entries[lo + (hi - lo) * (i + 1) / n].offset : Netflow::ReadRange::NoLimit;
+			slices.push_back(slice);
+		}
+		return slices;
 	}
 
-	NetflowExporter::NetflowExporter(const std::string & file, const std::string & collectorIp, std::uint32_t collectorPort,
-			std::uint32_t activeTimer, std::uint32_t interval, std::uint32_t flowCacheSize)
-		: _reader(file), _collectorIp(collectorIp), _collectorPort(collectorPort), _activeTimer(activeTimer), _interval(interval),
-		_flowCacheSize(flowCacheSize), _collector(collectorIp, collectorPort)
+	/**
+	 * @brief Vloží položku do fronty; pokud je plná, čeká
+	 */
+	template <typename T>
+	void BlockingPush(Netflow::SpscQueue<T> & queue, const T & item)
 	{
-		_toExport.reserve(30);
-		_flows.reserve(flowCacheSize);
+		while (!queue.TryPush(item)) {
+			std::this_thread::yield();
+		}
 	}
 
-	void NetflowExporter::Run()
+	/**
+	 * @brief Převede flow záznam (IPv4) na Netflow v5 záznam
+	 */
+	Netflow::NetflowV5FlowRecord ToV5Record(const Netflow::FlowRecord & record)
 	{
-		Loop();
+		Netflow::NetflowV5FlowRecord r {};
+		r.srcAddr = record.key.SrcAddrV4();
+		r.dstAddr = record.key.DstAddrV4();
+		r.dPkts = record.dPkts;
+		r.dOctets = record.dOctets;
+		r.first = record.FirstSec();
+		r.last = record.LastSec();
+		r.srcPort = record.key.srcPort;
+		r.dstPort = record.key.dstPort;
+		r.tcpFlags = record.tcpFlags;
+		r.prot = record.key.prot;
+		r.tos = record.key.tos;
+		return r;
 	}
+} // namespace
 
-	void NetflowExporter::Loop()
+namespace Netflow
+{
+	NetflowExporter::NetflowExporter(const std::vector<std::string> & files, const std::vector<CollectorEndpoint> & collectors,
+			const ExporterConfig & config, const BatchConfig & batch, const ExportConfig & exportConfig,
+			const SamplingConfig & sampling, const StatsConfig & statsConfig, const InputConfig & inputConfig,
+			const AggregationConfig & aggregation)
+		: _activeTimer(config.activeTimer), _interval(config.interval),
+		_flowCacheSize(config.flowCacheSize), _timerGranularity(config.timerGranularity), _tcpCloseGrace(config.tcpCloseGrace),
+		_nThreads(std::max<std::uint32_t>(config.threads, 1)),
+		_burstSize(std::clamp<std::uint32_t>(config.burstSize, 1, MaxBurstSize)),
+		_format(exportConfig.format),
+		_ipfixMessageSize(std::clamp<std::uint32_t>(exportConfig.mtu - std::min(exportConfig.mtu, IpUdpOverhead),
+			IpfixMinMessageSize, IpfixMaxMessageSize)),
+		_sampler(sampling), _stats(statsConfig), _filter(inputConfig.filter),
+		_checkpointPath(inputConfig.checkpointPath),
+		_datagram(_format == ExportFormat::Ipfix ? _ipfixMessageSize : NetflowV5MaxDatagramSize)
 	{
-		if (!_collector.IsInitialized()) {
-			return;
+		if (_format == ExportFormat::Archive) {
+			_sink = std::make_unique<FlowArchiveWriter>(exportConfig.archivePath);
+		}
+		else {
+			std::vector<std::string> names;
+			for (const auto & endpoint : collectors) {
+				ExportStream stream;
+				stream.collector = std::make_unique<CollectorConnection>(endpoint.host, endpoint.port, batch, exportConfig.pacing);
+				_streams.push_back(std::move(stream));
+				names.push_back(endpoint.host + ":" + std::to_string(endpoint.port));
+			}
+			if (_streams.size() > 1) {
+				_ring = std::make_unique<HashRing>(names);
+				Logger::LogInfo<>("Distributing flows across " + std::to_string(_streams.size()) + " collectors");
+			}
+		}
+		if (aggregation.enabled) {
+			_aggregator = std::make_unique<FlowAggregator>(aggregation, _flowCacheSize, _timerGranularity);
+		}
+
+		// více souborů čteme paralelně a sléváme; jeden soubor (nebo stdin) přímo
+		const auto inputs = MultiFileReader::ExpandInputs(files);
+		ReadRange range;
+		range.fromUs = inputConfig.fromUs;
+		range.toUs = inputConfig.toUs;
+		if (!inputConfig.interface.empty()) {
+			_reader = std::make_unique<Reader>(AfPacketSource::Open(inputConfig.interface, inputConfig.ring, _filter.get()),
+				inputConfig.interface);
+		}
+		else if (inputs.size() == 1) {
+			if (inputConfig.slices > 1) {
+				_slices = SliceByIndex(inputs.front(), range, inputConfig.slices);
+			}
+			if (_slices.empty()) {
+				_reader = std::make_unique<Reader>(inputs.front(), range, _filter);
+			}
+			else {
+				_sliceFile = inputs.front();
+				Logger::LogInfo<>("Processing " + _sliceFile + " in " + std::to_string(_slices.size()) + " slices");
+				if (_nThreads > 1) {
+					Logger::LogWarning<>("Ignoring the thread count, each slice has its own thread");
+				}
+			}
+		}
+		else {
+			if (inputConfig.slices > 1) {
+				Logger::LogWarning<>("Slices are supported only for a single input file");
+			}
+			_multiReader = std::make_unique<MultiFileReader>(inputs, _stats, _burstSize,
+				[this](const std::uint8_t * packet, std::uint32_t caplen, const timeval & ts, StatsBlock & stats, FlowPacket & out) {
+					return ParseFlowPacket(packet, caplen, ts, stats, out);
+				}, range, _filter);
+		}
+
+		if (!_slices.empty() && (!inputConfig.checkpointPath.empty() || !inputConfig.restorePath.empty())) {
+			Logger::LogWarning<>("Checkpoints are not supported with slices, ignoring them");
+		}
+		else if (!inputConfig.restorePath.empty()) {
+			_restore = FlowCheckpoint::Load(inputConfig.restorePath);
+		}
+
+		if (_reader && _reader->IsLive() && inputConfig.maxExportDelayMs > 0) {
+			_flushTimer = std::make_unique<FlushTimer>(inputConfig.maxExportDelayMs);
+			if (!_flushTimer->IsInitialized()) {
+				_flushTimer.reset();
+			}
+		}
+
+		if (_format == ExportFormat::Ipfix && exportConfig.mtu < _ipfixMessageSize + IpUdpOverhead) {
+			Logger::LogWarning<>("MTU " + std::to_string(exportConfig.mtu) + " too small, using IPFIX messages of "
+				+ std::to_string(_ipfixMessageSize) + " bytes");
+		}
+		if (_format == ExportFormat::NetflowV5 && _sampler.Interval() > PacketSampler::MaxV5Interval) {
+			Logger::LogWarning<>("Sampling interval " + std::to_string(_sampler.Interval()) + " doesn't fit into the v5 header, reporting "
+				+ std::to_string(PacketSampler::MaxV5Interval));
+		}
+	}
+
+	bool NetflowExporter::Run()
+	{
+		const bool collectorsReady = !_streams.empty() && std::all_of(_streams.begin(), _streams.end(), [](const ExportStream & stream) {
+			return stream.collector->IsInitialized();
+		});
+		if (_sink ? !_sink->IsInitialized() : !collectorsReady) {
+			return false;
+		}
+		if ((_reader && !_reader->IsOpen()) || (_multiReader && _multiReader->Failed())) {
+			// částečný export by vypadal jako úplný
+			Logger::LogError<>("Couldn't open all inputs, nothing exported");
+			return false;
 		}
 
 		Logger::LogInfo<>("Start");
+		ExporterStats::InstallSignalHandler();
 
-		Packet p = _reader.GetNextPacket();
-		if (p.pktData != nullptr && p.pktHeader != nullptr) {
-			_startTs = p.pktHeader->ts;
+		if (!_slices.empty()) {
+			LoopSliced();
+		}
+		else if (_nThreads > 1) {
+			LoopSharded();
 		}
+		else {
+			Loop();
+		}
+		FlushExports();
+
+		const SendStats stats = CollectorStats();
+		if (_stats.Config().enabled) {
+			_stats.Dump(stats, _flowCacheSize);
+		}
+		if (!_sink) {
+			Logger::LogInfo<>("Sent " + std::to_string(stats.datagrams) + " datagrams (" + std::to_string(stats.bytes) + " bytes) in "
+				+ std::to_string(stats.batches) + " batches, " + std::to_string(stats.failed) + " failed");
+		}
+		if (_stats.CacheBytes() > 0) {
+			const std::uint64_t bytes = _stats.CacheBytes();
+			Logger::LogInfo<>("Flow cache of " + std::to_string(_flowCacheSize) + " flows used " + std::to_string(bytes >> 20) + " MiB ("
+				+ std::to_string(bytes / std::max<std::uint32_t>(_flowCacheSize, 1)) + " bytes per flow, "
+				+ std::to_string((bytes * 1'000'000 / std::max<std::uint32_t>(_flowCacheSize, 1)) >> 20) + " MiB per million flows)");
+		}
+		if (_aggregator) {
+			Logger::LogInfo<>("Aggregated " + std::to_string(_aggregator->FlowsIn()) + " flows into "
+				+ std::to_string(_aggregator->RecordsOut()) + " records");
+		}
+		Logger::LogInfo<>("Finished reading. Exiting...");
+		return true;
+	}
+
+	void NetflowExporter::Loop()
+	{
+		StatsBlock & stats = _stats.AddBlock();
+		FlowCache cache(_activeTimer, _interval, _flowCacheSize, _timerGranularity, &stats, _tcpCloseGrace);
+		RestoreCheckpoint({&cache});
+		std::vector<InputPacket> input(_burstSize);
+		std::vector<FlowPacket> burst(_burstSize);
+		bool first = true;
 
-		do {
-			// vyprázdníme záznamy k exportu
-			_toExport.clear();
+		while (true) {
+			// 1. načteme a naparsujeme dávku paketů (FlowPacket neukazuje do dat paketu - libpcap je přepíše dalším čtením)
+			std::uint32_t nRead;
+			bool idle = false;
+			{
+				StageTimer timer(&stats.Latency(Stage::Parse));
+				nRead = ReadBurst(stats, input.data(), idle);
+			}
+			if (nRead == 0) {
+				if (!idle) {
+					break;
+				}
+				if (!first) {
+					FlushIdle(cache);
+				}
+				continue;
+			}
+			if (first) {
+				// po obnovení z checkpointu pokračuje čas startu předchozího běhu
+				if (!timerisset(&_startTs)) {
+					_startTs = input[0].pkt.ts;
+				}
+				first = false;
+			}
+			_currentTime = input[nRead - 1].pkt.ts;
+
+			{
+				StageTimer timer(&stats.Latency(Stage::Cache));
 
-			_currentTime = p.pktHeader->ts;
-			auto parsed = ParsePacket(p.pktData);
-			parsed.size = p.pktHeader->len;
+				// 2. exportujeme záznamy, kterým vypršel timer před začátkem dávky
+				cache.ExpireFlows(input[0].pkt.ts);
 
-			if (parsed.eth && parsed.ipVersion == IpVersion::Ipv4) {
-				// netflow v5 podporuje pouze ipv4
-				AddNewRecord(parsed);
+				// 3. přednačteme položky tabulky pro celou dávku a pak teprve aktualizujeme záznamy
+				std::uint32_t nAccepted = 0;
+				for (std::uint32_t i = 0; i < nRead; i++) {
+					if (input[i].parsed) {
+						burst[nAccepted++] = input[i].pkt;
+					}
+				}
+				cache.Prefetch(burst.data(), nAccepted);
+				for (std::uint32_t i = 0; i < nAccepted; i++) {
+					cache.AddNewRecord(burst[i]);
+					// zkontrolujeme, jestli nemáme uloženo příliš záznamů
+					cache.EvictIfFull();
+				}
 			}
 
-			// zkontrolujeme, jestli nemáme uloženo příliš záznamů
-			if (_flows.size() >= _flowCacheSize) {
-				// exportujeme první záznam
-				SaveFlowExport(_flows[0]);
-				_flows.erase(_flows.begin());
+			// 4. exportujeme to, co je připraveno k exportu
+			if (!cache.Expired().empty()) {
+				StageTimer timer(&stats.Latency(Stage::Export));
+				ExportFlows(cache.Expired());
 			}
+			ExpireAggregates();
+			FlushCollectors(true);
+			_stats.Poll(CollectorStats(), _flowCacheSize);
+		}
 
-			// exportujeme to, co je v `_toExport`
-			ExportFlows();
-			p = _reader.GetNextPacket();
-		} while(p.pktHeader != nullptr && p.pktData != nullptr);
+		if (CheckpointPending()) {
+			SaveCheckpoint({&cache});
+			return;
+		}
 
 		// exportujeme zbývající záznamy
-		for (auto & flow : _flows) {
-			SaveFlowExport(flow);
+		cache.Flush();
+		ExportFlows(cache.Expired());
+	}
+
+	void NetflowExporter::LoopSharded()
+	{
+		// celková velikost cache se dělí mezi shardy
+		const std::uint32_t shardCacheSize = (_flowCacheSize + _nThreads - 1) / _nThreads;
+
+		// bloky statistik vytvoříme před spuštěním vláken
+		StatsBlock & readerStats = _stats.AddBlock();
+		StatsBlock & exportStats = _stats.AddBlock();
+		std::vector<std::unique_ptr<Shard>> shards;
+		for (std::uint32_t i = 0; i < _nThreads; i++) {
+			shards.push_back(std::make_unique<Shard>(_activeTimer, _interval, shardCacheSize, _timerGranularity, _tcpCloseGrace,
+				_stats.AddBlock()));
+		}
+		std::vector<FlowCache *> caches;
+		for (auto & shard : shards) {
+			caches.push_back(&shard->cache);
 		}
-		ExportFlows();
-		_flows.clear();
+		RestoreCheckpoint(caches);
+		std::atomic<bool> readerDone {false};
 
-		Logger::LogInfo<>("Finished reading. Exiting...");
+		// čtení a parsování; pakety se rozdělí podle hashe klíče (stejná flow -> stejný shard)
+		std::thread reader([this, &shards, &readerDone, &stats = readerStats]() {
+			time_t lastTick = 0;
+			bool first = true;
+			std::vector<InputPacket> burst(_burstSize);
+
+			while (true) {
+				// dávku paketů nejdřív naparsujeme, pak rozdělíme mezi shardy
+				std::uint32_t n;
+				bool idle = false;
+				{
+					StageTimer timer(&stats.Latency(Stage::Parse));
+					n = ReadBurst(stats, burst.data(), idle);
+				}
+				if (n == 0) {
+					if (!idle) {
+						break;
+					}
+					if (!first) {
+						// vstup stojí - shardy posuneme na odhad času vstupu, aby vyexpirovaly své záznamy
+						ShardMessage tick {};
+						tick.pkt.ts = IdleTime();
+						tick.tick = true;
+						for (auto & shard : shards) {
+							BlockingPush(shard->in, tick);
+						}
+						lastTick = tick.pkt.ts.tv_sec;
+					}
+					continue;
+				}
+				if (first) {
+					if (!timerisset(&_startTs)) {
+						_startTs = burst[0].pkt.ts;
+					}
+					lastTick = burst[0].pkt.ts.tv_sec;
+					first = false;
+				}
+
+				for (std::uint32_t i = 0; i < n; i++) {
+					// zahozený paket posouvá pouze čas
+					const ShardMessage msg {burst[i].pkt, !burst[i].parsed};
+					if (!msg.tick) {
+						BlockingPush(shards[ShardFor(msg.pkt.key, msg.pkt.hash, shards.size())]->in, msg);
+					}
+
+					if (msg.pkt.ts.tv_sec != lastTick) {
+						// posuneme čas všem shardům
+						ShardMessage tick {};
+						tick.pkt.ts = msg.pkt.ts;
+						tick.tick = true;
+						for (auto & shard : shards) {
+							BlockingPush(shard->in, tick);
+						}
+						lastTick = msg.pkt.ts.tv_sec;
+					}
+				}
+			}
+			readerDone.store(true, std::memory_order_release);
+		});
+
+		// agregace; každé vlákno pracuje pouze se svým shardem
+		std::vector<std::thread> workers;
+		for (auto & shardPtr : shards) {
+			workers.emplace_back([this, &shard = *shardPtr, &readerDone, burstSize = _burstSize]() {
+				timeval now {};
+				std::vector<ShardMessage> burst(burstSize);
+				std::vector<FlowPacket> packets(burstSize);
+				const auto pushExpired = [&shard, &now]() {
+					for (const auto & record : shard.cache.Expired()) {
+						BlockingPush(shard.out, ExpiredFlow {record, now});
+					}
+					shard.cache.Expired().clear();
+				};
+
+				while (true) {
+					// `done` čteme před frontou - pokud je nastaveno a fronta je prázdná, nic dalšího už nepřijde
+					const bool done = readerDone.load(std::memory_order_acquire);
+					bool processed = false;
+
+					while (true) {
+						// dávka zpráv z fronty
+						std::uint32_t n = 0;
+						while (n < burstSize && shard.in.TryPop(burst[n])) {
+							n++;
+						}
+						if (n == 0) {
+							break;
+						}
+						processed = true;
+
+						{
+							StageTimer timer(&shard.stats.Latency(Stage::Cache));
+							shard.cache.ExpireFlows(burst[0].pkt.ts);
+
+							std::uint32_t nPackets = 0;
+							for (std::uint32_t i = 0; i < n; i++) {
+								if (!burst[i].tick) {
+									packets[nPackets++] = burst[i].pkt;
+								}
+							}
+							shard.cache.Prefetch(packets.data(), nPackets);
+							for (std::uint32_t i = 0; i < nPackets; i++) {
+								shard.cache.AddNewRecord(packets[i]);
+								shard.cache.EvictIfFull();
+							}
+						}
+						now = burst[n - 1].pkt.ts;
+						pushExpired();
+					}
+
+					if (!processed) {
+						if (done) {
+							break;
+						}
+						std::this_thread::yield();
+					}
+				}
+
+				// při checkpointu zůstávají otevřené záznamy v cache, uloží je serializátor po skončení vláken
+				if (!CheckpointPending()) {
+					shard.cache.Flush();
+					pushExpired();
+				}
+				shard.done.store(true, std::memory_order_release);
+			});
+		}
+
+		// serializace a odeslání
+		std::vector<FlowRecord> toExport;
+		toExport.reserve(NetflowV5MaxRecords);
+		std::uint64_t exportNumber = 0;
+		const auto exportFlows = [this, &toExport, &exportNumber, &exportStats]() {
+			if (!toExport.empty()) {
+				StageTimer timer(ExporterStats::ShouldTime(exportNumber++) ? &exportStats.Latency(Stage::Export) : nullptr);
+				ExportFlows(toExport);
+			}
+		};
+		while (true) {
+			bool allDone = true;
+			bool popped = false;
+
+			for (auto & shard : shards) {
+				allDone = shard->done.load(std::memory_order_acquire) && allDone;
+
+				ExpiredFlow e;
+				while (shard->out.TryPop(e)) {
+					popped = true;
+					if (timercmp(&e.ts, &_currentTime, >)) {
+						_currentTime = e.ts;
+					}
+					toExport.push_back(e.record);
+					if (toExport.size() >= NetflowV5MaxRecords) {
+						exportFlows();
+					}
+				}
+			}
+
+			if (!popped) {
+				// nic nového; odešleme neúplný datagram
+				exportFlows();
+				ExpireAggregates();
+				FlushCollectors(true);
+				_stats.Poll(CollectorStats(), _flowCacheSize);
+				if (allDone) {
+					break;
+				}
+				std::this_thread::yield();
+			}
+		}
+
+		reader.join();
+		for (auto & worker : workers) {
+			worker.join();
+		}
+
+		if (CheckpointPending()) {
+			SaveCheckpoint(caches);
+		}
 	}
 
-	ParsedPacket NetflowExporter::ParsePacket(const std::uint8_t * packet)
+	void NetflowExporter::LoopSliced()
+	{
+		const std::uint32_t nSlices = _slices.size();
+		// celková velikost cache se dělí mezi části
+		const std::uint32_t sliceCacheSize = (_flowCacheSize + nSlices - 1) / nSlices;
+
+		// čas startu exportéru = první paket první části
+		{
+			Reader first(_sliceFile, _slices.front(), _filter);
+			const Packet p = first.GetNextPacket();
+			if (p.pktHeader != nullptr) {
+				_startTs = p.pktHeader->ts;
+			}
+		}
+
+		// bloky statistik vytvoříme před spuštěním vláken
+		StatsBlock & exportStats = _stats.AddBlock();
+		std::vector<std::unique_ptr<Slice>> slices;
+		for (const auto & range : _slices) {
+			slices.push_back(std::make_unique<Slice>(range, _activeTimer, _interval, sliceCacheSize, _timerGranularity, _tcpCloseGrace, _stats.AddBlock(),
+				_sampler));
+		}
+
+		std::vector<std::thread> workers;
+		for (std::uint32_t i = 0; i < nSlices; i++) {
+			workers.emplace_back([this, &slice = *slices[i], firstSlice = i == 0]() {
+				Reader reader(_sliceFile, slice.range, _filter);
+				std::vector<FlowPacket> burst(_burstSize);
+				timeval now {};
+
+				Packet p = reader.GetNextPacket();
+				if (p.pktHeader != nullptr) {
+					slice.startTs = p.pktHeader->ts;
+				}
+				// záznamy vzniklé do `_interval` (+ zaokrouhlení času vypršení na granularitu kola) od začátku části
+				// mohou pokračovat flow z předchozí části
+				const std::uint64_t headUntil = TimevalToUs(slice.startTs) + (_interval * 1000ULL + _timerGranularity) * 1000;
+
+				while (p.pktHeader != nullptr && p.pktData != nullptr) {
+					const timeval burstStart = p.pktHeader->ts;
+					std::uint32_t nRead = 0;
+					std::uint32_t nAccepted = 0;
+					{
+						StageTimer timer(&slice.stats.Latency(Stage::Parse));
+						do {
+							now = p.pktHeader->ts;
+							slice.stats.packetsRead.Add();
+							if (ParseFlowPacket(p.pktData, p.pktHeader->caplen, now, slice.stats, burst[nAccepted])
+									&& Sample(slice.sampler, burst[nAccepted], slice.stats)) {
+								nAccepted++;
+							}
+							nRead++;
+							p = reader.GetNextPacket();
+						} while (nRead < _burstSize && p.pktHeader != nullptr && p.pktData != nullptr);
+					}
+
+					{
+						StageTimer timer(&slice.stats.Latency(Stage::Cache));
+						slice.cache.ExpireFlows(burstStart);
+						slice.cache.Prefetch(burst.data(), nAccepted);
+						for (std::uint32_t i = 0; i < nAccepted; i++) {
+							slice.cache.AddNewRecord(burst[i]);
+							slice.cache.EvictIfFull();
+						}
+					}
+
+					for (const auto & record : slice.cache.Expired()) {
+						if (!firstSlice && record.firstUs < headUntil) {
+							slice.head.push_back(record);
+						}
+						else {
+							BlockingPush(slice.out, ExpiredFlow {record, now});
+						}
+					}
+					slice.cache.Expired().clear();
+				}
+
+				// otevřené záznamy se neexportují hned - mohou pokračovat v následující části
+				slice.cache.Flush();
+				slice.tail.swap(slice.cache.Expired());
+				slice.done.store(true, std::memory_order_release);
+			});
+		}
+
+		// serializace a odeslání záznamů, které nejsou na hranici částí
+		std::vector<FlowRecord> toExport;
+		toExport.reserve(NetflowV5MaxRecords);
+		const auto exportRecord = [this, &toExport, &exportStats](const FlowRecord & record) {
+			toExport.push_back(record);
+			if (toExport.size() >= NetflowV5MaxRecords) {
+				StageTimer timer(&exportStats.Latency(Stage::Export));
+				ExportFlows(toExport);
+			}
+		};
+		while (true) {
+			bool allDone = true;
+			bool popped = false;
+
+			for (auto & slice : slices) {
+				allDone = slice->done.load(std::memory_order_acquire) && allDone;
+
+				ExpiredFlow e;
+				while (slice->out.TryPop(e)) {
+					popped = true;
+					if (timercmp(&e.ts, &_currentTime, >)) {
+						_currentTime = e.ts;
+					}
+					exportRecord(e.record);
+				}
+			}
+
+			if (!popped) {
+				ExpireAggregates();
+				FlushCollectors(true);
+				_stats.Poll(CollectorStats(), _flowCacheSize);
+				if (allDone) {
+					break;
+				}
+				std::this_thread::yield();
+			}
+		}
+		for (auto & worker : workers) {
+			worker.join();
+		}
+
+		// spojení flow přes hranice: otevřený záznam z konce části pokračuje záznamem stejného klíče z následující části,
+		// pokud by mu při sériovém zpracování mezitím nevypršel inactive ani active timer (časy vypršení jsou zaokrouhlené
+		// nahoru na granularitu kola, viz FlowCache::FlowDeadline())
+		std::unordered_map<FlowKey, FlowRecord, FlowKeyHash> open;
+		const std::uint64_t granularityUs = std::max<std::uint32_t>(_timerGranularity, 1) * 1000ULL;
+		const auto roundUp = [granularityUs](std::uint64_t us) {
+			return (us + granularityUs - 1) / granularityUs * granularityUs;
+		};
+		const auto continueOpen = [this, &open, &roundUp](FlowRecord & record) {
+			const auto it = open.find(record.key);
+			if (it == open.end()) {
+				return;
+			}
+			const FlowRecord & prev = it->second;
+			if (record.firstUs < roundUp(prev.lastUs + _interval * 1'000'000ULL)
+					&& record.lastUs < roundUp(prev.firstUs + _activeTimer * 1'000'000ULL)) {
+				record.firstUs = prev.firstUs;
+				record.dPkts += prev.dPkts;
+				record.dOctets += prev.dOctets;
+				record.tcpFlags |= prev.tcpFlags;
+				open.erase(it);
+			}
+		};
+
+		for (auto & slice : slices) {
+			for (auto & record : slice->head) {
+				continueOpen(record);
+				exportRecord(record);
+			}
+
+			std::unordered_map<FlowKey, FlowRecord, FlowKeyHash> next;
+			const std::uint64_t headUntil = TimevalToUs(slice->startTs) + (_interval * 1000ULL + _timerGranularity) * 1000;
+			for (auto & record : slice->tail) {
+				if (record.firstUs < headUntil) {
+					continueOpen(record);
+				}
+				next.emplace(record.key, record);
+			}
+
+			// flow, které v této části nepokračují, by při sériovém zpracování vypršely
+			for (const auto & [key, record] : open) {
+				exportRecord(record);
+			}
+			open = std::move(next);
+		}
+		for (const auto & [key, record] : open) {
+			exportRecord(record);
+		}
+		ExportFlows(toExport);
+	}
+
+	ParsedPacket NetflowExporter::ParsePacket(const std::uint8_t * packet, std::uint32_t caplen)
 	{
 		constexpr std::uint32_t ValidChecksum = 0x0000FFFF;
 
 		ParsedPacket pkt;
+		// data paketu mohou ukazovat přímo do namapovaného souboru - před každou hlavičkou ověříme, že je zachycená celá
+		if (caplen < EthernetHeaderSize) {
+			LOG_DEBUG("Truncated ethernet header: caplen " + std::to_string(caplen));
+			pkt.error = ParseError::MalformedIp;
+			return pkt;
+		}
 		pkt.eth = reinterpret_cast<const EthernetHeader *>(packet);
 		
 		std::uint32_t currentOffset = EthernetHeaderSize;
@@ -100,18 +789,25 @@ namespace Netflow
 
 		// zjistíme, jestli se jedná o ipv4 nebo ipv6
 		if (pkt.eth->Type() == EtherTypeIpv4) {
+			if (caplen < currentOffset + 20) {
+				LOG_DEBUG("Truncated ip header: caplen " + std::to_string(caplen));
+				pkt.error = ParseError::MalformedIp;
+				return pkt;
+			}
+
 			// nejspíše se jedná o ipv4; zkontrolujeme IHL a checksum
 			const auto sizeIp = ip->Ihl() * 4;
 
-			if (sizeIp < 20) {
-				Logger::LogDebug<>("Invalid ip header: sizeIp < " + std::to_string(sizeIp));
+			if (sizeIp < 20 || caplen < currentOffset + sizeIp) {
+				LOG_DEBUG("Invalid ip header: sizeIp < " + std::to_string(sizeIp));
+				pkt.error = ParseError::MalformedIp;
 				return pkt;
 			}
 
 			// zkontrolujeme checksum; asi není potřeba
 			/*const auto checksum = CalculateIpChecksum(ip);
 			if (checksum != ValidChecksum) {
-				Logger::LogDebug<>("Invalid IPv4 checksum value: " + std::to_string(checksum));
+				LOG_DEBUG("Invalid IPv4 checksum value: " + std::to_string(checksum));
 				return pkt;
 			}*/
 			pkt.ipv4h = ip;
@@ -121,6 +817,12 @@ namespace Netflow
 			pkt.ipVersion = IpVersion::Ipv4;
 		}
 		else if (pkt.eth->Type() == EtherTypeIpv6) {
+			if (caplen < currentOffset + Ipv6HeaderSize) {
+				LOG_DEBUG("Truncated ipv6 header: caplen " + std::to_string(caplen));
+				pkt.error = ParseError::MalformedIp;
+				return pkt;
+			}
+
 			// jedná se o ipv6; cast
 			pkt.ipv6h = reinterpret_cast<const Ipv6Header *>(packet + currentOffset);
 
@@ -129,17 +831,24 @@ namespace Netflow
 			pkt.ipVersion = IpVersion::Ipv6;
 		}
 		else {
-			Logger::LogDebug<>("Not an ipv4/ipv6 header: " + std::to_string(ip->Ihl()));
+			LOG_DEBUG("Not an ipv4/ipv6 header: " + std::to_string(ip->Ihl()));
+			pkt.error = ParseError::NotIp;
 			return pkt;
 		}
 		
 		// tcp/udp/icmp?
 		if (protocol == Constants::TcpProtocolNumber) {
+			if (caplen < currentOffset + sizeof(TcpHeader)) {
+				LOG_DEBUG("Truncated TCP header: caplen " + std::to_string(caplen));
+				pkt.error = ParseError::MalformedL4;
+				return pkt;
+			}
 			const auto tcp = reinterpret_cast<const TcpHeader *>(packet + currentOffset);
 			const auto sizeTcp = tcp->GetOffset() * 4;
 
 			if (sizeTcp < 20 || sizeTcp > 60) {
-				Logger::LogDebug<>("Invalid TCP header size: " + std::to_string(sizeTcp));
+				LOG_DEBUG("Invalid TCP header size: " + std::to_string(sizeTcp));
+				pkt.error = ParseError::MalformedL4;
 				return pkt;
 			}
 			currentOffset += sizeTcp;
@@ -147,26 +856,38 @@ namespace Netflow
 			pkt.protocol = Protocol::Tcp;
 		}
 		else if(protocol == Constants::UdpProtocolNumber) {
+			if (caplen < currentOffset + sizeof(UdpHeader)) {
+				LOG_DEBUG("Truncated UDP header: caplen " + std::to_string(caplen));
+				pkt.error = ParseError::MalformedL4;
+				return pkt;
+			}
 			const auto udp = reinterpret_cast<const UdpHeader *>(packet + currentOffset);
 			const auto sizeUdp = udp->Length();
 
 			if (sizeUdp < 8) {
-				Logger::LogDebug<>("Invalid UDP header size: " + std::to_string(sizeUdp));
+				LOG_DEBUG("Invalid UDP header size: " + std::to_string(sizeUdp));
+				pkt.error = ParseError::MalformedL4;
 				return pkt;
 			}
 			currentOffset += sizeUdp;
 			pkt.udph = udp;
 			pkt.protocol = Protocol::Udp;
 		}
-		else if(protocol == Constants::IcmpProtocolNumber) {
+		else if(protocol == Constants::IcmpProtocolNumber || protocol == Constants::Icmpv6ProtocolNumber) {
+			if (caplen < currentOffset + sizeof(IcmpHeader)) {
+				LOG_DEBUG("Truncated ICMP header: caplen " + std::to_string(caplen));
+				pkt.error = ParseError::MalformedL4;
+				return pkt;
+			}
 			pkt.icmph = reinterpret_cast<const IcmpHeader *>(packet + currentOffset);
 			currentOffset += 8;
 			pkt.protocol = Protocol::Icmp;
 		}
 		else {
-			Logger::LogDebug<>("Unknown protocol: " + std::to_string(protocol));
+			LOG_DEBUG("Unknown protocol: " + std::to_string(protocol));
 			pkt.ipVersion = IpVersion::None;
 			pkt.ipv4h = nullptr;
+			pkt.error = ParseError::UnsupportedProtocol;
 			return pkt;
 		}
 
@@ -174,164 +895,452 @@ namespace Netflow
 		return pkt;
 	}
 
-	void NetflowExporter::AddNewRecord(const ParsedPacket & pkt)
+	void NetflowExporter::FlushExports()
 	{
-		bool found = false;
+		if (_aggregator) {
+			_aggregator->Flush();
+			ExportRecords(_aggregator->Expired());
+		}
+		for (auto & stream : _streams) {
+			SendIpfixMessages(stream, true);
+		}
+		FlushCollectors(false);
+		if (_sink) {
+			_sink->Flush();
+		}
+	}
 
-		// erase-remove idiom
-		_flows.erase(std::remove_if(_flows.begin(), _flows.end(),
-			[this, pkt, &found](FlowRecord & record) {
-				// zkusíme exportovat záznam, pokud vypršel jeden z timerů
-				if (TryFlowExport(record)) {
-					// záznam byl exportován a smazán
-					return true;
+	void NetflowExporter::FlushCollectors(bool onlyDue)
+	{
+		for (auto & stream : _streams) {
+			if (onlyDue) {
+				stream.collector->FlushIfDue();
+			}
+			else {
+				stream.collector->Flush();
+			}
+		}
+	}
+
+	SendStats NetflowExporter::CollectorStats() const
+	{
+		SendStats total;
+		for (const auto & stream : _streams) {
+			total += stream.collector->GetStats();
+		}
+		return total;
+	}
+
+	std::uint32_t NetflowExporter::ReadBurst(StatsBlock & stats, InputPacket * out, bool & idle)
+	{
+		std::uint32_t n = 0;
+		if (_multiReader) {
+			// pakety jsou naparsované ve vláknech souborů; vzorkování až po slití (deterministické závisí na pořadí)
+			while (n < _burstSize && !checkpointRequested && _multiReader->Next(out[n])) {
+				if (out[n].parsed) {
+					out[n].parsed = Sample(_sampler, out[n].pkt, stats);
 				}
+				n++;
+			}
+			return n;
+		}
 
-				// záznam nebyl exportován; pokud příchozí paket odpovídá již
-				// existujícímu záznamu, tak jej přidáme
-				if (record.PacketEq(pkt)) {
-					AddPacketToFlow(pkt, record);
-					found = true;
+		while (n < _burstSize) {
+			if (checkpointRequested) {
+				// ukončení s checkpointem - končíme jako na konci vstupu
+				break;
+			}
+			if (_reader->IsLive() && !_reader->WaitReadable(_flushTimer ? _flushTimer->Fd() : -1)) {
+				if (_flushTimer && _flushTimer->Consume()) {
+					// tichý vstup - vrátíme, co máme, aby se mohlo exportovat
+					idle = true;
+					break;
 				}
-				return false;
-		}), _flows.end());
+				// signál - znovu zkontrolujeme požadavek na checkpoint
+				continue;
+			}
+			const Packet p = _reader->GetNextPacket();
+			if (p.pktHeader == nullptr || p.pktData == nullptr) {
+				break;
+			}
+			stats.packetsRead.Add();
+			out[n].parsed = ParseAndSample(p.pktData, p.pktHeader->caplen, p.pktHeader->ts, stats, out[n].pkt);
+			out[n].pkt.ts = p.pktHeader->ts;
+			n++;
+		}
+		if (_flushTimer && n > 0) {
+			_lastPacketTs = out[n - 1].pkt.ts;
+			_lastPacketClock = std::chrono::steady_clock::now();
+		}
+		return n;
+	}
+
+	timeval NetflowExporter::IdleTime() const
+	{
+		const auto idleUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _lastPacketClock).count();
+		timeval idle {};
+		idle.tv_sec = idleUs / 1000000;
+		idle.tv_usec = idleUs % 1000000;
+		timeval now;
+		timeradd(&_lastPacketTs, &idle, &now);
+		return now;
+	}
+
+	void NetflowExporter::RequestCheckpoint()
+	{
+		checkpointRequested = 1;
+	}
+
+	std::uint32_t NetflowExporter::ShardFor(const FlowKey & key, std::uint64_t hash, std::uint32_t nShards) const
+	{
+		// horní bity dolní poloviny hashe; dolní bity indexují tabulku uvnitř shardu. Při sledování ukončení TCP
+		// musí být oba směry spojení ve stejném shardu
+		const std::uint32_t h = static_cast<std::uint32_t>(_tcpCloseGrace > 0 ? key.SymmetricHash() : hash);
+		return (static_cast<std::uint64_t>(h) * nShards) >> 32;
+	}
+
+	bool NetflowExporter::CheckpointPending() const
+	{
+		return checkpointRequested && !_checkpointPath.empty();
+	}
+
+	void NetflowExporter::RestoreCheckpoint(const std::vector<FlowCache *> & caches)
+	{
+		if (!_restore) {
+			return;
+		}
 
-		if (!found) {
-			// paket nebyl přidán do žádné existující flow; vytvoříme novou
-			CreateNewFlow(pkt);
+		const auto start = std::chrono::steady_clock::now();
+		_startTs = _restore->StartTs();
+		_currentTime = _restore->CurrentTime();
+		if (_restore->StreamCount() == _streams.size()) {
+			for (std::uint32_t i = 0; i < _streams.size(); i++) {
+				_streams[i].nFlowsSeen = _restore->FlowsSeen(i);
+			}
+		}
+		else if (!_streams.empty()) {
+			Logger::LogWarning<>("Checkpoint was saved with " + std::to_string(_restore->StreamCount())
+				+ " collectors, sequence numbers start from 0");
 		}
+
+		// kolo musí znát současný čas dřív, než se do něj naplánují obnovené záznamy
+		for (FlowCache * cache : caches) {
+			cache->ExpireFlows(_currentTime);
+		}
+		const FlowRecord * records = _restore->Records();
+		const std::uint8_t * closed = _restore->Closed();
+		const std::uint64_t n = _restore->Size();
+		for (std::uint64_t i = 0; i < n; i++) {
+			const std::uint32_t shard = caches.size() > 1 ? ShardFor(records[i].key, records[i].key.Hash(), caches.size()) : 0;
+			caches[shard]->Restore(records[i], closed[i] != 0);
+		}
+		// záznamy, které se do menší cache nevešly
+		for (FlowCache * cache : caches) {
+			if (!cache->Expired().empty()) {
+				ExportFlows(cache->Expired());
+			}
+		}
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+		Logger::LogInfo<>("Restored " + std::to_string(n) + " flows from checkpoint " + _restore->Path() + " in "
+			+ std::to_string(elapsed.count() / 1000.0) + " ms");
+
+		// obnovené záznamy se jednou exportují; stejný checkpoint už se nesmí obnovit znovu
+		std::remove(_restore->Path().c_str());
+		_restore.reset();
 	}
 
-	void NetflowExporter::AddPacketToFlow(const ParsedPacket & pkt, FlowRecord & record)
+	void NetflowExporter::SaveCheckpoint(const std::vector<FlowCache *> & caches)
 	{
-		record.dPkts++;
-		record.dOctets += pkt.ipv4h->Length();
-		record.last = TimevalToSec(_currentTime);
-		if (pkt.protocol == Protocol::Tcp) {
-			record.tcpFlags |= pkt.tcph->flags;
+		CheckpointState state;
+		state.startTs = _startTs;
+		state.currentTime = _currentTime;
+		for (const FlowCache * cache : caches) {
+			if (timercmp(&cache->CurrentTime(), &state.currentTime, >)) {
+				state.currentTime = cache->CurrentTime();
+			}
+			cache->Checkpoint(state);
+		}
+		for (const auto & stream : _streams) {
+			state.flowsSeen.push_back(stream.nFlowsSeen);
 		}
+		FlowCheckpoint::Save(_checkpointPath, state);
 	}
 
-	void NetflowExporter::CreateNewFlow(const ParsedPacket & pkt)
+	void NetflowExporter::FlushIdle(FlowCache & cache)
 	{
-		FlowRecord r {};
+		const timeval now = IdleTime();
+		if (timercmp(&now, &_currentTime, >)) {
+			_currentTime = now;
+		}
+		cache.ExpireFlows(_currentTime);
+		if (!cache.Expired().empty()) {
+			ExportFlows(cache.Expired());
+		}
+		ExpireAggregates();
+		// na tichém vstupu se zpráva ani dávka datagramů dál neplní - není důvod je držet
+		for (auto & stream : _streams) {
+			SendIpfixMessages(stream, true);
+		}
+		FlushCollectors(false);
+		_stats.Poll(CollectorStats(), _flowCacheSize);
+	}
 
-		// packet musí být ipv4
-		r.srcAddr = pkt.ipv4h->SrcAddr();
-		r.dstAddr = pkt.ipv4h->DstAddr();
-		r.dOctets = pkt.ipv4h->Length();
-		r.dPkts = 1;
-		r.first = TimevalToSec(_currentTime);
-		r.last = TimevalToSec(_currentTime);
-		if (pkt.protocol == Protocol::Tcp) {
-			r.prot = Constants::TcpProtocolNumber;
-			r.srcPort = pkt.tcph->SrcPort();
-			r.dstPort = pkt.tcph->DstPort();
-			r.tcpFlags = pkt.tcph->flags;
+	bool NetflowExporter::ParseAndSample(const std::uint8_t * packet, std::uint32_t caplen, const timeval & ts, StatsBlock & stats,
+			FlowPacket & out)
+	{
+		const auto parsed = ParsePacket(packet, caplen);
+		if (!AcceptParsed(parsed, stats)) {
+			return false;
 		}
-		else if (pkt.protocol == Protocol::Udp) {
-			r.prot = Constants::UdpProtocolNumber;
-			r.srcPort = pkt.udph->SrcPort();
-			r.dstPort = pkt.udph->DstPort();
+
+		// nevybrané pakety (vzorkování) do cache vůbec nepustíme
+		if (!_sampler.SelectPacket()) {
+			stats.Drop(DropReason::Sampling);
+			return false;
 		}
-		else if (pkt.protocol == Protocol::Icmp) {
-			r.prot = Constants::IcmpProtocolNumber;
+		out = FlowPacket::FromPacket(parsed, ts);
+		if (!_sampler.SelectFlow(out.hash)) {
+			stats.Drop(DropReason::Sampling);
+			return false;
 		}
-		else {
-			// nepodporováno; ale můžeme vložit číslo protokolu alespoň
-			r.prot = pkt.ipv4h->prot;
+
+		stats.packetsParsed.Add();
+		return true;
+	}
+
+	bool NetflowExporter::ParseFlowPacket(const std::uint8_t * packet, std::uint32_t caplen, const timeval & ts, StatsBlock & stats,
+			FlowPacket & out) const
+	{
+		const auto parsed = ParsePacket(packet, caplen);
+		if (!AcceptParsed(parsed, stats)) {
+			return false;
 		}
-		r.tos = pkt.ipv4h->Dscp();
+		out = FlowPacket::FromPacket(parsed, ts);
+		return true;
+	}
 
-		Logger::LogDebug<>("Saved record: " + IntToIpv4(r.srcAddr) + " " + IntToIpv4(r.dstAddr));
-		_flows.push_back(r);
+	bool NetflowExporter::Sample(PacketSampler & sampler, const FlowPacket & pkt, StatsBlock & stats)
+	{
+		if (!sampler.SelectPacket() || !sampler.SelectFlow(pkt.hash)) {
+			stats.Drop(DropReason::Sampling);
+			return false;
+		}
+		stats.packetsParsed.Add();
+		return true;
 	}
 
-	bool NetflowExporter::TryFlowExport(FlowRecord & record)
+	bool NetflowExporter::AcceptParsed(const ParsedPacket & parsed, StatsBlock & stats) const
 	{
-		uint32_t tActive = record.last - record.first;
-		uint32_t tInactive = TimevalToSec(_currentTime) - record.last;
+		switch (parsed.error) {
+		case ParseError::NotIp:
+			stats.Drop(DropReason::NotIp);
+			return false;
+		case ParseError::MalformedIp:
+			stats.Drop(DropReason::MalformedIp);
+			return false;
+		case ParseError::UnsupportedProtocol:
+			stats.Drop(DropReason::UnsupportedProtocol);
+			return false;
+		case ParseError::MalformedL4:
+			// IP hlavička je v pořádku; paket zpracujeme bez portů
+			stats.malformedL4.Add();
+			break;
+		default:
+			break;
+		}
 
-		if (tActive >= _activeTimer || tInactive >= _interval) {
-			// vypršel timer, "exportujeme" packet (přidáme ho do paketů k exportu)
-			Logger::LogDebug<>("Saved flow export");
-			SaveFlowExport(record);
-			return true;
+		if (!IsExportable(parsed)) {
+			stats.Drop(DropReason::IpVersion);
+			return false;
 		}
-		return false;
+		return true;
 	}
 
-	void NetflowExporter::SaveFlowExport(FlowRecord & record)
+	bool NetflowExporter::IsExportable(const ParsedPacket & pkt) const
 	{
-		// header vytvoříme až při exportu
-		NetflowV5FlowRecord r {};
-		r.dOctets = record.dOctets;
-		r.srcAddr = record.srcAddr;
-		r.dstAddr = record.dstAddr;
-		r.dPkts = record.dPkts;
-		r.dOctets = record.dOctets;
-		r.first = record.first;
-		r.last = record.last;
-		r.srcPort = record.srcPort;
-		r.dstPort = record.dstPort;
-		r.tcpFlags = record.tcpFlags;
-		r.prot = record.prot;
-		r.tos = record.tos;
+		if (pkt.eth == nullptr) {
+			return false;
+		}
+		// netflow v5 podporuje pouze ipv4
+		return pkt.ipVersion == IpVersion::Ipv4 || (pkt.ipVersion == IpVersion::Ipv6 && _format != ExportFormat::NetflowV5);
+	}
 
-		_toExport.push_back(r);
+	void NetflowExporter::ExportFlows(std::vector<FlowRecord> & records)
+	{
+		if (_aggregator) {
+			// agregační stupeň mezi flow-cache a serializací
+			_aggregator->Add(records, _currentTime);
+			records.clear();
+			ExpireAggregates();
+			return;
+		}
+		ExportRecords(records);
 	}
 
-	void NetflowExporter::ExportFlows()
+	void NetflowExporter::ExpireAggregates()
 	{
-		// Maximální počet záznamů exportovaných v 1 odeslání
-		constexpr std::uint32_t MaxExportedFlows = 30;
+		if (_aggregator) {
+			_aggregator->Expire(_currentTime);
+			ExportRecords(_aggregator->Expired());
+		}
+	}
 
-		if (_toExport.size() == 0) {
+	void NetflowExporter::ExportRecords(std::vector<FlowRecord> & records)
+	{
+		if (records.size() == 0) {
 			return;
 		}
 
-		std::uint32_t nExports = _toExport.size();
-		std::vector<std::uint8_t> data;
+		if (_sink) {
+			_sink->Write(records);
+		}
+		else if (!_ring) {
+			ExportToStream(_streams.front(), records);
+		}
+		else {
+			// oba směry spojení ke stejnému kolektoru
+			for (const auto & record : records) {
+				_streams[_ring->NodeFor(static_cast<std::uint32_t>(record.key.SymmetricHash()))].records.push_back(record);
+			}
+			for (auto & stream : _streams) {
+				if (!stream.records.empty()) {
+					ExportToStream(stream, stream.records);
+					stream.records.clear();
+				}
+			}
+		}
+		records.clear();
+	}
+
+	void NetflowExporter::ExportToStream(ExportStream & stream, const std::vector<FlowRecord> & records)
+	{
+		if (_format == ExportFormat::Ipfix) {
+			ExportFlowsIpfix(stream, records);
+		}
+		else {
+			ExportFlowsV5(stream, records);
+		}
+	}
+
+	void NetflowExporter::ExportFlowsV5(ExportStream & stream, const std::vector<FlowRecord> & records)
+	{
+		std::uint32_t nExports = records.size();
 		std::uint32_t exportIndex = 0;
 
-		// musíme exportovat maximálně po MaxExportedFlows záznamech
+		// musíme exportovat maximálně po NetflowV5MaxRecords záznamech
 		while (nExports > 0) {
-			const std::uint32_t currentExports = std::min(MaxExportedFlows, nExports);
+			const std::uint32_t currentExports = std::min(NetflowV5MaxRecords, nExports);
 
-			// _nFlowsSeen musíme přidávat postupně. Pokud je přidáme všechny najednou,
-			// tak při exportu > MaxExportedFlows bude mít h.count nesprávné hodnoty
-			_nFlowsSeen += currentExports;
+			// nFlowsSeen musíme přidávat postupně. Pokud je přidáme všechny najednou,
+			// tak při exportu > NetflowV5MaxRecords bude mít h.count nesprávné hodnoty
+			stream.nFlowsSeen += currentExports;
 			nExports -= currentExports;
 
-			std::chrono::time_point<std::chrono::system_clock, std::chrono::seconds> 
-				tp{std::chrono::seconds{_currentTime.tv_sec}};
-
-			// exportujeme maximálně MaxExportedFlows; zbytek v dalších exportech
+			// exportujeme maximálně NetflowV5MaxRecords; zbytek v dalších exportech
 			NetflowV5Header h {};
 			h.count = currentExports;
-			h.sysUptime = static_cast<uint32_t>((TimevalToSec(_currentTime) - TimevalToSec(_startTs)) * 1000.0);
+			h.sysUptime = static_cast<uint32_t>((TimevalToUs(_currentTime) - TimevalToUs(_startTs)) / 1000);
 			h.unixSecs = _currentTime.tv_sec;
-			std::cout << _currentTime.tv_sec << " " << h.unixSecs << "\n";
-			//h.unixSecs = tp.time_since_epoch().count();
-			h.unixNsecs = _currentTime.tv_usec;
-			h.flowSequence = _nFlowsSeen;
-
-			auto hdrSerialized = h.Serialize();
-			data.insert(data.end(), &hdrSerialized[0], &hdrSerialized[hdrSerialized.size()]);
+			h.unixNsecs = _currentTime.tv_usec * 1000;
+			h.flowSequence = stream.nFlowsSeen;
+			h.samplingInterval = _sampler.V5SamplingInterval();
 
+			// hlavičku i záznamy zapisujeme rovnou do `_datagram` (bez alokací)
+			std::uint8_t * out = h.SerializeTo(_datagram.data());
 			for (std::uint32_t i = 0; i < currentExports; i++) {
-				auto serialized = _toExport.at(exportIndex++).Serialize();
-				data.insert(data.end(), &serialized[0], &serialized[serialized.size()]);
+				NetflowV5FlowRecord r = ToV5Record(records[exportIndex++]);
+				if (_aggregator) {
+					// adresy agregovaných záznamů jsou prefixy
+					r.srcMask = _aggregator->Config().srcPrefixV4;
+					r.dstMask = _aggregator->Config().dstPrefixV4;
+				}
+				out = r.SerializeTo(out);
+			}
+
+			// zařadíme k odeslání na kolektor
+			const bool queued = stream.collector->Queue(_datagram.data(), out - _datagram.data());
+			if (!queued) {
+				LOG_DEBUG("Couldn't send data");
+			}
+		}
+	}
+
+	void NetflowExporter::ExportFlowsIpfix(ExportStream & stream, const std::vector<FlowRecord> & records)
+	{
+		if (stream.ipfixPending[0].empty() && stream.ipfixPending[1].empty()) {
+			stream.ipfixPendingSince = TimevalToMs(_currentTime);
+		}
+		for (const auto & record : records) {
+			stream.ipfixPending[record.key.ipVersion == IpVersion::Ipv6 ? 1 : 0].push_back(record);
+		}
+		SendIpfixMessages(stream, false);
+	}
+
+	void NetflowExporter::SendIpfixMessages(ExportStream & stream, bool force)
+	{
+		auto & pendingRecords = stream.ipfixPending;
+		constexpr std::array<std::uint16_t, 2> TemplateIds {IpfixTemplateIpv4, IpfixTemplateIpv6};
+		constexpr std::array<std::uint32_t, 2> RecordSizes {IpfixRecordSizeIpv4, IpfixRecordSizeIpv6};
+
+		while (!pendingRecords[0].empty() || !pendingRecords[1].empty()) {
+			const bool due = force || TimevalToMs(_currentTime) >= stream.ipfixPendingSince + IpfixMaxHoldMs;
+			const bool withTemplates = stream.ipfixMessages % IpfixTemplateRefresh == 0;
+
+			if (!due) {
+				// zprávu sestavíme, až se zaplní (odhad bez sestavování)
+				std::uint64_t needed = IpfixHeaderSize + (withTemplates ? IpfixTemplateSetSize : 0);
+				for (std::size_t v = 0; v < pendingRecords.size(); v++) {
+					if (!pendingRecords[v].empty()) {
+						needed += IpfixSetHeaderSize + pendingRecords[v].size() * RecordSizes[v];
+					}
+				}
+				if (needed <= _ipfixMessageSize) {
+					return;
+				}
 			}
 
-			// zašleme na kolektor
-			const bool sent = _collector.Send(data.data(), data.size());
-			if (!sent) {
-				Logger::LogDebug<>("Couldn't send data");
+			std::uint8_t * const begin = _datagram.data();
+			const std::uint8_t * const end = begin + _ipfixMessageSize;
+			std::uint8_t * out = begin + IpfixHeaderSize;
+			if (withTemplates) {
+				out = SerializeIpfixTemplateSet(out);
+			}
+
+			// pro každou verzi IP jeden datový set; zapisujeme, dokud se vejde
+			std::array<std::size_t, 2> written {0, 0};
+			for (std::size_t v = 0; v < pendingRecords.size(); v++) {
+				const auto & pending = pendingRecords[v];
+				if (pending.empty() || static_cast<std::uint32_t>(end - out) < IpfixSetHeaderSize + RecordSizes[v]) {
+					continue;
+				}
+
+				std::uint8_t * const set = out;
+				out += IpfixSetHeaderSize;
+				while (written[v] < pending.size() && static_cast<std::uint32_t>(end - out) >= RecordSizes[v]) {
+					out = SerializeIpfixRecord(pending[written[v]++], out);
+				}
+				SerializeIpfixSetHeader(set, TemplateIds[v], out - set);
+			}
+
+			IpfixHeader h {};
+			h.length = out - begin;
+			h.exportTime = _currentTime.tv_sec;
+			h.sequenceNumber = stream.nFlowsSeen; // záznamy odeslané před touto zprávou
+			h.SerializeTo(begin);
+
+			stream.nFlowsSeen += written[0] + written[1];
+			stream.ipfixMessages++;
+
+			const bool queued = stream.collector->Queue(begin, out - begin);
+			if (!queued) {
+				LOG_DEBUG("Couldn't send data");
+			}
+
+			for (std::size_t v = 0; v < pendingRecords.size(); v++) {
+				pendingRecords[v].erase(pendingRecords[v].begin(), pendingRecords[v].begin() + written[v]);
 			}
-			data.clear();
 		}
-		_toExport.clear();
 	}
 
 	std::uint32_t NetflowExporter::CalculateIpChecksum(const Ipv4Header * iph)
@@ -345,9 +1354,4 @@ namespace Netflow
 		}
 		return (total & 0x0000FFFF) + (total >> 16);
 	}
-
-	double NetflowExporter::TimevalToSec(const timeval & t)
-	{
-		return (static_cast<double>(t.tv_sec)) + (static_cast<double>(t.tv_usec) / 1'000'000);
-	}
 } // namespace Netflow
@@ -8,100 +8,105 @@
 #pragma once
 
 #include "pcap_reader.h"
+#include "multi_file_reader.h"
+#include "pcap_index.h"
+#include "flow_aggregator.h"
+#include "flow_sink.h"
+#include "af_packet_source.h"
+#include "flush_timer.h"
 #include "netflow_collector_connection.h"
+#include "hash_ring.h"
 #include "netflow_datagram.h"
+#include "ipfix_datagram.h"
+#include "flow_record.h"
+#include "flow_cache.h"
+#include "flow_checkpoint.h"
+#include "packet_sampler.h"
+#include "exporter_stats.h"
 
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <array>
 #include <algorithm>
+#include <chrono>
+#include <memory>
 
 namespace Netflow
 {
-	namespace Constants
+	/**
+	 * @brief Formát exportu
+	 */
+	enum class ExportFormat
 	{
-		/// @brief ICMP ip protokol číslo
-		constexpr std::uint8_t IcmpProtocolNumber = 1;
-
-		/// @brief TCP ip protokol číslo
-		constexpr std::uint8_t TcpProtocolNumber = 6;
-
-		/// @brief UDP ip protokol číslo
-		constexpr std::uint8_t UdpProtocolNumber = 17;
-	} // namespace Constants
+		NetflowV5, ///< Netflow v5 - pouze IPv4, max. 30 záznamů v datagramu
+		Ipfix,     ///< IPFIX (v10) se šablonami - IPv4 i IPv6, zprávy do velikosti MTU
+		Archive    ///< Bez kolektoru - sloupcový archiv na disku (FlowArchiveWriter), IPv4 i IPv6
+	};
 
 	/**
-	 * @brief Verze IP
+	 * @brief Nastavení formátu exportu
 	 */
-	enum class IpVersion
+	struct ExportConfig
 	{
-		None,
-		Ipv4,
-		Ipv6
+		ExportFormat format {ExportFormat::NetflowV5};
+		std::uint32_t mtu {1500}; ///< MTU cesty ke kolektoru; určuje max. velikost IPFIX zprávy
+		std::string archivePath {}; ///< Cesta k archivu (ExportFormat::Archive)
+		PacingConfig pacing {};     ///< Omezení rychlosti odesílání (pro každý kolektor zvlášť)
 	};
 
 	/**
-	 * @brief Podporované ip protokoly
+	 * @brief Nastavení zpracování - časovače, flow-cache a vlákna
 	 */
-	enum class Protocol
+	struct ExporterConfig
 	{
-		None,
-		Tcp,
-		Udp,
-		Icmp
+		std::uint32_t activeTimer {60};        ///< Interval v sekundách, po kterém se exportují aktivní záznamy
+		std::uint32_t interval {10};           ///< Interval v sekundách, po jehož vypršení se exportují neaktivní záznamy
+		std::uint32_t flowCacheSize {1024};    ///< Velikost flow-cache; při zaplnění se exportuje nejdéle nepoužitý záznam
+		std::uint32_t timerGranularity {1000}; ///< Granularita časovacího kola v ms
+		std::uint32_t threads {1};             ///< Počet vláken s flow-cache (shardů); 1 = vše v jednom vlákně
+		std::uint32_t burstSize {64};          ///< Počet paketů zpracovaných najednou (parsování, prefetch, aktualizace, export)
+		std::uint32_t tcpCloseGrace {0};       ///< Inactive timer ukončených TCP spojení v sekundách (0 = ukončení se nesleduje)
 	};
 
 	/**
-	 * @brief Pomocná struktura pro uložení ukazatelů na začátky headerů.
+	 * @brief Nastavení vstupu
 	 */
-	struct ParsedPacket
+	struct InputConfig
 	{
-		const EthernetHeader * eth {nullptr};
-
-		IpVersion ipVersion {IpVersion::None};
-		union {
-			const Ipv4Header * ipv4h {nullptr};
-			const Ipv6Header * ipv6h;
-		};
-
-		Protocol protocol {Protocol::None};
-		union
-		{
-			const TcpHeader * tcph {nullptr};
-			const UdpHeader * udph;
-			const IcmpHeader * icmph;
-		};
-
-		const std::uint8_t * payload {nullptr};
-		uint32_t size; ///< Celková velikost paketu
+		std::uint64_t fromUs {0};                ///< Zpracovat pouze pakety s časem >= fromUs (µs od epochy)
+		std::uint64_t toUs {ReadRange::NoLimit}; ///< Zpracovat pouze pakety s časem < toUs
+		std::uint32_t slices {1};                ///< Na kolik časově navazujících částí rozdělit jediný vstupní soubor (vyžaduje index)
+		std::string interface {};                ///< Zachytávat živě z rozhraní místo čtení souborů (prázdné = soubory)
+		RingConfig ring {};                      ///< RX ring pro živé zachytávání
+		std::shared_ptr<const BpfFilter> filter {}; ///< Zpracovat pouze pakety vyhovující BPF filtru (nullptr = všechny)
+		std::uint32_t maxExportDelayMs {1000};   ///< Na vstupu, který může stát (stdin, rozhraní), posouvat čas podle hodin s touto periodou (0 = jen pakety)
+		std::string checkpointPath {};           ///< Po RequestCheckpoint() uložit otevřené záznamy sem místo jejich exportu (prázdné = exportovat)
+		std::string restorePath {};              ///< Před zpracováním obnovit flow-cache z checkpointu (prázdné = začít s prázdnou cache)
 	};
 
 	/**
-	 * @brief Flow záznam. Neobsahuje všechny hodnoty Netflow V5 záznamu.
-	 * Před odesláním je nutné ho převést na NetflowV5FlowRecord.
+	 * @brief Export na jeden kolektor - spojení a stav proudu datagramů (sekvenční čísla, IPFIX zprávy)
 	 */
-	struct FlowRecord
+	struct ExportStream
 	{
-		uint32_t srcAddr;
-		uint32_t dstAddr;
-		uint32_t dPkts;
-		uint32_t dOctets;
-		uint32_t first;
-		uint32_t last;
-		uint32_t srcPort;
-		uint32_t dstPort;
-		uint8_t tcpFlags {};
-		uint8_t prot;
-		uint8_t tos;
+		/// @brief Spojení na kolektor
+		std::unique_ptr<CollectorConnection> collector;
 
-		/**
-		 * @brief Porovnání s paketem
-		 * 
-		 * @param pkt paket
-		 * @return true paket a hodnoty v struktuře jsou stejné
-		 * @return false paket a hodnoty v struktuře nejsou stejné
-		 */
-		bool PacketEq(const ParsedPacket & pkt) const;
+		/// @brief Počet flow záznamů odeslaných na kolektor
+		std::uint32_t nFlowsSeen = 0;
+
+		/// @brief IPFIX záznamy čekající na zaplnění zprávy; [0] IPv4, [1] IPv6 (každá verze má vlastní datový set)
+		std::array<std::vector<FlowRecord>, 2> ipfixPending;
+
+		/// @brief Čas (ms), od kdy v `ipfixPending` čekají záznamy
+		std::uint64_t ipfixPendingSince = 0;
+
+		/// @brief Počet odeslaných IPFIX zpráv (pro periodické opakování šablon)
+		std::uint64_t ipfixMessages = 0;
+
+		/// @brief Záznamy přidělené kolektoru v aktuálním exportu (znovupoužitelný buffer)
+		std::vector<FlowRecord> records;
 	};
 
 	/**
@@ -110,30 +115,63 @@ namespace Netflow
 	class NetflowExporter
 	{
 	public:
+		/// @brief Maximální velikost dávky paketů
+		static constexpr std::uint32_t MaxBurstSize = 4096;
+
 		/**
 		 * @brief Konstruktor
 		 * 
-		 * @param file jméno analyzovaného souboru nebo STDIN
-		 * @param collectorIp IP adresa, nebo hostname NetFlow kolektoru
-		 * @param collectorPort UDP port netflow kolektoru
-		 * @param activeTimer interval v sekundách, po kterém se exportují aktivní záznamy na kolektor
-		 * @param interval interval v sekundách, po jehož vypršení se exportují neaktivní záznamy na kolektor
-		 * @param flowCacheSize velikost flow-cache. Při dosažení max. velikosti dojde k exportu nejstaršího záznamu v cachi na kolektor
+		 * @param files analyzované soubory a adresáře (nebo "-" pro STDIN); více souborů se čte paralelně a slévá podle času
+		 * @param collectors NetFlow kolektory; při více kolektorech se flow rozdělují konzistentním hashováním klíče
+		 * @param config časovače, velikost flow-cache, počet vláken a velikost dávky paketů
+		 * @param batch prahy pro dávkové odesílání datagramů na kolektor
+		 * @param exportConfig formát exportu
+		 * @param sampling vzorkování paketů před flow-cache
+		 * @param statsConfig výpis statistik
+		 * @param inputConfig časový rozsah a dělení vstupu
+		 * @param aggregation agregace záznamů před exportem
 		 */
-		NetflowExporter(const std::string & file, const std::string & collectorIp, std::uint32_t collectorPort, std::uint32_t activeTimer,
-			std::uint32_t interval, std::uint32_t flowCacheSize);
+		NetflowExporter(const std::vector<std::string> & files, const std::vector<CollectorEndpoint> & collectors,
+			const ExporterConfig & config, const BatchConfig & batch, const ExportConfig & exportConfig, const SamplingConfig & sampling,
+			const StatsConfig & statsConfig = StatsConfig {}, const InputConfig & inputConfig = InputConfig {},
+			const AggregationConfig & aggregation = AggregationConfig {});
 
 		/**
 		 * @brief Spustí netflow exportér
+		 *
+		 * @return true vstupy byly zpracovány
+		 * @return false exportér nezačal - nepodařilo se otevřít vstup nebo připojit kolektor (zalogováno)
 		 */
-		void Run();
-	private:
-		/// @brief Ip adresa/hostname netflow koletoru
-		const std::string & _collectorIp;
+		bool Run();
 
-		/// @brief Port netflow kolektoru
-		const std::uint32_t _collectorPort;
+		/**
+		 * @brief Požadavek na ukončení s checkpointem (bezpečné volat z obsluhy signálu). Čtení skončí jako na konci vstupu
+		 * a otevřené záznamy se místo exportu uloží do `InputConfig::checkpointPath`.
+		 */
+		static void RequestCheckpoint();
+
+		/**
+		 * @brief Naparsuje paket. Hlavičky, které nejsou zachycené celé, se nečtou (MalformedIp / MalformedL4).
+		 * 
+		 * @param packet paket
+		 * @param caplen počet zachycených bytů paketu
+		 * @return ParsedPacket zpracovaný packet
+		 */
+		static ParsedPacket ParsePacket(const std::uint8_t * packet, std::uint32_t caplen);
 
+		/**
+		 * @brief Exportuje flow záznamy na kolektor zvoleným formátem a vyprázdní `records`. Při agregaci se záznamy
+		 * nejdřív přidají do `_aggregator` a exportují se agregované záznamy, kterým vypršel timeout.
+		 * 
+		 * @param records záznamy k exportu
+		 */
+		void ExportFlows(std::vector<FlowRecord> & records);
+
+		/**
+		 * @brief Odešle záznamy čekající na zaplnění IPFIX zprávy a všechny datagramy v dávce
+		 */
+		void FlushExports();
+	private:
 		/// @brief Netflow active timer
 		const std::uint32_t _activeTimer;
 
@@ -143,97 +181,279 @@ namespace Netflow
 		/// @brief Netflow velikost flow cache
 		const std::uint32_t _flowCacheSize;
 
-		/// @brief Reader pro čtení pcap souboru/čtení z stdin
-		Reader _reader;
+		/// @brief Granularita časovacího kola (ms)
+		const std::uint32_t _timerGranularity;
+
+		/// @brief Inactive timer ukončených TCP spojení (0 = ukončení se nesleduje)
+		const std::uint32_t _tcpCloseGrace;
+
+		/// @brief Počet vláken s flow-cache
+		const std::uint32_t _nThreads;
+
+		/// @brief Počet paketů zpracovaných najednou
+		const std::uint32_t _burstSize;
+
+		/// @brief Formát exportu
+		const ExportFormat _format;
+
+		/// @brief Max. velikost IPFIX zprávy (odvozená z MTU)
+		const std::uint32_t _ipfixMessageSize;
+
+		/// @brief Vzorkování paketů (v jediném vlákně, které čte pakety)
+		PacketSampler _sampler;
+
+		/// @brief Statistiky
+		ExporterStats _stats;
+
+		/// @brief Cíl exportu místo kolektoru (nullptr = export na kolektor)
+		std::unique_ptr<FlowSink> _sink;
+
+		/// @brief Agregace záznamů před exportem (nullptr = bez agregace)
+		std::unique_ptr<FlowAggregator> _aggregator;
+
+		/// @brief Reader pro čtení pcap souboru/čtení z stdin (při jediném vstupu)
+		std::unique_ptr<Reader> _reader;
+
+		/// @brief Paralelní čtení a slévání více souborů (při více vstupech)
+		std::unique_ptr<MultiFileReader> _multiReader;
+
+		/// @brief BPF filtr vstupu (nullptr = bez filtru)
+		const std::shared_ptr<const BpfFilter> _filter;
+
+		/// @brief Soubor zpracovávaný po částech (při `inputConfig.slices` > 1)
+		std::string _sliceFile;
+
+		/// @brief Časově navazující části `_sliceFile` (prázdné = bez dělení)
+		std::vector<ReadRange> _slices;
 
-		/// @brief Třída pro inicializaci socketu a zasílání dat do kolektoru
-		CollectorConnection _collector;
+		/// @brief Cesta pro uložení checkpointu (prázdné = bez checkpointu)
+		const std::string _checkpointPath;
+
+		/// @brief Checkpoint k obnovení na začátku zpracování (nullptr = prázdná cache)
+		std::unique_ptr<FlowCheckpoint> _restore;
+
+		/// @brief Probouzí čtení na tichém vstupu, aby se expirované záznamy exportovaly i bez paketů (nullptr = čas jen z paketů)
+		std::unique_ptr<FlushTimer> _flushTimer;
+
+		/// @brief Čas posledního přečteného paketu (při `_flushTimer`)
+		timeval _lastPacketTs {};
+
+		/// @brief Kdy byl přečten poslední paket (při `_flushTimer`)
+		std::chrono::steady_clock::time_point _lastPacketClock {};
+
+		/// @brief Export na jednotlivé kolektory
+		std::vector<ExportStream> _streams;
+
+		/// @brief Rozdělení flow mezi kolektory (nullptr = jediný kolektor)
+		std::unique_ptr<HashRing> _ring;
 
 		/// @brief Čas příchodu prvního packetu - představuje čas startu exporteru
-		timeval _startTs;
+		timeval _startTs {};
 
 		/// @brief Současný čas
-		timeval _currentTime;
+		timeval _currentTime {};
 
-		/// @brief Počet flow záznamů, které jsme odeslali
-		uint32_t _nFlowsSeen = 0;
+		/// @brief Buffer pro serializaci jednoho datagramu (znovupoužitelný)
+		std::vector<std::uint8_t> _datagram;
 
-		/// @brief Existující flow záznamy. Vector - stejně bude nutné procházet všechny při příchodu nového záznamu
-		std::vector<FlowRecord> _flows;
+		/**
+		 * @brief Hlavní smyčka - získávání dat z `_reader`/`_multiReader` a zasílání do kolektoru. Pakety se zpracovávají po dávkách
+		 * (`_burstSize`): nejdřív se celá dávka naparsuje, pak se vyexpirují záznamy (jednou za dávku), přednačtou
+		 * položky flow tabulky pro všechny klíče dávky, aplikují aktualizace a nakonec se exportuje.
+		 */
+		void Loop();
 
-		/// @brief Záznamy připravené k exportu
-		std::vector<NetflowV5FlowRecord> _toExport;
+		/**
+		 * @brief Hlavní smyčka pro více vláken. Čtecí vlákno rozděluje pakety podle hashe klíče mezi `_nThreads` vláken,
+		 * z nichž každé má vlastní FlowCache. Expirované záznamy se z nich sbírají a odesílají v tomto vlákně (jediný
+		 * serializátor - `flowSequence` zůstává monotónní).
+		 */
+		void LoopSharded();
 
 		/**
-		 * @brief Hlavní smyčka - získávání dat z `_reader` a zasílání do kolektoru
+		 * @brief Hlavní smyčka pro soubor rozdělený na části (`_slices`). Každou část zpracuje samostatné vlákno s vlastní
+		 * FlowCache. Záznamy, které mohou pokračovat přes hranici částí (otevřené na konci části a vzniklé krátce po začátku
+		 * následující), se po skončení všech vláken spojí; ostatní se odesílají průběžně.
 		 */
-		void Loop();
+		void LoopSliced();
 
 		/**
-		 * @brief Naparsuje paket
+		 * @brief Načte a naparsuje až `_burstSize` paketů ze `_reader` nebo `_multiReader` a aplikuje vzorkování
 		 * 
-		 * @param packet paket
-		 * @return ParsedPacket zpracovaný packet
+		 * @param stats statistiky volajícího vlákna
+		 * @param out výstupní pakety (alespoň `_burstSize`)
+		 * @param idle nastaví se, pokud čtení přerušil `_flushTimer` (dávka může být neúplná i prázdná)
+		 * @return std::uint32_t počet načtených paketů; 0 bez `idle` = konec vstupu
 		 */
-		ParsedPacket ParsePacket(const std::uint8_t * packet);
+		std::uint32_t ReadBurst(StatsBlock & stats, InputPacket * out, bool & idle);
 
 		/**
-		 * @brief Přidá nový záznam do existujícího flow záznamu nebo vytvoří nový
+		 * @brief Čas exportéru na tichém vstupu - čas posledního paketu posunutý o dobu, která od jeho přečtení uplynula
 		 * 
-		 * @param pkt paket
+		 * @return timeval odhad času vstupu
 		 */
-		void AddNewRecord(const ParsedPacket & pkt);
+		timeval IdleTime() const;
 
 		/**
-		 * @brief Aktualizuje hodnoty ve flow záznamu daty z příchozího paketu
+		 * @brief Po přerušení čtení `_flushTimer` (bez nových paketů) exportuje záznamy, jejichž export je podle
+		 * IdleTime() na řadě (z cache a agregace), a odešle neúplnou IPFIX zprávu a dávku datagramů
 		 * 
-		 * @param pkt paket
-		 * @param record záznam
+		 * @param cache flow-cache
 		 */
-		void AddPacketToFlow(const ParsedPacket & pkt, FlowRecord & record);
+		void FlushIdle(FlowCache & cache);
 
 		/**
-		 * @brief Vytvoří nový flow záznam z paketu a přidá ho do `_flows`
+		 * @brief Shard, do kterého patří flow (stejná flow -> stejný shard)
 		 * 
+		 * @param key klíč flow
+		 * @param hash `key.Hash()`
+		 * @param nShards počet shardů
+		 * @return std::uint32_t index shardu
+		 */
+		std::uint32_t ShardFor(const FlowKey & key, std::uint64_t hash, std::uint32_t nShards) const;
+
+		/**
+		 * @brief Zda se má místo exportu otevřených záznamů uložit checkpoint (byl o něj požádán a je kam ho uložit)
+		 */
+		bool CheckpointPending() const;
+
+		/**
+		 * @brief Obnoví záznamy z `_restore` do flow-cache (při více shardech podle ShardFor()), čas startu a sekvenční
+		 * čísla kolektorů; záznamy vyřazené z plné cache exportuje. Checkpoint se pak smaže, aby se stejné záznamy
+		 * neobnovily dvakrát.
+		 * 
+		 * @param caches flow-cache shardů (jediná bez shardů)
+		 */
+		void RestoreCheckpoint(const std::vector<FlowCache *> & caches);
+
+		/**
+		 * @brief Uloží otevřené záznamy flow-cache, čas startu a sekvenční čísla kolektorů do `_checkpointPath`
+		 * 
+		 * @param caches flow-cache shardů (jediná bez shardů)
+		 */
+		void SaveCheckpoint(const std::vector<FlowCache *> & caches);
+
+		/**
+		 * @brief Naparsuje paket, započítá ho do statistik a aplikuje vzorkování
+		 * 
+		 * @param packet data paketu
+		 * @param caplen počet zachycených bytů paketu
+		 * @param ts čas příchodu paketu
+		 * @param stats statistiky volajícího vlákna
+		 * @param out výstupní paket pro flow-cache
+		 * @return true paket se má přidat do flow-cache
+		 * @return false paket se zahodí (důvod je ve statistikách)
+		 */
+		bool ParseAndSample(const std::uint8_t * packet, std::uint32_t caplen, const timeval & ts, StatsBlock & stats, FlowPacket & out);
+
+		/**
+		 * @brief Naparsuje paket a započítá ho do statistik, bez vzorkování (thread-safe - pro vlákna souborů)
+		 * 
+		 * @param packet data paketu
+		 * @param caplen počet zachycených bytů paketu
+		 * @param ts čas příchodu paketu
+		 * @param stats statistiky volajícího vlákna
+		 * @param out výstupní paket pro flow-cache
+		 * @return true paket je exportovatelný
+		 * @return false paket se zahodí (důvod je ve statistikách)
+		 */
+		bool ParseFlowPacket(const std::uint8_t * packet, std::uint32_t caplen, const timeval & ts, StatsBlock & stats,
+			FlowPacket & out) const;
+
+		/**
+		 * @brief Aplikuje vzorkování na naparsovaný paket
+		 * 
+		 * @param sampler vzorkování (deterministické má stav - každé vlákno potřebuje vlastní)
 		 * @param pkt paket
+		 * @param stats statistiky volajícího vlákna
+		 * @return true paket se má přidat do flow-cache
+		 * @return false paket nebyl vybrán
 		 */
-		void CreateNewFlow(const ParsedPacket & pkt);
+		static bool Sample(PacketSampler & sampler, const FlowPacket & pkt, StatsBlock & stats);
 
 		/**
-		 * @brief Zkontroluje timery (inactive + active) a pokud je to nutné, tak záznam připraví k exportu (SaveFlowExport())
+		 * @brief Započítá výsledek parsování do statistik
 		 * 
-		 * @param record záznam
-		 * @return true záznam byl připraven k exportu
-		 * @return false záznam nebyl připraven k exportu
+		 * @param parsed zpracovaný paket
+		 * @param stats statistiky volajícího vlákna
+		 * @return true paket lze přidat do flow-cache
+		 * @return false paket se zahodí
 		 */
-		bool TryFlowExport(FlowRecord & record);
+		bool AcceptParsed(const ParsedPacket & parsed, StatsBlock & stats) const;
 
 		/**
-		 * @brief Uloží záznam do `_toExport` - připraven k exportu
+		 * @brief Zda lze paket exportovat zvoleným formátem (v5 pouze IPv4, IPFIX i IPv6)
 		 * 
-		 * @param record záznam
+		 * @param pkt zpracovaný paket
+		 * @return true paket se přidá do flow-cache
+		 * @return false paket se zahodí
 		 */
-		void SaveFlowExport(FlowRecord & record);
+		bool IsExportable(const ParsedPacket & pkt) const;
+
 
 		/**
-		 * @brief Exportuje flow záznamy uložené v `_toExport` na kolektor
+		 * @brief Serializuje záznamy zvoleným formátem (bez agregace), případně je zapíše do `_sink`, a vyprázdní `records`
+		 * 
+		 * @param records záznamy k exportu
 		 */
-		void ExportFlows();
+		void ExportRecords(std::vector<FlowRecord> & records);
 
 		/**
-		 * @brief Spočítá IPv4 checksum
+		 * @brief Exportuje agregované záznamy, kterým vypršel timeout (volá se i bez nových flow záznamů)
+		 */
+		void ExpireAggregates();
+
+		/**
+		 * @brief Serializuje záznamy zvoleným formátem pro jeden kolektor
 		 * 
-		 * @param iph ipv4 header
-		 * @return std::uint32_t checksum
+		 * @param stream kolektor
+		 * @param records záznamy k exportu
 		 */
-		std::uint32_t CalculateIpChecksum(const Ipv4Header * iph);
+		void ExportToStream(ExportStream & stream, const std::vector<FlowRecord> & records);
+
+		/**
+		 * @brief Exportuje flow záznamy jako Netflow v5 datagramy (zařadí je do dávky kolektoru)
+		 * 
+		 * @param stream kolektor
+		 * @param records záznamy k exportu (pouze IPv4)
+		 */
+		void ExportFlowsV5(ExportStream & stream, const std::vector<FlowRecord> & records);
+
+		/**
+		 * @brief Přidá záznamy k čekajícím IPFIX záznamům a odešle zaplněné zprávy
+		 * 
+		 * @param stream kolektor
+		 * @param records záznamy k exportu
+		 */
+		void ExportFlowsIpfix(ExportStream & stream, const std::vector<FlowRecord> & records);
+
+		/**
+		 * @brief Sestaví IPFIX zprávy z `ipfixPending` a zařadí je do dávky kolektoru. Neúplnou zprávu odešle,
+		 * pouze pokud `force` nebo záznamy čekají déle než IpfixMaxHoldMs.
+		 * 
+		 * @param stream kolektor
+		 * @param force odeslat i neúplnou zprávu
+		 */
+		void SendIpfixMessages(ExportStream & stream, bool force);
+
+		/**
+		 * @brief Odešle dávky datagramů všech kolektorů
+		 * 
+		 * @param onlyDue pouze dávky čekající déle než `BatchConfig::maxDelayMs`
+		 */
+		void FlushCollectors(bool onlyDue);
 
 		/**
-		 * @brief Převede timeval na sekundy
+		 * @brief Součet statistik odesílání všech kolektorů
+		 */
+		SendStats CollectorStats() const;
+
+		/**
+		 * @brief Spočítá IPv4 checksum
 		 * 
-		 * @param t timeval
-		 * @return uint32_t sekundy
+		 * @param iph ipv4 header
+		 * @return std::uint32_t checksum
 		 */
-		static double TimevalToSec(const timeval & t);
+		std::uint32_t CalculateIpChecksum(const Ipv4Header * iph);
 	};
 } // namespace Netflow
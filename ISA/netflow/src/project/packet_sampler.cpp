@@ -0,0 +1,33 @@
+/**
+ * @file packet_sampler.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "packet_sampler.h"
+
+#include <algorithm>
+
+namespace Netflow
+{
+	PacketSampler::PacketSampler(const SamplingConfig & config)
+		: _mode(config.interval > 1 ? config.mode : SamplingMode::None), _interval(std::max<std::uint32_t>(config.interval, 1))
+	{
+	}
+
+	std::uint16_t PacketSampler::V5SamplingInterval() const
+	{
+		std::uint16_t mode = 0;
+		switch (_mode) {
+		case SamplingMode::Deterministic:
+			mode = 1;
+			break;
+		case SamplingMode::Hash:
+			mode = 2;
+			break;
+		default:
+			return 0;
+		}
+		return static_cast<std::uint16_t>((mode << 14) | std::min(_interval, MaxV5Interval));
+	}
+} // namespace Netflow
@@ -0,0 +1,129 @@
+/**
+ * @file packet_sampler.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Vzorkování paketů před flow-cache
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace Netflow
+{
+	/**
+	 * @brief Režim vzorkování
+	 */
+	enum class SamplingMode
+	{
+		None,          ///< Zpracují se všechny pakety
+		Deterministic, ///< Každý N-tý paket
+		Hash           ///< Všechny pakety 1/N flow vybraných podle hashe klíče
+	};
+
+	/**
+	 * @brief Nastavení vzorkování
+	 */
+	struct SamplingConfig
+	{
+		SamplingMode mode {SamplingMode::None};
+		std::uint32_t interval {1}; ///< N - vybírá se 1 z N paketů/flow
+	};
+
+	/**
+	 * @brief Vzorkovač paketů. Rozhoduje, zda paket projde do flow-cache; nevybrané pakety se do cache vůbec nedostanou.
+	 * SelectPacket() se volá před vytvořením FlowPacket (deterministický režim tak ušetří i výpočet klíče),
+	 * SelectFlow() s hashem klíče.
+	 *
+	 * Instance není thread-safe (deterministický režim má čítač).
+	 */
+	class PacketSampler
+	{
+	public:
+		/// @brief Maximální interval, který lze zakódovat do `NetflowV5Header::samplingInterval` (14 bitů)
+		static constexpr std::uint32_t MaxV5Interval = 0x3FFF;
+
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param config nastavení vzorkování (interval 0 se bere jako 1)
+		 */
+		PacketSampler(const SamplingConfig & config);
+
+		/**
+		 * @brief Deterministické vzorkování - vybere každý N-tý paket. V ostatních režimech vždy true.
+		 *
+		 * @return true paket je vybrán
+		 * @return false paket se zahodí
+		 */
+		bool SelectPacket()
+		{
+			if (_mode != SamplingMode::Deterministic) {
+				return true;
+			}
+			if (--_countdown == 0) {
+				_countdown = _interval;
+				return true;
+			}
+			return false;
+		}
+
+		/**
+		 * @brief Vzorkování podle hashe - vybere pakety flow, jejichž hash padne do 1/N prostoru hashů.
+		 * V ostatních režimech vždy true.
+		 *
+		 * @param hash hash klíče (FlowKey::Hash()); použije se dolních 32 bitů
+		 * @return true paket je vybrán
+		 * @return false paket se zahodí
+		 */
+		bool SelectFlow(std::uint64_t hash) const
+		{
+			if (_mode != SamplingMode::Hash) {
+				return true;
+			}
+			// hash ještě promícháme - jeho horní bity vybírají shard a dolní pozici ve flow tabulce,
+			// vybrané flow se tak nesoustředí do jednoho shardu ani části tabulky
+			std::uint32_t h = static_cast<std::uint32_t>(hash);
+			h ^= h >> 16;
+			h *= 0x85EBCA6BU;
+			h ^= h >> 13;
+			return ((static_cast<std::uint64_t>(h) * _interval) >> 32) == 0;
+		}
+
+		/**
+		 * @brief Hodnota pole `samplingInterval` Netflow v5 hlavičky - horní 2 bity režim (1 = deterministický,
+		 * 2 = náhodný; vzorkování podle hashe je pro kolektor náhodné), dolních 14 bitů interval
+		 *
+		 * @return std::uint16_t zakódovaný režim a interval
+		 */
+		std::uint16_t V5SamplingInterval() const;
+
+		/**
+		 * @brief Režim vzorkování
+		 *
+		 * @return SamplingMode režim
+		 */
+		SamplingMode Mode() const
+		{
+			return _mode;
+		}
+
+		/**
+		 * @brief Interval vzorkování
+		 *
+		 * @return std::uint32_t N
+		 */
+		std::uint32_t Interval() const
+		{
+			return _interval;
+		}
+	private:
+		/// @brief Režim
+		const SamplingMode _mode;
+
+		/// @brief Interval (N)
+		const std::uint32_t _interval;
+
+		/// @brief Počet paketů do dalšího vybraného (deterministický režim); první paket je vybrán
+		std::uint32_t _countdown = 1;
+	};
+} // namespace Netflow
@@ -0,0 +1,84 @@
+/**
+ * @file packet_source.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Rozhraní zdroje paketů
+ */
+
+#pragma once
+
+#include <pcap.h>
+
+#include <cstdint>
+
+namespace Netflow
+{
+	/**
+	 * @brief Paket přečtený z pcap souboru
+	 */
+	struct Packet
+	{
+		pcap_pkthdr * pktHeader {nullptr};      ///< Metadata z pcap souboru
+		const std::uint8_t * pktData {nullptr}; ///< Data paketu
+	};
+
+	/**
+	 * @brief Zdroj paketů (backend pro Reader). Vrácený paket je platný do dalšího volání GetNextPacket().
+	 */
+	class PacketSource
+	{
+	public:
+		virtual ~PacketSource() = default;
+
+		/**
+		 * @brief Vrátí další paket
+		 * 
+		 * @return Packet paket; pktHeader a pktData jsou nullptr na konci dat nebo při chybě
+		 */
+		virtual Packet GetNextPacket() = 0;
+
+		/**
+		 * @brief Přesune čtení na záznam začínající na daném offsetu souboru (viz PcapIndex)
+		 * 
+		 * @param offset offset hlavičky záznamu
+		 * @return true čtení pokračuje od `offset`
+		 * @return false zdroj přesun nepodporuje nebo je offset mimo soubor
+		 */
+		virtual bool Seek(std::uint64_t offset)
+		{
+			(void)offset;
+			return false;
+		}
+
+		/**
+		 * @brief Offset záznamu, který vrátí příští GetNextPacket()
+		 * 
+		 * @return std::uint64_t offset; 0, pokud ho zdroj nezná
+		 */
+		virtual std::uint64_t Offset() const
+		{
+			return 0;
+		}
+
+		/**
+		 * @brief Zda GetNextPacket() může čekat na příchod dat (stdin, živé zachytávání)
+		 */
+		virtual bool IsLive() const
+		{
+			return false;
+		}
+
+		/**
+		 * @brief Počká, až GetNextPacket() vrátí paket (nebo konec dat) bez čekání, nejdéle však do chvíle,
+		 * kdy je čitelný `wakeFd`. Data paketu vráceného předchozím GetNextPacket() mohou přestat platit.
+		 * 
+		 * @param wakeFd deskriptor, který čekání přeruší (FlushTimer)
+		 * @return true data jsou připravena
+		 * @return false čekání přerušil `wakeFd` nebo signál
+		 */
+		virtual bool WaitReadable(int wakeFd)
+		{
+			(void)wakeFd;
+			return true;
+		}
+	};
+} // namespace Netflow
@@ -0,0 +1,169 @@
+/**
+ * @file pcap_index.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "pcap_index.h"
+#include "mmap_pcap_source.h"
+#include "flow_record.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <sys/stat.h>
+
+#include "logger/logger.hpp"
+
+namespace
+{
+	/// @brief Verze formátu indexu
+	constexpr std::uint32_t IndexVersion = 1;
+
+	/**
+	 * @brief Hlavička souboru s indexem
+	 */
+	struct IndexHeader
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t every;
+		std::uint32_t reserved;
+		std::uint64_t pcapSize;  ///< Velikost pcap souboru při indexaci
+		std::uint64_t nEntries;
+	};
+
+	/// @brief Magic number indexu
+	constexpr char IndexMagic[4] = {'N', 'F', 'I', 'X'};
+} // namespace
+
+namespace Netflow
+{
+	bool PcapIndex::Build(const std::string & file, std::uint32_t every)
+	{
+		every = std::max<std::uint32_t>(every, 1);
+		auto source = MmapPcapSource::Open(file);
+		if (!source) {
+			Logger::LogError<>("Can't index " + file + ": only regular files in the classic pcap format are supported");
+			return false;
+		}
+
+		std::vector<PcapIndexEntry> entries;
+		std::uint64_t maxTsUs = 0;
+		std::uint64_t packets = 0;
+		while (true) {
+			if (packets % every == 0) {
+				entries.push_back({maxTsUs, source->Offset()});
+			}
+			const Packet p = source->GetNextPacket();
+			if (p.pktHeader == nullptr) {
+				break;
+			}
+			maxTsUs = std::max(maxTsUs, TimevalToUs(p.pktHeader->ts));
+			packets++;
+		}
+
+		struct stat st {};
+		stat(file.c_str(), &st);
+
+		IndexHeader header {};
+		std::memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+		header.version = IndexVersion;
+		header.every = every;
+		header.pcapSize = st.st_size;
+		header.nEntries = entries.size();
+
+		// zapíšeme vedle a přejmenujeme - čtenář nikdy neuvidí poloviční index
+		const std::string path = PathFor(file);
+		const std::string tmpPath = path + ".tmp";
+		{
+			std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(PcapIndexEntry));
+			if (!out) {
+				Logger::LogError<>("Couldn't write " + tmpPath);
+				std::remove(tmpPath.c_str());
+				return false;
+			}
+		}
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+			Logger::LogError<>("Couldn't rename " + tmpPath + " to " + path);
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+
+		Logger::LogInfo<>("Indexed " + std::to_string(packets) + " packets of " + file + " into " + path + " ("
+			+ std::to_string(entries.size()) + " entries)");
+		return true;
+	}
+
+	std::unique_ptr<PcapIndex> PcapIndex::Load(const std::string & file)
+	{
+		const std::string path = PathFor(file);
+		std::ifstream in(path, std::ios::binary);
+		if (!in) {
+			return nullptr;
+		}
+
+		IndexHeader header {};
+		in.read(reinterpret_cast<char *>(&header), sizeof(header));
+		if (!in || std::memcmp(header.magic, IndexMagic, sizeof(IndexMagic)) != 0 || header.version != IndexVersion
+				|| header.nEntries == 0) {
+			Logger::LogWarning<>("Ignoring invalid index " + path);
+			return nullptr;
+		}
+
+		// pcap soubor se může jen prodlužovat (zachytávání stále běží); index pak pokrývá jeho začátek
+		struct stat st {};
+		if (stat(file.c_str(), &st) != 0 || static_cast<std::uint64_t>(st.st_size) < header.pcapSize) {
+			Logger::LogWarning<>("Ignoring stale index " + path);
+			return nullptr;
+		}
+
+		// počet položek z hlavičky se před alokací ověří proti velikosti souboru s indexem
+		struct stat indexSt {};
+		if (stat(path.c_str(), &indexSt) != 0
+				|| (static_cast<std::uint64_t>(indexSt.st_size) - sizeof(header)) / sizeof(PcapIndexEntry) < header.nEntries) {
+			Logger::LogWarning<>("Ignoring truncated index " + path);
+			return nullptr;
+		}
+
+		std::unique_ptr<PcapIndex> index(new PcapIndex());
+		index->_entries.resize(header.nEntries);
+		in.read(reinterpret_cast<char *>(index->_entries.data()), header.nEntries * sizeof(PcapIndexEntry));
+		if (!in) {
+			Logger::LogWarning<>("Ignoring truncated index " + path);
+			return nullptr;
+		}
+
+		// EntryFor() a EndEntryFor() vyhledávají binárně, Reader se posouvá na offsety položek
+		for (std::size_t i = 0; i < index->_entries.size(); i++) {
+			const PcapIndexEntry & e = index->_entries[i];
+			if (e.offset > header.pcapSize
+					|| (i > 0 && (e.offset < index->_entries[i - 1].offset || e.maxTsUs < index->_entries[i - 1].maxTsUs))) {
+				Logger::LogWarning<>("Ignoring invalid index " + path);
+				return nullptr;
+			}
+		}
+		return index;
+	}
+
+	std::size_t PcapIndex::EntryFor(std::uint64_t fromUs) const
+	{
+		// maxTsUs je neklesající; hledáme poslední položku, před kterou jsou jen pakety s časem < fromUs
+		const auto it = std::lower_bound(_entries.begin(), _entries.end(), fromUs, [](const PcapIndexEntry & e, std::uint64_t ts) {
+			return e.maxTsUs < ts;
+		});
+		return it == _entries.begin() ? 0 : static_cast<std::size_t>(it - _entries.begin()) - 1;
+	}
+
+	std::size_t PcapIndex::EndEntryFor(std::uint64_t toUs) const
+	{
+		const auto it = std::lower_bound(_entries.begin(), _entries.end(), toUs, [](const PcapIndexEntry & e, std::uint64_t ts) {
+			return e.maxTsUs < ts;
+		});
+		return it - _entries.begin();
+	}
+} // namespace Netflow
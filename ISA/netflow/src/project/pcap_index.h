@@ -0,0 +1,98 @@
+/**
+ * @file pcap_index.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Časový index pcap souboru (sidecar soubor) - převod času na offset záznamu
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Položka indexu
+	 */
+	struct PcapIndexEntry
+	{
+		std::uint64_t maxTsUs; ///< Nejvyšší čas (µs od epochy) ze všech paketů před `offset`; 0 pro první položku
+		std::uint64_t offset;  ///< Offset hlavičky záznamu v pcap souboru
+	};
+
+	/**
+	 * @brief Časový index klasického pcap souboru. Ukládá se vedle souboru (`<soubor>.nfidx`) a obsahuje offset
+	 * každého N-tého záznamu spolu s nejvyšším časem paketů před ním. Díky tomu lze začít číst od zadaného času
+	 * bez procházení celého souboru (i když pakety nejsou přesně seřazené) a rozdělit soubor na části.
+	 *
+	 * Formát: hlavička (magic "NFIX", verze, N, velikost pcap souboru, počet položek), pak položky;
+	 * hodnoty jsou v pořadí bytů stroje, který index vytvořil.
+	 */
+	class PcapIndex
+	{
+	public:
+		/// @brief Výchozí počet paketů mezi položkami indexu
+		static constexpr std::uint32_t DefaultEvery = 10000;
+
+		/**
+		 * @brief Cesta k indexu pcap souboru
+		 *
+		 * @param file pcap soubor
+		 * @return std::string cesta k indexu
+		 */
+		static std::string PathFor(const std::string & file)
+		{
+			return file + ".nfidx";
+		}
+
+		/**
+		 * @brief Projde pcap soubor a zapíše jeho index
+		 *
+		 * @param file pcap soubor (pouze klasický pcap, ne pcapng/stdin)
+		 * @param every počet paketů mezi položkami
+		 * @return true index byl zapsán
+		 * @return false chyba (zalogována)
+		 */
+		static bool Build(const std::string & file, std::uint32_t every);
+
+		/**
+		 * @brief Načte index pcap souboru
+		 *
+		 * @param file pcap soubor
+		 * @return std::unique_ptr<PcapIndex> index nebo nullptr, pokud neexistuje, je poškozený nebo je soubor menší,
+		 * než byl při indexaci
+		 */
+		static std::unique_ptr<PcapIndex> Load(const std::string & file);
+
+		/**
+		 * @brief Poslední položka, od jejíhož offsetu lze číst, aby se nevynechal žádný paket s časem >= `fromUs`
+		 *
+		 * @param fromUs čas v µs
+		 * @return std::size_t index položky v Entries()
+		 */
+		std::size_t EntryFor(std::uint64_t fromUs) const;
+
+		/**
+		 * @brief První položka, za kterou (u seřazeného souboru) leží už jen pakety s časem >= `toUs`
+		 *
+		 * @param toUs čas v µs
+		 * @return std::size_t index položky v Entries(); Entries().size(), pokud taková není
+		 */
+		std::size_t EndEntryFor(std::uint64_t toUs) const;
+
+		/**
+		 * @brief Položky indexu (seřazené podle offsetu)
+		 *
+		 * @return const std::vector<PcapIndexEntry>& položky
+		 */
+		const std::vector<PcapIndexEntry> & Entries() const
+		{
+			return _entries;
+		}
+	private:
+		/// @brief Položky
+		std::vector<PcapIndexEntry> _entries;
+	};
+} // namespace Netflow
@@ -5,54 +5,345 @@
  */
 
 #include "pcap_reader.h"
+#include "mmap_pcap_source.h"
+#include "pcap_index.h"
+#include "flow_record.h"
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #include "logger/logger.hpp"
 
 namespace Netflow
 {
-	Reader::Reader(const std::string & file) : _file(file)
+	/**
+	 * @brief Stdin čtený vlastním vláknem. Vlákno volá pcap_next_ex() a kopie paketů vkládá do `queue`; konzument
+	 * (PcapSource) je vybírá. Vlákno drží vlastní referenci - pokud při zániku zdroje čeká v read(), doběhne samo
+	 * (nebo skončí s procesem) a `pcap` uzavře poslední reference.
+	 */
+	struct PcapSource::StdinStream
 	{
-		OpenPcapFile();
-	}
+		/// @brief Kapacita fronty (paketů)
+		static constexpr std::uint32_t QueueCapacity = 1024;
+
+		/// @brief Kolikrát konzument při prázdné frontě přenechá procesor, než usne na `eventFd`
+		static constexpr std::uint32_t WaitSpins = 16;
+
+		/**
+		 * @brief Paket zkopírovaný z bufferu libpcap (kopie vektoru znovu použije jeho kapacitu)
+		 */
+		struct StreamPacket
+		{
+			pcap_pkthdr header {};
+			std::vector<std::uint8_t> data {};
+			bool end = false; ///< konec dat nebo chyba čtení
+		};
+
+		StdinStream(pcap_t * pcap) : pcap(pcap), queue(QueueCapacity), eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+		{
+		}
+
+		~StdinStream()
+		{
+			if (eventFd != -1) {
+				close(eventFd);
+			}
+			pcap_close(pcap);
+		}
+
+		pcap_t * const pcap;
+		SpscQueue<StreamPacket> queue;
+		const int eventFd;                 ///< Čitelný po vložení do fronty, na které konzument čeká
+		std::atomic<bool> waiting {false}; ///< Konzument čeká na `eventFd`
+		std::atomic<bool> stop {false};    ///< Zdroj zanikl
 
-	void Reader::OpenPcapFile()
+		// pouze konzument
+		StreamPacket current {};           ///< Paket vrácený z GetNextPacket()
+		StreamPacket next {};              ///< Vyjmutý, ještě nevrácený paket
+		bool hasNext = false;
+		bool finished = false;
+
+		/**
+		 * @brief Tělo čtecího vlákna
+		 */
+		void Read()
+		{
+			// signály obslouží ostatní vlákna - přerušené read() by libpcap ohlásil jako chybu (konec dat)
+			sigset_t all;
+			sigfillset(&all);
+			pthread_sigmask(SIG_BLOCK, &all, nullptr);
+
+			StreamPacket pkt;
+			while (!pkt.end && !stop.load(std::memory_order_relaxed)) {
+				pcap_pkthdr * header;
+				const std::uint8_t * data;
+				if (pcap_next_ex(pcap, &header, &data) == 1) {
+					pkt.header = *header;
+					pkt.data.assign(data, data + header->caplen);
+				}
+				else {
+					pkt.end = true;
+				}
+
+				while (!queue.TryPush(pkt)) {
+					if (stop.load(std::memory_order_relaxed)) {
+						return;
+					}
+					std::this_thread::yield();
+				}
+				// konzumenta budíme jen, když čeká (viz TryPopOrWait())
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (waiting.exchange(false)) {
+					const std::uint64_t one = 1;
+					(void)!write(eventFd, &one, sizeof(one));
+				}
+			}
+		}
+
+		/**
+		 * @brief Vyjme další paket do `next`, nebo počká na vlákno či `wakeFd`
+		 *
+		 * @param wakeFd deskriptor, který čekání přeruší (-1 = žádný)
+		 * @return true `next` obsahuje paket
+		 * @return false čekání přerušil `wakeFd` nebo signál
+		 */
+		bool TryPopOrWait(int wakeFd)
+		{
+			std::uint32_t spins = 0;
+			while (!hasNext) {
+				if (queue.TryPop(next)) {
+					hasNext = true;
+					break;
+				}
+				if (spins++ < WaitSpins) {
+					std::this_thread::yield();
+					continue;
+				}
+				if (eventFd == -1) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					continue;
+				}
+				// příznak nastavíme před druhou kontrolou fronty - vlákno ho po vložení uvidí a probudí nás
+				waiting.store(true);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (queue.TryPop(next)) {
+					waiting.store(false);
+					hasNext = true;
+					break;
+				}
+
+				pollfd fds[2] {{eventFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+				if (poll(fds, wakeFd != -1 ? 2 : 1, -1) < 0 && errno == EINTR) {
+					// signál (např. požadavek na checkpoint) - volající znovu zkontroluje, jestli má pokračovat
+					return false;
+				}
+				if (fds[0].revents & POLLIN) {
+					std::uint64_t count;
+					(void)!read(eventFd, &count, sizeof(count));
+				}
+				else if (wakeFd != -1 && fds[1].revents != 0) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	PcapSource::PcapSource(const std::string & file, const BpfFilter * filter) : _stream(file == "-")
 	{
 		char errbuf[PCAP_ERRBUF_SIZE];
 
-		_pcap = pcap_open_offline(_file.c_str(), errbuf);
+		_pcap = pcap_open_offline(file.c_str(), errbuf);
 		if (_pcap == nullptr) {
-			if (_file == "-") {
-				Logger::LogError<>("Couldn't read from stdin stream:");
+			if (file == "-") {
+				Logger::LogError<>(std::string("Couldn't read from stdin stream: ") + errbuf);
 			}
 			else {
-				Logger::LogError<>("Couldn't open " + _file + ":");
+				Logger::LogError<>("Couldn't open " + file + ": " + errbuf);
+			}
+			return;
+		}
+
+		if (filter != nullptr) {
+			bpf_program program = filter->Program();
+			_filtered = pcap_setfilter(_pcap, &program) == 0;
+			if (!_filtered) {
+				LOG_DEBUG("pcap_setfilter failed: " + std::string(pcap_geterr(_pcap)));
+			}
+		}
+
+		if (_stream) {
+			_stdin = std::make_shared<StdinStream>(_pcap);
+			if (_stdin->eventFd == -1) {
+				Logger::LogWarning<>("Couldn't create eventfd for stdin, polling for packets");
 			}
-			std::cerr << errbuf << "\n";
+			std::thread([stream = _stdin]() {
+				stream->Read();
+			}).detach();
 		}
 	}
 
-	std::uint64_t Reader::GetPacketCount()
+	PcapSource::~PcapSource()
 	{
-		return _packetCount;
+		if (_stdin) {
+			// vlákno může čekat v read() na stdin; uzavření `_pcap` nechá na poslední referenci
+			_stdin->stop.store(true, std::memory_order_relaxed);
+		}
+		else if (_pcap != nullptr) {
+			pcap_close(_pcap);
+		}
 	}
 
-	Packet Reader::GetNextPacket()
+	Packet PcapSource::GetNextPacket()
 	{
 		Packet pkt;
 		if (_pcap == nullptr) {
 			return pkt;
 		}
+		if (_stdin) {
+			StdinStream & stream = *_stdin;
+			if (stream.finished) {
+				return pkt;
+			}
+			while (!stream.TryPopOrWait(-1)) {
+			}
+			std::swap(stream.current, stream.next);
+			stream.hasNext = false;
+			if (stream.current.end) {
+				stream.finished = true;
+				return pkt;
+			}
+			pkt.pktHeader = &stream.current.header;
+			pkt.pktData = stream.current.data.data();
+			return pkt;
+		}
+
 		int err = pcap_next_ex(_pcap, &pkt.pktHeader, &pkt.pktData);
 
-		if (err == 1) {
-			_packetCount++;
-		}
-		else {
+		if (err != 1) {
 			pkt.pktData = nullptr;
 			pkt.pktHeader = nullptr;
 		}
 		return pkt;
 	}
 
-} // namespace Netflow
+	bool PcapSource::WaitReadable(int wakeFd)
+	{
+		// soubory (pcapng) nečekají; konec dat i chyba se ohlásí z GetNextPacket()
+		if (!_stdin || _stdin->finished) {
+			return true;
+		}
+		return _stdin->TryPopOrWait(wakeFd);
+	}
 
+	Reader::Reader(const std::string & file, const ReadRange & range, std::shared_ptr<const BpfFilter> filter)
+		: _file(file), _range(range)
+	{
+		OpenPcapFile(std::move(filter));
+		SeekToRange();
+	}
+
+	Reader::Reader(std::unique_ptr<PacketSource> source, const std::string & name)
+		: _file(name), _finished(source == nullptr), _opened(source != nullptr), _source(std::move(source))
+	{
+	}
+
+	void Reader::OpenPcapFile(std::shared_ptr<const BpfFilter> filter)
+	{
+		// klasický pcap soubor čteme přímo z paměti (filtr vyhodnocujeme sami); stdin a pcapng přes libpcap
+		if (_file != "-") {
+			_source = MmapPcapSource::Open(_file);
+			if (_source) {
+				Logger::LogInfo<>("Reading " + _file + " via mmap");
+				_seekable = true;
+				_opened = true;
+				_filter = std::move(filter);
+				return;
+			}
+		}
+		auto source = std::make_unique<PcapSource>(_file, filter.get());
+		if (filter && !source->HasFilter()) {
+			_filter = std::move(filter);
+		}
+		_opened = source->IsOpen();
+		_source = std::move(source);
+	}
+
+	std::uint64_t Reader::GetPacketCount()
+	{
+		return _packetCount;
+	}
+
+	void Reader::SeekToRange()
+	{
+		if (!_seekable) {
+			if (_range.startOffset != 0 || _range.fromUs != 0) {
+				LOG_DEBUG("Source can't seek, filtering " + _file + " by time");
+			}
+			return;
+		}
+
+		if (_range.startOffset != 0) {
+			_source->Seek(_range.startOffset);
+			return;
+		}
+		if (_range.fromUs == 0) {
+			return;
+		}
+
+		const auto index = PcapIndex::Load(_file);
+		if (!index) {
+			Logger::LogWarning<>("No index for " + _file + ", scanning from the start (see --index)");
+			return;
+		}
+		const std::uint64_t offset = index->Entries()[index->EntryFor(_range.fromUs)].offset;
+		if (_source->Seek(offset)) {
+			Logger::LogInfo<>("Skipping to offset " + std::to_string(offset) + " of " + _file + " using index");
+		}
+	}
+
+	Packet Reader::GetNextPacket()
+	{
+		while (!_finished) {
+			if (_seekable && _source->Offset() >= _range.endOffset) {
+				break;
+			}
+
+			Packet pkt = _source->GetNextPacket();
+			if (pkt.pktHeader == nullptr) {
+				return pkt;
+			}
+
+			const std::uint64_t ts = TimevalToUs(pkt.pktHeader->ts);
+			if (ts < _range.fromUs) {
+				continue;
+			}
+			if (ts >= _range.toUs) {
+				// pakety jsou jen přibližně seřazené - opožděné pakety s časem < toUs mohou ještě přijít
+				if (ts - _range.toUs >= ReadRange::ReorderSlackUs) {
+					break;
+				}
+				continue;
+			}
+			if (_filter && !_filter->Matches(pkt.pktData, pkt.pktHeader->len, pkt.pktHeader->caplen)) {
+				continue;
+			}
+			_packetCount++;
+			return pkt;
+		}
+
+		_finished = true;
+		return Packet {};
+	}
+
+} // namespace Netflow
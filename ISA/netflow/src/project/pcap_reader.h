@@ -9,23 +9,99 @@
 #include <pcap.h>
 
 #include "pcap_utils.h"
+#include "packet_source.h"
+#include "bpf_filter.h"
 
 #include <string>
 #include <cstdint>
+#include <memory>
 
 namespace Netflow
 {
 	/**
-	 * @brief Paket přečtený z pcap souboru
+	 * @brief Část souboru, kterou má Reader číst
 	 */
-	struct Packet
+	struct ReadRange
 	{
-		pcap_pkthdr * pktHeader {nullptr};      ///< Metadata z pcap souboru
-		const std::uint8_t * pktData {nullptr}; ///< Data paketu
+		/// @brief Bez omezení
+		static constexpr std::uint64_t NoLimit = UINT64_MAX;
+
+		/// @brief O kolik µs může paket předběhnout pozdější pakety (nepřesně seřazené zachytávání)
+		static constexpr std::uint64_t ReorderSlackUs = 1000000;
+
+		std::uint64_t fromUs {0};           ///< Pakety s dřívějším časem (µs od epochy) se přeskočí
+		std::uint64_t toUs {NoLimit};       ///< Pakety s časem >= toUs se přeskočí; čtení skončí u prvního s časem >= toUs + ReorderSlackUs
+		std::uint64_t startOffset {0};      ///< Offset záznamu, od kterého číst (0 = podle indexu nebo od začátku)
+		std::uint64_t endOffset {NoLimit};  ///< Čtení skončí na záznamu s tímto offsetem (jen pro soubory čtené přes mmap)
 	};
 
 	/**
-	 * @brief Třída pro čtení pcap souborů.
+	 * @brief Zdroj paketů přes libpcap (pcap_next_ex). Zvládá stdin i pcapng.
+	 *
+	 * Stdin čte vlastní vlákno a pakety předává přes SpscQueue - libpcap čte přes stdio, jehož buffer nejde
+	 * přenositelně zkontrolovat, takže poll() na deskriptoru stdin by nepoznal, jestli je další paket k dispozici.
+	 * Čekání ve WaitReadable() je pak poll() na eventfd fronty a `wakeFd`.
+	 */
+	class PcapSource : public PacketSource
+	{
+	public:
+		/**
+		 * @brief Konstruktor
+		 * 
+		 * @param file soubor, ze kterého číst nebo "-", který značí stdin
+		 * @param filter BPF filtr pro libpcap (nullptr = bez filtru)
+		 */
+		PcapSource(const std::string & file, const BpfFilter * filter = nullptr);
+
+		/**
+		 * @brief Zda se soubor / stdin podařilo otevřít
+		 */
+		bool IsOpen() const
+		{
+			return _pcap != nullptr;
+		}
+
+		/**
+		 * @brief Zda libpcap filtr přijal (jinak musí filtrovat volající)
+		 */
+		bool HasFilter() const
+		{
+			return _filtered;
+		}
+
+		/**
+		 * @brief Destruktor - uzavře `_pcap` (u stdin ho uzavře čtecí vlákno, až skončí)
+		 */
+		~PcapSource() override;
+
+		Packet GetNextPacket() override;
+
+		bool IsLive() const override
+		{
+			return _stream;
+		}
+
+		bool WaitReadable(int wakeFd) override;
+	private:
+		/// @brief Stdin čtený vlastním vláknem (definice v pcap_reader.cpp)
+		struct StdinStream;
+
+		/// @brief Pcap soubor / stdin stream (u stdin ho vlastní `_stdin`)
+		pcap_t * _pcap;
+
+		/// @brief Stav čtení stdin; sdílí ho čtecí vlákno, které může přežít zdroj (nullptr = soubor)
+		std::shared_ptr<StdinStream> _stdin;
+
+		/// @brief Čte se ze stdin (data přicházejí průběžně)
+		const bool _stream;
+
+		/// @brief Pakety filtruje libpcap
+		bool _filtered = false;
+	};
+
+	/**
+	 * @brief Třída pro čtení pcap souborů. Klasické pcap soubory čte přes mmap (MmapPcapSource),
+	 * stdin a ostatní formáty přes libpcap (PcapSource).
 	 */
 	class Reader
 	{
@@ -34,8 +110,18 @@ namespace Netflow
 		 * @brief Konstruktor
 		 * 
 		 * @param file soubor, ze kterého číst nebo "-", který značí stdin
+		 * @param range část souboru; začátek se hledá v indexu (PcapIndex), pokud existuje
+		 * @param filter BPF filtr - pakety, které mu nevyhovují, se přeskočí (nullptr = bez filtru)
+		 */
+		Reader(const std::string & file, const ReadRange & range = ReadRange {}, std::shared_ptr<const BpfFilter> filter = nullptr);
+
+		/**
+		 * @brief Konstruktor pro již otevřený zdroj (např. AfPacketSource); čte se celý
+		 * 
+		 * @param source zdroj (nullptr = žádné pakety)
+		 * @param name jméno zdroje
 		 */
-		Reader(const std::string & file);
+		Reader(std::unique_ptr<PacketSource> source, const std::string & name);
 
 		/**
 		 * @brief Vrátí další paket z pcap souboru/stdin
@@ -44,6 +130,34 @@ namespace Netflow
 		 */
 		Packet GetNextPacket();
 
+		/**
+		 * @brief Zda se zdroj podařilo otevřít (chyba je zalogována)
+		 */
+		bool IsOpen() const
+		{
+			return _opened;
+		}
+
+		/**
+		 * @brief Zda může čtení čekat na příchod dat (viz PacketSource::IsLive())
+		 */
+		bool IsLive() const
+		{
+			return _source && _source->IsLive();
+		}
+
+		/**
+		 * @brief Počká na data nebo na `wakeFd` (viz PacketSource::WaitReadable())
+		 * 
+		 * @param wakeFd deskriptor, který čekání přeruší
+		 * @return true GetNextPacket() nebude čekat
+		 * @return false čekání přerušil `wakeFd`
+		 */
+		bool WaitReadable(int wakeFd)
+		{
+			return _finished || _source->WaitReadable(wakeFd);
+		}
+
 		/**
 		 * @brief Vrátí počet přečtených paketů
 		 * 
@@ -57,12 +171,34 @@ namespace Netflow
 		/// @brief Počet přečtených paketů
 		std::uint64_t _packetCount = 0;
 
-		/// @brief Pcap soubor / stdin stream
-		pcap_t * _pcap;
+		/// @brief Čtená část souboru
+		const ReadRange _range;
+
+		/// @brief Lze kontrolovat `_range.endOffset` (zdroj zná offsety)
+		bool _seekable = false;
+
+		/// @brief Konec `_range` byl dosažen
+		bool _finished = false;
+
+		/// @brief Zdroj se podařilo otevřít
+		bool _opened = false;
+
+		/// @brief Zdroj paketů
+		std::unique_ptr<PacketSource> _source;
+
+		/// @brief Filtr vyhodnocovaný zde (nullptr = bez filtru nebo filtruje zdroj)
+		std::shared_ptr<const BpfFilter> _filter;
+
+		/**
+		 * @brief Inicializuje `_source` otevřením souboru `_file` nebo stdin
+		 * 
+		 * @param filter BPF filtr; pokud ho zdroj neumí použít sám, uloží se do `_filter`
+		 */
+		void OpenPcapFile(std::shared_ptr<const BpfFilter> filter);
 
 		/**
-		 * @brief Inicializuje `_pcap` otevřením souboru `_file` nebo stdin
+		 * @brief Přesune `_source` na začátek `_range` (podle `startOffset` nebo indexu)
 		 */
-		void OpenPcapFile();
+		void SeekToRange();
 	};
 } // namespace Netflow
@@ -0,0 +1,107 @@
+/**
+ * @file spsc_queue.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Lock-free fronta pro jednoho producenta a jednoho konzumenta
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace Netflow
+{
+	/**
+	 * @brief Omezená lock-free fronta (kruhový buffer) pro právě jedno zapisující a jedno čtecí vlákno.
+	 * TryPush() smí volat pouze producent, TryPop() pouze konzument.
+	 *
+	 * @tparam T typ položky (kopírovatelný)
+	 */
+	template <typename T>
+	class SpscQueue
+	{
+	public:
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param capacity kapacita (zaokrouhlí se nahoru na mocninu 2)
+		 */
+		SpscQueue(std::uint32_t capacity)
+		{
+			std::uint32_t size = 2;
+			while (size < capacity) {
+				size <<= 1;
+			}
+			_buffer.resize(size);
+			_mask = size - 1;
+		}
+
+		SpscQueue(const SpscQueue &) = delete;
+		SpscQueue & operator=(const SpscQueue &) = delete;
+
+		/**
+		 * @brief Vloží položku (producent)
+		 *
+		 * @param item položka
+		 * @return true položka byla vložena
+		 * @return false fronta je plná
+		 */
+		bool TryPush(const T & item)
+		{
+			const std::uint64_t tail = _tail.load(std::memory_order_relaxed);
+			if (tail - _cachedHead > _mask) {
+				// podle naší kopie je fronta plná; obnovíme kopii
+				_cachedHead = _head.load(std::memory_order_acquire);
+				if (tail - _cachedHead > _mask) {
+					return false;
+				}
+			}
+			_buffer[tail & _mask] = item;
+			_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		/**
+		 * @brief Vyjme položku (konzument)
+		 *
+		 * @param item výstupní položka
+		 * @return true položka byla vyjmuta
+		 * @return false fronta je prázdná
+		 */
+		bool TryPop(T & item)
+		{
+			const std::uint64_t head = _head.load(std::memory_order_relaxed);
+			if (head == _cachedTail) {
+				_cachedTail = _tail.load(std::memory_order_acquire);
+				if (head == _cachedTail) {
+					return false;
+				}
+			}
+			item = _buffer[head & _mask];
+			_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+	private:
+		/// @brief Velikost cache line; indexy producenta a konzumenta leží na různých řádcích (false sharing)
+		static constexpr std::size_t CacheLine = 64;
+
+		/// @brief Položky
+		std::vector<T> _buffer;
+
+		/// @brief Maska pro výpočet pozice v `_buffer`
+		std::uint32_t _mask;
+
+		/// @brief Pozice čtení (zapisuje konzument)
+		alignas(CacheLine) std::atomic<std::uint64_t> _head {0};
+
+		/// @brief Kopie `_tail` konzumenta - čte sdílený `_tail` jen při zdánlivě prázdné frontě
+		std::uint64_t _cachedTail = 0;
+
+		/// @brief Pozice zápisu (zapisuje producent)
+		alignas(CacheLine) std::atomic<std::uint64_t> _tail {0};
+
+		/// @brief Kopie `_head` producenta - čte sdílený `_head` jen při zdánlivě plné frontě
+		std::uint64_t _cachedHead = 0;
+	};
+} // namespace Netflow
@@ -0,0 +1,79 @@
+/**
+ * @file timer_wheel.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "timer_wheel.h"
+
+#include <algorithm>
+
+namespace Netflow
+{
+	TimerWheel::TimerWheel(std::uint32_t capacity, std::uint64_t granularity, std::uint64_t span)
+		: _granularity(std::max<std::uint64_t>(granularity, 1))
+	{
+		// +2: slot pro současný tick a rezerva pro zaokrouhlení
+		const std::uint64_t nSlotsNeeded = span / _granularity + 2;
+		constexpr std::uint64_t MaxSlots = 1 << 22;
+
+		std::uint64_t nSlots = 2;
+		while (nSlots < nSlotsNeeded && nSlots < MaxSlots) {
+			nSlots <<= 1;
+		}
+		_heads.resize(nSlots, InvalidIndex);
+		_mask = static_cast<std::uint32_t>(nSlots - 1);
+
+		_next.resize(capacity, InvalidIndex);
+		_prev.resize(capacity, InvalidIndex);
+		_slot.resize(capacity, InvalidIndex);
+		_deadline.resize(capacity);
+	}
+
+	void TimerWheel::Schedule(std::uint32_t index, std::uint64_t deadline)
+	{
+		Cancel(index);
+		_deadline[index] = deadline;
+		Link(index);
+	}
+
+	void TimerWheel::Cancel(std::uint32_t index)
+	{
+		const std::uint32_t slot = _slot[index];
+		if (slot == InvalidIndex) {
+			return;
+		}
+
+		if (_prev[index] != InvalidIndex) {
+			_next[_prev[index]] = _next[index];
+		}
+		else {
+			_heads[slot] = _next[index];
+		}
+		if (_next[index] != InvalidIndex) {
+			_prev[_next[index]] = _prev[index];
+		}
+		_slot[index] = InvalidIndex;
+	}
+
+	std::size_t TimerWheel::MemoryBytes() const
+	{
+		return (_heads.capacity() + _next.capacity() + _prev.capacity() + _slot.capacity()) * sizeof(std::uint32_t)
+			+ _deadline.capacity() * sizeof(std::uint64_t);
+	}
+
+	void TimerWheel::Link(std::uint32_t index)
+	{
+		// čas v minulosti patří do současného slotu
+		const std::uint64_t tick = std::max(_deadline[index] / _granularity, _currentTick);
+		const std::uint32_t slot = static_cast<std::uint32_t>(tick & _mask);
+
+		_prev[index] = InvalidIndex;
+		_next[index] = _heads[slot];
+		if (_heads[slot] != InvalidIndex) {
+			_prev[_heads[slot]] = index;
+		}
+		_heads[slot] = index;
+		_slot[index] = slot;
+	}
+} // namespace Netflow
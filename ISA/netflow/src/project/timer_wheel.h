@@ -0,0 +1,140 @@
+/**
+ * @file timer_wheel.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Časovací kolo (timer wheel) pro expiraci flow záznamů
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace Netflow
+{
+	/**
+	 * @brief Hashované časovací kolo. Každý záznam (určený indexem z FlowTable) má nejvýše jeden naplánovaný čas,
+	 * sloty jsou intruzivní obousměrně vázané seznamy nad poli indexovanými indexem záznamu.
+	 * Naplánování i zrušení je O(1); posun času prochází pouze sloty, které mezitím uplynuly.
+	 *
+	 * Časy jsou v milisekundách. Záznamy s časem dál, než pokrývá kolo, se při průchodu slotem přeřadí (nevyprší).
+	 */
+	class TimerWheel
+	{
+	public:
+		/// @brief Neplatný index
+		static constexpr std::uint32_t InvalidIndex = UINT32_MAX;
+
+		/**
+		 * @brief Konstruktor
+		 *
+		 * @param capacity maximální index záznamu + 1
+		 * @param granularity délka jednoho slotu v ms
+		 * @param span nejdelší očekávaná doba do vypršení v ms (určuje počet slotů)
+		 */
+		TimerWheel(std::uint32_t capacity, std::uint64_t granularity, std::uint64_t span);
+
+		/**
+		 * @brief Naplánuje (nebo přeplánuje) záznam
+		 *
+		 * @param index index záznamu
+		 * @param deadline čas vypršení v ms
+		 */
+		void Schedule(std::uint32_t index, std::uint64_t deadline);
+
+		/**
+		 * @brief Zruší naplánování záznamu (pokud je naplánovaný)
+		 *
+		 * @param index index záznamu
+		 */
+		void Cancel(std::uint32_t index);
+
+		/**
+		 * @brief Paměť alokovaná kolem
+		 *
+		 * @return std::size_t byty
+		 */
+		std::size_t MemoryBytes() const;
+
+		/**
+		 * @brief Posune čas kola na `now` a pro každý záznam s časem vypršení <= `now` zavolá `f(index)`.
+		 * Záznam je před zavoláním `f` odebrán z kola; `f` ho může znovu naplánovat.
+		 *
+		 * @param now současný čas v ms
+		 * @param f funkce
+		 */
+		template <typename F>
+		void Advance(std::uint64_t now, F f)
+		{
+			const std::uint64_t nowTick = now / _granularity;
+			if (!_started) {
+				_currentTick = nowTick;
+				_started = true;
+			}
+			if (nowTick < _currentTick) {
+				// čas se vrátil zpět (neseřazené pakety); nic nevypršelo
+				return;
+			}
+
+			// při velkém skoku stačí projít každý slot jednou
+			const std::uint64_t nTicks = std::min<std::uint64_t>(nowTick - _currentTick, _heads.size() - 1);
+			const std::uint64_t startTick = nowTick - nTicks;
+
+			for (std::uint64_t tick = startTick; tick <= nowTick; tick++) {
+				const std::uint32_t slot = static_cast<std::uint32_t>(tick & _mask);
+
+				// slot odpojíme, aby přeplánované záznamy nespadly do právě procházeného seznamu
+				std::uint32_t index = _heads[slot];
+				_heads[slot] = InvalidIndex;
+				while (index != InvalidIndex) {
+					const std::uint32_t next = _next[index];
+					_slot[index] = InvalidIndex;
+					if (_deadline[index] <= now) {
+						f(index);
+					}
+					else {
+						Link(index);
+					}
+					index = next;
+				}
+			}
+			// aktuální slot se prochází znovu při dalším posunu - může obsahovat záznamy s časem uvnitř ticku
+			_currentTick = nowTick;
+		}
+	private:
+		/// @brief Délka slotu v ms
+		const std::uint64_t _granularity;
+
+		/// @brief Maska pro výpočet slotu (počet slotů je mocnina 2)
+		std::uint32_t _mask;
+
+		/// @brief Současný tick (čas / granularita)
+		std::uint64_t _currentTick = 0;
+
+		/// @brief Jestli už byl nastaven `_currentTick`
+		bool _started = false;
+
+		/// @brief Začátky seznamů v jednotlivých slotech
+		std::vector<std::uint32_t> _heads;
+
+		/// @brief Následník záznamu ve slotu
+		std::vector<std::uint32_t> _next;
+
+		/// @brief Předchůdce záznamu ve slotu
+		std::vector<std::uint32_t> _prev;
+
+		/// @brief Slot, ve kterém je záznam; InvalidIndex = nenaplánovaný
+		std::vector<std::uint32_t> _slot;
+
+		/// @brief Čas vypršení záznamu v ms
+		std::vector<std::uint64_t> _deadline;
+
+		/**
+		 * @brief Zařadí záznam do slotu podle `_deadline[index]`
+		 *
+		 * @param index index záznamu
+		 */
+		void Link(std::uint32_t index);
+	};
+} // namespace Netflow
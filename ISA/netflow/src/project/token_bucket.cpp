@@ -0,0 +1,44 @@
+/**
+ * @file token_bucket.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "token_bucket.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace Netflow
+{
+	TokenBucket::TokenBucket(std::uint32_t rate, std::uint32_t burst)
+		: _rate(std::max<std::uint32_t>(rate, 1)), _burst(std::max<std::uint32_t>(burst, 1)), _tokens(_burst),
+		_last(std::chrono::steady_clock::now())
+	{
+	}
+
+	void TokenBucket::Refill()
+	{
+		const auto now = std::chrono::steady_clock::now();
+		const std::chrono::duration<double> elapsed = now - _last;
+		_last = now;
+		_tokens = std::min(_burst, _tokens + elapsed.count() * _rate);
+	}
+
+	std::uint32_t TokenBucket::Acquire(std::uint32_t n)
+	{
+		Refill();
+		if (_tokens < 1.0) {
+			// počkáme přesně na jeden token
+			const auto wait = std::chrono::duration<double>((1.0 - _tokens) / _rate);
+			const auto start = std::chrono::steady_clock::now();
+			std::this_thread::sleep_for(wait);
+			_waitedUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			Refill();
+		}
+
+		const std::uint32_t granted = std::max<std::uint32_t>(std::min<double>(n, _tokens), 1);
+		_tokens -= granted;
+		return granted;
+	}
+} // namespace Netflow
@@ -0,0 +1,65 @@
+/**
+ * @file token_bucket.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Token bucket pro omezení rychlosti odesílání datagramů
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace Netflow
+{
+	/**
+	 * @brief Token bucket - tokeny přibývají rychlostí `rate` za sekundu až do `burst`. Každý datagram spotřebuje
+	 * jeden token; pokud žádný není, Acquire() čeká (odesílání tak zpomalí export místo zahazování na kolektoru).
+	 */
+	class TokenBucket
+	{
+	public:
+		/**
+		 * @brief Konstruktor - začíná s plným bucketem
+		 *
+		 * @param rate tokenů za sekundu (> 0)
+		 * @param burst kapacita (alespoň 1)
+		 */
+		TokenBucket(std::uint32_t rate, std::uint32_t burst);
+
+		/**
+		 * @brief Vezme až `n` tokenů; pokud žádný není, počká na první
+		 *
+		 * @param n požadovaný počet
+		 * @return std::uint32_t počet získaných tokenů (1 až `n`)
+		 */
+		std::uint32_t Acquire(std::uint32_t n);
+
+		/**
+		 * @brief Celková doba čekání v Acquire() v µs
+		 */
+		std::uint64_t WaitedUs() const
+		{
+			return _waitedUs;
+		}
+	private:
+		/// @brief Tokenů za sekundu
+		const double _rate;
+
+		/// @brief Kapacita
+		const double _burst;
+
+		/// @brief Aktuální počet tokenů
+		double _tokens;
+
+		/// @brief Čas posledního doplnění
+		std::chrono::steady_clock::time_point _last;
+
+		/// @brief Celková doba čekání
+		std::uint64_t _waitedUs = 0;
+
+		/**
+		 * @brief Doplní tokeny za čas od posledního doplnění
+		 */
+		void Refill();
+	};
+} // namespace Netflow
@@ -0,0 +1,325 @@
+/**
+ * @file v5_collector.cpp
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Implementace
+ */
+
+#include "v5_collector.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+//#define _loggerDebug
+#include "logger/logger.hpp"
+
+namespace
+{
+	/// @brief Požadavek na ukončení (nastavuje V5Collector::Stop())
+	volatile std::sig_atomic_t stopRequested = 0;
+
+	/// @brief Místo pro řídicí zprávy jednoho datagramu (časové razítko a počet zahozených datagramů)
+	constexpr std::size_t ControlSize = CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(std::uint32_t));
+
+	/// @brief Max. velikost přijímaného datagramu - o byte delší než největší v5 datagram, delší tak poznáme
+	constexpr std::size_t RecvSize = Netflow::NetflowV5MaxDatagramSize + 1;
+
+	/**
+	 * @brief IPv4 adresa v pořadí hostitele jako text
+	 */
+	std::string Ipv4ToString(std::uint32_t addr)
+	{
+		char out[INET_ADDRSTRLEN];
+		const in_addr a {htonl(addr)};
+		inet_ntop(AF_INET, &a, out, sizeof(out));
+		return out;
+	}
+
+	/**
+	 * @brief Rozdíl dvou časů CLOCK_REALTIME v ns (0, pokud je `later` dřív)
+	 */
+	std::uint64_t ElapsedNs(const timespec & earlier, const timespec & later)
+	{
+		const std::int64_t ns = (static_cast<std::int64_t>(later.tv_sec) - earlier.tv_sec) * 1'000'000'000
+			+ (static_cast<std::int64_t>(later.tv_nsec) - earlier.tv_nsec);
+		return ns > 0 ? static_cast<std::uint64_t>(ns) : 0;
+	}
+} // namespace
+
+namespace Netflow
+{
+	V5Collector::V5Collector(const V5CollectorConfig & config)
+		: _config(config)
+	{
+		Logger::LogInfo<>("Listening on UDP " + _config.address + ":" + std::to_string(_config.port));
+		if (!InitSocket()) {
+			Logger::LogError<>("Couldn't initialize socket");
+		}
+	}
+
+	V5Collector::~V5Collector()
+	{
+		if (_sockfd != -1) {
+			close(_sockfd);
+		}
+	}
+
+	void V5Collector::Stop()
+	{
+		stopRequested = 1;
+	}
+
+	bool V5Collector::InitSocket()
+	{
+		addrinfo hints {}, *result;
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+		hints.ai_flags = AI_PASSIVE;
+
+		const int err = getaddrinfo(_config.address.c_str(), std::to_string(_config.port).c_str(), &hints, &result);
+		if (err != 0) {
+			Logger::LogError<>("getaddrinfo failed: " + std::string(gai_strerror(err)));
+			return false;
+		}
+
+		for (addrinfo *p = result; p != nullptr; p = p->ai_next) {
+			_sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+			if (_sockfd == -1) {
+				continue;
+			}
+			if (bind(_sockfd, p->ai_addr, p->ai_addrlen) == 0) {
+				break;
+			}
+			Logger::LogError<>("bind failed: " + std::string(std::strerror(errno)));
+			close(_sockfd);
+			_sockfd = -1;
+		}
+		freeaddrinfo(result);
+		if (_sockfd == -1) {
+			return false;
+		}
+
+		if (_config.recvBuffer > 0) {
+			int size = _config.recvBuffer;
+			setsockopt(_sockfd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+		}
+		// časové razítko příjmu a počet datagramů zahozených jádrem chodí s každým datagramem
+		int on = 1;
+		setsockopt(_sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+		setsockopt(_sockfd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+		// recvmmsg se musí občas vrátit kvůli výpisům a ukončení
+		timeval timeout {0, 100'000};
+		setsockopt(_sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		return true;
+	}
+
+	void V5Collector::Run()
+	{
+		if (_sockfd == -1) {
+			return;
+		}
+
+		std::vector<std::array<std::uint8_t, RecvSize>> buffers(RecvBatch);
+		std::vector<std::array<char, ControlSize>> controls(RecvBatch);
+		std::array<sockaddr_storage, RecvBatch> addrs {};
+		std::array<iovec, RecvBatch> iovs {};
+		std::array<mmsghdr, RecvBatch> msgs {};
+
+		auto lastReport = std::chrono::steady_clock::now();
+		while (!stopRequested) {
+			for (std::uint32_t i = 0; i < RecvBatch; i++) {
+				iovs[i] = {buffers[i].data(), RecvSize};
+				msgs[i].msg_hdr = {};
+				msgs[i].msg_hdr.msg_name = &addrs[i];
+				msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+				msgs[i].msg_hdr.msg_iov = &iovs[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+				msgs[i].msg_hdr.msg_control = controls[i].data();
+				msgs[i].msg_hdr.msg_controllen = ControlSize;
+			}
+
+			// blokuje do prvního datagramu (nebo timeoutu), pak vezme, co je ve frontě
+			const int n = recvmmsg(_sockfd, msgs.data(), RecvBatch, MSG_WAITFORONE, nullptr);
+			const auto now = std::chrono::steady_clock::now();
+			if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				Logger::LogError<>("recvmmsg failed: " + std::string(std::strerror(errno)));
+				break;
+			}
+
+			for (int i = 0; i < n; i++) {
+				const msghdr & hdr = msgs[i].msg_hdr;
+				const timespec * received = nullptr;
+				for (cmsghdr * c = CMSG_FIRSTHDR(&hdr); c != nullptr; c = CMSG_NXTHDR(const_cast<msghdr *>(&hdr), c)) {
+					if (c->cmsg_level != SOL_SOCKET) {
+						continue;
+					}
+					if (c->cmsg_type == SCM_TIMESTAMPNS) {
+						received = reinterpret_cast<const timespec *>(CMSG_DATA(c));
+					}
+					else if (c->cmsg_type == SO_RXQ_OVFL) {
+						// kumulativní počet od otevření socketu
+						std::uint32_t drops;
+						std::memcpy(&drops, CMSG_DATA(c), sizeof(drops));
+						_totals.kernelDrops = std::max<std::uint64_t>(_totals.kernelDrops, drops);
+					}
+				}
+
+				if (received != nullptr) {
+					timespec decodeStart;
+					clock_gettime(CLOCK_REALTIME, &decodeStart);
+					_queueLatency.Record(ElapsedNs(*received, decodeStart));
+				}
+
+				if (_totals.datagrams == 0) {
+					_firstDatagram = now;
+				}
+				_totals.datagrams++;
+				if (hdr.msg_flags & MSG_TRUNC) {
+					_totals.malformed++;
+					continue;
+				}
+
+				StageTimer timer(&_decodeLatency);
+				Decode(buffers[i].data(), msgs[i].msg_len, addrs[i], hdr.msg_namelen);
+			}
+			if (n > 0) {
+				_lastDatagram = now;
+			}
+
+			if (_config.reportInterval > 0 && now - lastReport >= std::chrono::seconds(_config.reportInterval)) {
+				Report(now - lastReport);
+				lastReport = now;
+			}
+			if (_config.idleExit > 0 && _totals.datagrams > 0 && now - _lastDatagram >= std::chrono::seconds(_config.idleExit)) {
+				break;
+			}
+		}
+
+		Summary();
+	}
+
+	void V5Collector::Decode(const std::uint8_t * data, std::size_t size, const sockaddr_storage & from, socklen_t fromLen)
+	{
+		const std::uint8_t * in = data;
+		if (size < NetflowV5HeaderSize || Get16(in) != 5) {
+			_totals.malformed++;
+			return;
+		}
+
+		NetflowV5Header header;
+		in = header.DeserializeFrom(data);
+		if (header.count == 0 || header.count > NetflowV5MaxRecords
+				|| size < NetflowV5HeaderSize + static_cast<std::size_t>(header.count) * NetflowV5RecordSize) {
+			_totals.malformed++;
+			return;
+		}
+
+		// zdroj = odesílatel + engine (jeden exportér může posílat za více engine)
+		std::string key(reinterpret_cast<const char *>(&from), fromLen);
+		key.push_back(static_cast<char>(header.engineType));
+		key.push_back(static_cast<char>(header.engineId));
+		CheckSequence(_streams[key], header);
+
+		for (std::uint16_t i = 0; i < header.count; i++) {
+			NetflowV5FlowRecord record;
+			in = record.DeserializeFrom(in);
+			_totals.packets += record.dPkts;
+			_totals.octets += record.dOctets;
+			if (_config.print) {
+				PrintRecord(record);
+			}
+		}
+		_totals.records += header.count;
+	}
+
+	void V5Collector::CheckSequence(Stream & stream, const NetflowV5Header & header)
+	{
+		if (!stream.seen) {
+			stream.seen = true;
+			stream.lastSequence = header.flowSequence;
+			stream.lastCount = header.count;
+			return;
+		}
+
+		// rozdíl počítáme modulo 2^32 (flowSequence přetéká)
+		const std::uint32_t diff = header.flowSequence - stream.lastSequence;
+		if (stream.mode == SequenceMode::Unknown) {
+			// číslování poznáme podle prvního rozdílu, který sedí jen na jednu z možností
+			if (diff == stream.lastCount && diff != header.count) {
+				stream.mode = SequenceMode::Before;
+			}
+			else if (diff == header.count && diff != stream.lastCount) {
+				stream.mode = SequenceMode::After;
+			}
+		}
+
+		const std::uint32_t expected = stream.mode == SequenceMode::After ? header.count : stream.lastCount;
+		const std::int32_t gap = static_cast<std::int32_t>(diff - expected);
+		if (gap < 0) {
+			// starší datagram - zaplní dříve započítanou mezeru
+			_totals.reordered++;
+			_totals.lostRecords -= std::min<std::uint64_t>(_totals.lostRecords, header.count);
+			return;
+		}
+		if (gap > 0) {
+			LOG_DEBUG("Sequence gap of " + std::to_string(gap) + " records");
+			_totals.gaps++;
+			_totals.lostRecords += gap;
+		}
+		stream.lastSequence = header.flowSequence;
+		stream.lastCount = header.count;
+	}
+
+	void V5Collector::PrintRecord(const NetflowV5FlowRecord & record)
+	{
+		char flags[8];
+		std::snprintf(flags, sizeof(flags), "0x%02x", record.tcpFlags);
+		std::cout << Ipv4ToString(record.srcAddr) << "/" << static_cast<unsigned>(record.srcMask) << ":" << record.srcPort
+			<< " -> " << Ipv4ToString(record.dstAddr) << "/" << static_cast<unsigned>(record.dstMask) << ":" << record.dstPort
+			<< " proto " << static_cast<unsigned>(record.prot) << " tos " << static_cast<unsigned>(record.tos)
+			<< " pkts " << record.dPkts << " bytes " << record.dOctets << " first " << record.first << " last " << record.last
+			<< " flags " << flags << "\n";
+	}
+
+	void V5Collector::Report(std::chrono::steady_clock::duration elapsed)
+	{
+		const double sec = std::chrono::duration<double>(elapsed).count();
+		Logger::LogInfo<>(std::to_string(static_cast<std::uint64_t>((_totals.records - _lastReport.records) / sec)) + " records/s, "
+			+ std::to_string(static_cast<std::uint64_t>((_totals.datagrams - _lastReport.datagrams) / sec)) + " datagrams/s, lost "
+			+ std::to_string(_totals.lostRecords - std::min(_lastReport.lostRecords, _totals.lostRecords)) + " records, kernel drops "
+			+ std::to_string(_totals.kernelDrops - _lastReport.kernelDrops));
+		_lastReport = _totals;
+	}
+
+	void V5Collector::Summary() const
+	{
+		const double sec = std::chrono::duration<double>(_lastDatagram - _firstDatagram).count();
+		const std::string rate = sec > 0 ? std::to_string(static_cast<std::uint64_t>(_totals.records / sec)) : "-";
+		Logger::LogInfo<>("Received " + std::to_string(_totals.datagrams) + " datagrams with " + std::to_string(_totals.records)
+			+ " records (" + std::to_string(_totals.packets) + " packets, " + std::to_string(_totals.octets) + " bytes) in "
+			+ std::to_string(sec) + " s: " + rate + " records/s");
+		Logger::LogInfo<>("Decode latency p50 " + std::to_string(_decodeLatency.Quantile(0.5)) + " ns, p99 "
+			+ std::to_string(_decodeLatency.Quantile(0.99)) + " ns; socket wait p50 " + std::to_string(_queueLatency.Quantile(0.5))
+			+ " ns, p99 " + std::to_string(_queueLatency.Quantile(0.99)) + " ns");
+
+		const std::string losses = "Lost " + std::to_string(_totals.lostRecords) + " records in " + std::to_string(_totals.gaps)
+			+ " sequence gaps, " + std::to_string(_totals.reordered) + " reordered, " + std::to_string(_totals.malformed)
+			+ " malformed, " + std::to_string(_totals.kernelDrops) + " datagrams dropped by the kernel";
+		if (_totals.lostRecords > 0 || _totals.kernelDrops > 0 || _totals.malformed > 0) {
+			Logger::LogWarning<>(losses);
+		}
+		else {
+			Logger::LogInfo<>(losses);
+		}
+	}
+} // namespace Netflow
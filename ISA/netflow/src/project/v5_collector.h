@@ -0,0 +1,188 @@
+/**
+ * @file v5_collector.h
+ * @author Augustin Machynak (xmachy02@stud.fit.vutbr.cz)
+ * @brief Jednoduchý Netflow v5 kolektor - dekóduje datagramy, hlídá ztráty podle flowSequence a měří propustnost
+ */
+
+#pragma once
+
+#include "netflow_datagram.h"
+#include "exporter_stats.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include <sys/socket.h>
+
+namespace Netflow
+{
+	/**
+	 * @brief Nastavení kolektoru
+	 */
+	struct V5CollectorConfig
+	{
+		std::string address {"0.0.0.0"};
+		std::uint32_t port {2055};
+		std::uint32_t reportInterval {1}; ///< Perioda průběžného výpisu v sekundách (0 = jen souhrn na konci)
+		std::uint32_t idleExit {0};       ///< Ukončit po tolika sekundách bez datagramu (0 = až signálem)
+		std::uint32_t recvBuffer {0};     ///< SO_RCVBUF v bytech (0 = výchozí systému)
+		bool print {false};               ///< Vypisovat dekódované záznamy
+	};
+
+	/**
+	 * @brief Souhrnná počítadla kolektoru
+	 */
+	struct V5CollectorTotals
+	{
+		std::uint64_t datagrams {0};
+		std::uint64_t records {0};
+		std::uint64_t packets {0};     ///< Součet dPkts přijatých záznamů
+		std::uint64_t octets {0};      ///< Součet dOctets přijatých záznamů
+		std::uint64_t malformed {0};   ///< Datagramy, které nejsou platný Netflow v5
+		std::uint64_t lostRecords {0}; ///< Záznamy chybějící podle flowSequence
+		std::uint64_t gaps {0};        ///< Počet mezer ve flowSequence
+		std::uint64_t reordered {0};   ///< Datagramy, které přišly po novějších (zaplní dřívější mezeru)
+		std::uint64_t kernelDrops {0}; ///< Datagramy zahozené jádrem při plném bufferu socketu (SO_RXQ_OVFL)
+	};
+
+	/**
+	 * @brief Netflow v5 kolektor pro testování exportéru na jednom stroji. Přijímá datagramy dávkově (recvmmsg),
+	 * dekóduje je (opak NetflowV5Header/NetflowV5FlowRecord::SerializeTo()) a pro každý zdroj (adresa, port, engine)
+	 * kontroluje návaznost flowSequence. Měří dobu dekódování datagramu a dobu, kterou datagram čekal v socketu.
+	 */
+	class V5Collector
+	{
+	public:
+		/// @brief Počet datagramů přijatých jedním voláním recvmmsg
+		static constexpr std::uint32_t RecvBatch = 64;
+
+		/**
+		 * @brief Konstruktor - otevře socket
+		 *
+		 * @param config nastavení
+		 */
+		explicit V5Collector(const V5CollectorConfig & config);
+
+		/**
+		 * @brief Destruktor - zavře socket
+		 */
+		~V5Collector();
+
+		V5Collector(const V5Collector &) = delete;
+		V5Collector & operator=(const V5Collector &) = delete;
+
+		/**
+		 * @brief Zda se podařilo otevřít socket
+		 */
+		bool IsInitialized() const
+		{
+			return _sockfd != -1;
+		}
+
+		/**
+		 * @brief Přijímá datagramy do Stop() nebo nečinnosti (V5CollectorConfig::idleExit), pak vypíše souhrn
+		 */
+		void Run();
+
+		/**
+		 * @brief Požadavek na ukončení Run(). Bezpečné volat z obsluhy signálu.
+		 */
+		static void Stop();
+
+		/**
+		 * @brief Souhrnná počítadla
+		 */
+		const V5CollectorTotals & Totals() const
+		{
+			return _totals;
+		}
+	private:
+		/// @brief Jak exportér čísluje flowSequence
+		enum class SequenceMode
+		{
+			Unknown,
+			Before, ///< Počet flow před datagramem (Cisco)
+			After   ///< Počet flow včetně datagramu (tento exportér)
+		};
+
+		/**
+		 * @brief Stav jednoho zdroje datagramů
+		 */
+		struct Stream
+		{
+			bool seen {false};
+			std::uint32_t lastSequence {0};
+			std::uint16_t lastCount {0};
+			SequenceMode mode {SequenceMode::Unknown};
+		};
+
+		/// @brief Nastavení
+		const V5CollectorConfig _config;
+
+		/// @brief Socket
+		int _sockfd = -1;
+
+		/// @brief Zdroje podle adresy, portu a engine
+		std::unordered_map<std::string, Stream> _streams;
+
+		/// @brief Počítadla
+		V5CollectorTotals _totals;
+
+		/// @brief Počítadla při posledním průběžném výpisu
+		V5CollectorTotals _lastReport;
+
+		/// @brief Doba dekódování jednoho datagramu
+		LatencyHistogram _decodeLatency;
+
+		/// @brief Doba od příjmu datagramu jádrem do začátku dekódování
+		LatencyHistogram _queueLatency;
+
+		/// @brief Časy prvního a posledního datagramu
+		std::chrono::steady_clock::time_point _firstDatagram;
+		std::chrono::steady_clock::time_point _lastDatagram;
+
+		/**
+		 * @brief Otevře socket a nastaví časová razítka a počítadlo zahozených datagramů
+		 *
+		 * @return true socket je připraven
+		 */
+		bool InitSocket();
+
+		/**
+		 * @brief Dekóduje jeden datagram
+		 *
+		 * @param data datagram
+		 * @param size velikost
+		 * @param from odesílatel
+		 * @param fromLen velikost `from`
+		 */
+		void Decode(const std::uint8_t * data, std::size_t size, const sockaddr_storage & from, socklen_t fromLen);
+
+		/**
+		 * @brief Zkontroluje návaznost flowSequence
+		 *
+		 * @param stream zdroj
+		 * @param header hlavička datagramu
+		 */
+		void CheckSequence(Stream & stream, const NetflowV5Header & header);
+
+		/**
+		 * @brief Vypíše záznam na std::cout
+		 */
+		static void PrintRecord(const NetflowV5FlowRecord & record);
+
+		/**
+		 * @brief Vypíše přírůstek počítadel od minulého výpisu
+		 *
+		 * @param elapsed doba od minulého výpisu
+		 */
+		void Report(std::chrono::steady_clock::duration elapsed);
+
+		/**
+		 * @brief Vypíše souhrn
+		 */
+		void Summary() const;
+	};
+} // namespace Netflow